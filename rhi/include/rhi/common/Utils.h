@@ -2,6 +2,8 @@
 
 #include <sstream>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
 namespace rhi
 {
@@ -91,4 +93,30 @@ namespace rhi
 
 		return false;
 	}
+
+	// 64-bit FNV-1a, pass the previous result as seed to hash several ranges.
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			seed = (seed ^ bytes[i]) * 1099511628211ull;
+		}
+		return seed;
+	}
+
+	// The bit pattern of a float for hash keys, so keys don't depend on float comparison.
+	inline uint64_t floatBits(float value)
+	{
+		uint32_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	// ShaderDesc::hash of a shader, 0 for a missing one. A template since IShader isn't declared here.
+	template <typename ShaderT>
+	uint64_t getShaderHash(const ShaderT* shader)
+	{
+		return shader ? shader->getDesc().hash : 0;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rhi
+{
+	// Handle to a texture or buffer that lives in a FrameGraph.
+	struct FrameGraphResource
+	{
+		static constexpr uint32_t InvalidIndex = UINT32_MAX;
+		uint32_t index = InvalidIndex;
+
+		bool isValid() const { return index != InvalidIndex; }
+		bool operator ==(const FrameGraphResource& other) const { return index == other.index; }
+		bool operator !=(const FrameGraphResource& other) const { return index != other.index; }
+	};
+
+	class FrameGraph;
+
+	// Used inside the setup callback of a pass to declare what the pass creates, reads and writes.
+	class FrameGraphPassBuilder
+	{
+	public:
+		// Transient resources only live while some pass uses them,
+		// their memory is reused by other transient resources with the same desc.
+		FrameGraphResource createTexture(const char* name, const TextureDesc& desc);
+		FrameGraphResource createBuffer(const char* name, const BufferDesc& desc);
+		FrameGraphResource read(FrameGraphResource resource, ResourceState state);
+		FrameGraphResource write(FrameGraphResource resource, ResourceState state);
+		// The pass is never culled, even if nothing reads what it writes.
+		void setSideEffect();
+	private:
+		friend class FrameGraph;
+		FrameGraphPassBuilder(FrameGraph& graph, uint32_t passIndex)
+			:m_Graph(graph),
+			m_PassIndex(passIndex) {}
+		FrameGraph& m_Graph;
+		uint32_t m_PassIndex;
+	};
+
+	// Gives a pass access to the physical resources behind its declared handles.
+	class FrameGraphPassResources
+	{
+	public:
+		ITexture* getTexture(FrameGraphResource resource) const;
+		IBuffer* getBuffer(FrameGraphResource resource) const;
+	private:
+		friend class FrameGraph;
+		explicit FrameGraphPassResources(const FrameGraph& graph)
+			:m_Graph(graph) {}
+		const FrameGraph& m_Graph;
+	};
+
+	struct FrameGraphStatistics
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t transientResourceCount = 0;
+		// Number of physical textures and buffers backing the transient resources this frame.
+		uint32_t physicalResourceCount = 0;
+		uint32_t barrierBatchCount = 0;
+	};
+
+	// A per frame graph of passes built on top of ICommandList.
+	// Usage: import external resources, add passes, compile, then execute.
+	// Passes whose results are never consumed are culled, and all transitions a pass needs
+	// are committed as one barrier batch right before the pass is recorded.
+	class FrameGraph
+	{
+	public:
+		using SetupFunc = std::function<void(FrameGraphPassBuilder& builder)>;
+		using ExecuteFunc = std::function<void(const FrameGraphPassResources& resources, ICommandList* cmdList)>;
+
+		explicit FrameGraph(IRenderDevice* renderDevice);
+		~FrameGraph();
+		FrameGraph(const FrameGraph&) = delete;
+		FrameGraph& operator=(const FrameGraph&) = delete;
+
+		// Imported resources are treated as outputs of the frame, so passes writing them are kept.
+		FrameGraphResource importTexture(const char* name, ITexture* texture);
+		FrameGraphResource importBuffer(const char* name, IBuffer* buffer);
+		void addPass(const char* name, const SetupFunc& setup, ExecuteFunc execute);
+
+		void compile();
+		// Record all live passes into an opened command list.
+		void execute(ICommandList* cmdList);
+		// Record every live pass into its own command list, pass bodies are recorded on threadCount threads.
+		// Recording stays on the calling thread unless the rhi is built with RHI_ENABLE_THREAD_RECORDING.
+		// Pass bodies run with auto-transition off and must not change resource states, e.g. with generateMips.
+		// A texture a pass clears outside of a render pass has to be declared as a CopyDest write.
+		// The command lists are submitted in pass order, returns the execute id of the submission.
+		uint64_t executeParallel(uint32_t threadCount);
+		// Drop all passes and resource handles, the transient resource pool is kept for the next frame.
+		void reset();
+
+		const FrameGraphStatistics& getStatistics() const { return m_Statistics; }
+	private:
+		friend class FrameGraphPassBuilder;
+		friend class FrameGraphPassResources;
+
+		enum class ResourceType : uint8_t
+		{
+			Texture,
+			Buffer
+		};
+
+		struct ResourceNode
+		{
+			std::string name;
+			ResourceType type = ResourceType::Texture;
+			bool imported = false;
+			TextureDesc textureDesc;
+			BufferDesc bufferDesc;
+			ITexture* texture = nullptr;
+			IBuffer* buffer = nullptr;
+			std::vector<uint32_t> writerPasses;
+			uint32_t refCount = 0;
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0;
+		};
+
+		struct ResourceAccess
+		{
+			FrameGraphResource resource;
+			ResourceState state = ResourceState::Undefined;
+		};
+
+		struct PassNode
+		{
+			std::string name;
+			ExecuteFunc execute;
+			std::vector<ResourceAccess> reads;
+			std::vector<ResourceAccess> writes;
+			bool hasSideEffect = false;
+			uint32_t refCount = 0;
+			bool culled = false;
+		};
+
+		struct TransientTexture
+		{
+			std::unique_ptr<ITexture> texture;
+			bool inUse = false;
+		};
+
+		struct TransientBuffer
+		{
+			std::unique_ptr<IBuffer> buffer;
+			bool inUse = false;
+		};
+
+		FrameGraphResource addResource(ResourceNode&& node);
+		void cullPasses();
+		void computeLifetimes();
+		ITexture* acquireTexture(const TextureDesc& desc);
+		IBuffer* acquireBuffer(const BufferDesc& desc);
+		static ResourceState getResourceState(const ResourceNode& node);
+		void recordBarriers(const PassNode& pass, ICommandList* cmdList);
+
+		IRenderDevice* m_RenderDevice;
+		std::vector<PassNode> m_Passes;
+		std::vector<ResourceNode> m_Resources;
+		bool m_Compiled = false;
+
+		std::vector<TransientTexture> m_TransientTextures;
+		std::vector<TransientBuffer> m_TransientBuffers;
+		std::vector<std::unique_ptr<ICommandList>> m_CommandLists;
+
+		FrameGraphStatistics m_Statistics;
+	};
+}
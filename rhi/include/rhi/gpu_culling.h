@@ -0,0 +1,103 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <memory>
+
+namespace rhi
+{
+	// Layout of one element of the instance buffer, matches shaders/gpu_culling.comp.
+	struct GpuCullingInstance
+	{
+		// xyz is the world space center, w the radius.
+		float boundingSphere[4]{};
+		// Index into the mesh table.
+		uint32_t meshIndex = 0;
+		uint32_t padding[3]{};
+	};
+
+	// The index range a culled instance is drawn with.
+	struct GpuCullingMesh
+	{
+		uint32_t indexCount = 0;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		uint32_t padding = 0;
+	};
+
+	struct GpuCullingCreateInfo
+	{
+		// SPIR-V of shaders/gpu_culling.comp.
+		const uint32_t* shaderCode = nullptr;
+		size_t shaderCodeSize = 0;
+		uint32_t maxInstanceCount = 0;
+		uint32_t maxMeshCount = 0;
+		bool enableOcclusionCulling = false;
+		// Depth pyramid, every texel of a mip holds the farthest depth of the texels it covers in the mip above.
+		// Only used when occlusion culling is enabled.
+		ITextureView* hizView = nullptr;
+	};
+
+	struct GpuCullingView
+	{
+		// (normal, distance) pairs, a point p is inside when dot(normal, p) + distance >= 0.
+		float frustumPlanes[6][4]{};
+		// Column major, used to project the bounding spheres onto the depth pyramid.
+		float viewProjection[16]{};
+	};
+
+	// GPU driven rendering: a compute pass culls the instances against the frustum (and optionally a depth pyramid)
+	// and compacts the survivors into DrawIndexedIndirectCommands, which are drawn without any CPU readback.
+	// The CPU cost of cull and draw does not depend on the number of instances.
+	class GpuCulling
+	{
+	public:
+		// Returns null if the device doesn't support drawIndirectCount.
+		static GpuCulling* create(IRenderDevice* renderDevice, const GpuCullingCreateInfo& createInfo);
+		~GpuCulling();
+		GpuCulling(const GpuCulling&) = delete;
+		GpuCulling& operator=(const GpuCulling&) = delete;
+
+		// Frustum planes of a view projection matrix with a [0, 1] depth range.
+		static void computeFrustumPlanes(const float viewProjection[16], float frustumPlanes[6][4]);
+
+		void updateInstances(ICommandList* cmdList, const GpuCullingInstance* instances, uint32_t instanceCount, uint32_t firstInstance = 0);
+		void updateMeshes(ICommandList* cmdList, const GpuCullingMesh* meshes, uint32_t meshCount);
+		// Number of instances, starting at the first one, that are culled and drawn.
+		void setInstanceCount(uint32_t instanceCount);
+
+		void cull(ICommandList* cmdList, const GpuCullingView& view);
+		// Transition the draw buffers for drawing, call it before beginRenderPass so the pass isn't split by the barriers.
+		void prepareDraw(ICommandList* cmdList);
+		// Draw the survivors with the graphics state set on the command list.
+		// firstInstance of every draw is the index of the instance, so shaders can fetch per instance data with it.
+		void draw(ICommandList* cmdList);
+
+		IBuffer* getDrawCommandBuffer() const { return m_DrawCommandBuffer.get(); }
+		IBuffer* getDrawCountBuffer() const { return m_DrawCountBuffer.get(); }
+		IBuffer* getInstanceBuffer() const { return m_InstanceBuffer.get(); }
+	private:
+		explicit GpuCulling(IRenderDevice* renderDevice)
+			:m_RenderDevice(renderDevice) {}
+		bool init(const GpuCullingCreateInfo& createInfo);
+
+		IRenderDevice* m_RenderDevice;
+		uint32_t m_MaxInstanceCount = 0;
+		uint32_t m_MaxMeshCount = 0;
+		uint32_t m_InstanceCount = 0;
+
+		std::unique_ptr<IShader> m_Shader;
+		std::unique_ptr<IResourceSetLayout> m_ResourceSetLayout;
+		std::unique_ptr<IResourceSet> m_ResourceSet;
+		std::unique_ptr<IComputePipeline> m_Pipeline;
+
+		std::unique_ptr<IBuffer> m_ViewBuffer;
+		std::unique_ptr<IBuffer> m_InstanceBuffer;
+		std::unique_ptr<IBuffer> m_MeshBuffer;
+		std::unique_ptr<IBuffer> m_DrawCommandBuffer;
+		std::unique_ptr<IBuffer> m_DrawCountBuffer;
+		// Bound in place of the depth pyramid when occlusion culling is disabled.
+		std::unique_ptr<ITexture> m_DummyHizTexture;
+		std::unique_ptr<ISampler> m_HizSampler;
+	};
+}
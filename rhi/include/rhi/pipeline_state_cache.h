@@ -0,0 +1,67 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace rhi
+{
+	struct PipelineStateCacheStatistics
+	{
+		uint64_t requestCount = 0;
+		// Requests answered with an existing pipeline.
+		uint64_t hitCount = 0;
+		// Pipelines still referenced by a caller.
+		uint32_t pipelineCount = 0;
+
+		double getHitRate() const { return requestCount == 0 ? 0.0 : double(hitCount) / double(requestCount); }
+	};
+
+	// Shares pipelines between identical create infos, so callers can request pipelines freely without creating
+	// duplicate driver objects. The key is the create info with everything normalized away that doesn't change the
+	// pipeline: shaders are compared by ShaderDesc::hash, blend state of disabled or missing render targets, states
+	// covered by dynamicStates, the depth compare op without depth test, stencil ops without stencil test and cacheData.
+	// Resource set layouts are compared by their bindings and flags, so identically defined layouts share pipelines
+	// and a layout allocated at the address of a destroyed one never matches the old entries.
+	// A pipeline is destroyed once the last shared_ptr to it is released, which may happen after the cache is gone.
+	class PipelineStateCache
+	{
+	public:
+		explicit PipelineStateCache(IRenderDevice* renderDevice)
+			:m_RenderDevice(renderDevice) {}
+		PipelineStateCache(const PipelineStateCache&) = delete;
+		PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+		// nullptr if the pipeline can't be created.
+		std::shared_ptr<IGraphicsPipeline> getGraphicsPipeline(const GraphicsPipelineCreateInfo& pipelineCI);
+		std::shared_ptr<IComputePipeline> getComputePipeline(const ComputePipelineCreateInfo& pipelineCI);
+		PipelineStateCacheStatistics getStatistics() const;
+		void resetStatistics();
+
+		// Stable hash of the normalized create info, equal create infos have equal hashes.
+		uint64_t hashPipeline(const GraphicsPipelineCreateInfo& pipelineCI) const;
+		uint64_t hashPipeline(const ComputePipelineCreateInfo& pipelineCI) const;
+	private:
+		using Key = std::vector<uint64_t>;
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		Key getKey(const GraphicsPipelineCreateInfo& pipelineCI) const;
+		Key getKey(const ComputePipelineCreateInfo& pipelineCI) const;
+		template<typename PipelineType, typename CreateInfoType>
+		std::shared_ptr<PipelineType> getPipeline(std::unordered_map<Key, std::weak_ptr<PipelineType>, KeyHash>& pipelines,
+			const CreateInfoType& pipelineCI);
+
+		IRenderDevice* m_RenderDevice;
+		mutable std::mutex m_Mutex;
+		std::unordered_map<Key, std::weak_ptr<IGraphicsPipeline>, KeyHash> m_GraphicsPipelines;
+		std::unordered_map<Key, std::weak_ptr<IComputePipeline>, KeyHash> m_ComputePipelines;
+		uint64_t m_RequestCount = 0;
+		uint64_t m_HitCount = 0;
+	};
+}
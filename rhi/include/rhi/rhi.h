@@ -44,6 +44,9 @@ namespace rhi
 	public:
 		virtual ~IBuffer() = default;
 		virtual const BufferDesc& getDesc() const = 0;
+		// State of [offset, offset + size), the combination of the states if parts of it are in different ones.
+		// getState() combines the states of the whole buffer, compare against a range to tell e.g. whether it is written.
+		virtual ResourceState getRangeState(uint64_t offset, uint64_t size) const = 0;
 	};
 
 	class ITextureView : public IObject
@@ -75,12 +78,18 @@ namespace rhi
 	public:
 		~IShader() = default;
 		virtual const ShaderDesc& getDesc() const = 0;
+		// nullptr if the shader wasn't created with ShaderCreateInfo::reflect, see rhi/shader_reflection.h.
+		virtual const ShaderReflection* getReflection() const = 0;
 	};
 
 	class IResourceSetLayout : public IObject
 	{
 	public:
 		virtual ~IResourceSetLayout() = default;
+		// What the layout was created with.
+		virtual const ResourceSetLayoutBinding* getBindings() const = 0;
+		virtual uint32_t getBindingCount() const = 0;
+		virtual ResourceSetLayoutFlags getFlags() const = 0;
 	};
 
 	class IResourceSet : public IObject
@@ -93,6 +102,7 @@ namespace rhi
 	{
 	public:
 		virtual ~IPipeline() = default;
+		// Data of the device-wide pipeline cache, which all pipelines share.
 		virtual bool getPipelineCacheData(void* pData, size_t* pDataSize) const = 0;
 	};
 
@@ -110,6 +120,22 @@ namespace rhi
 		~IComputePipeline() = default;
 	};
 
+	// A pipeline compiled on a worker thread. Deleting a task that is still queued cancels it,
+	// tasks must be deleted before the render device.
+	class IPipelineCompileTask : public IObject
+	{
+	public:
+		virtual ~IPipelineCompileTask() = default;
+		virtual bool isReady() const = 0;
+		// Compiles the pipeline on the calling thread if no worker has started it yet.
+		virtual void wait() = 0;
+		// Moves a queued task, e.g. to High once the pipeline is needed this frame.
+		virtual void setPriority(PipelineCompilePriority priority) = 0;
+		// Transfers the ownership of the pipeline to the caller, nullptr if the task isn't ready or failed.
+		// Cast it to the IGraphicsPipeline or IComputePipeline that was requested.
+		virtual IPipeline* takePipeline() = 0;
+	};
+
 	class ICommandList : public IObject
 	{
 	public:
@@ -119,26 +145,91 @@ namespace rhi
 		virtual void close() = 0;
 
 		virtual void setResourceAutoTransition(bool enable) = 0;
+		virtual bool getResourceAutoTransition() const = 0;
+		// When enabled, buffer transitions and texture transitions that keep the image layout
+		// (e.g. UnorderedAccess -> UnorderedAccess) are merged into a single global memory barrier per batch.
+		virtual void setGlobalMemoryBarriers(bool enable) = 0;
 		virtual void commitBarriers() = 0;
 		virtual void transitionTextureState(ITexture* texture, ResourceState newState) = 0;
 		virtual void transitionBufferState(IBuffer* buffer, ResourceState newState) = 0;
+		// Only [offset, offset + size) of the buffer changes state, other parts of it can stay in use.
+		virtual void transitionBufferState(IBuffer* buffer, ResourceState newState, uint64_t offset, uint64_t size) = 0;
 		virtual void transitionResourceSet(IResourceSet* resourceSet) = 0;
+		// Split barriers, the transition starts at begin and is only waited on at end,
+		// so unrelated work recorded in between can overlap with it.
+		// The resource must not be accessed between the two calls.
+		virtual void beginTextureTransition(ITexture* texture, ResourceState newState) = 0;
+		virtual void endTextureTransition(ITexture* texture) = 0;
+		virtual void beginBufferTransition(IBuffer* buffer, ResourceState newState) = 0;
+		virtual void endBufferTransition(IBuffer* buffer) = 0;
+		// Make unordered access writes of previous commands visible to the following ones, without any state change.
+		virtual void uavBarrier() = 0;
+		// Counters of the barriers recorded since the command list was opened.
+		virtual const BarrierStatistics& getBarrierStatistics() const = 0;
+		// Log redundant and over-broad barriers together with the command that requested them. The command is the
+		// ICommandList function that recorded the barrier, e.g. setGraphicsState, not the call site in the application.
+		virtual void setBarrierAnalysis(bool enable) = 0;
 
+		// Clears of views that are not attachments of the current rendering are deferred until the texture is used next,
+		// if that is as an attachment of a render pass they become its load op.
 		virtual void clearColorTexture(ITextureView* textureView, const ClearColor& color) = 0;
 		virtual void clearDepthStencil(ITextureView* textureView, ClearDepthStencilFlag flag, float depthVal, uint8_t stencilVal) = 0;
+		virtual const ClearStatistics& getClearStatistics() const = 0;
 		virtual void updateBuffer(IBuffer* buffer, const void* data, uint64_t dataSize, uint64_t offset) = 0;
 		virtual void copyBuffer(IBuffer* srcBuffer, uint64_t srcOffset, IBuffer* dstBuffer, uint64_t dstOffset, uint64_t dataSize) = 0;
 		virtual void* mapBuffer(IBuffer* buffer, MapBufferUsage usage) = 0;
 		virtual void updateTexture(ITexture* texture, const void* data, uint64_t dataSize, const TextureUpdateInfo& updateInfo) = 0;
+		// Resolve every layer of the first mip of a multisampled color texture, prefer resolving in the render pass,
+		// which doesn't write the samples to memory.
+		virtual void resolveTexture(ITexture* dstTexture, ITexture* srcTexture) = 0;
+		// Scale every layer of the first mip of srcTexture into the first mip of dstTexture.
+		// Both formats must support blits, linear filtering also needs a filterable source format.
+		// srcTexture needs TextureUsage::CopySource unless it has more than one mip.
+		virtual void blitTexture(ITexture* srcTexture, ITexture* dstTexture, FilterMode filter) = 0;
+		// Fill every mip below the first one by downsampling the mip above it.
+		// Blits are used when the format supports linear blits, otherwise a compute shader downsamples the mips,
+		// which needs a texture with TextureUsage::UnorderedAccess and RenderDeviceCreateInfo::mipDownsampleShaderCode.
+		// The texture is left in ResourceState::CopySource after blits and in ResourceState::ShaderResource after the compute path.
+		virtual void generateMips(ITexture* texture) = 0;
+
+		// Draws between begin and end render to the attachments of the render pass.
+		// Resource transitions should be done before beginRenderPass, barriers recorded inside split the pass.
+		virtual void beginRenderPass(const RenderPassDesc& desc) = 0;
+		virtual void endRenderPass() = 0;
 
 		virtual void setPushConstant(ShaderType stages, const void* data) = 0;
+		// Records the bindings of the PushDescriptor layout at setIndex of the bound pipeline, no resource set is allocated.
+		// Call it after setGraphicsState or setComputeState, the sets bound by the state must all be below setIndex.
+		virtual void pushResourceSet(uint32_t setIndex, const ResourceSetBinding* bindings, uint32_t bindingCount) = 0;
 		virtual void setScissors(const Rect* scissors, uint32_t scissorCount) = 0;
 		virtual void setGraphicsState(const GraphicsState& state) = 0;
+		// Dynamic states, the bound pipeline must have been created with them in GraphicsPipelineCreateInfo::dynamicStates.
+		// Values that equal the last recorded ones are skipped.
+		virtual void setCullMode(CullMode cullMode) = 0;
+		virtual void setFrontFace(bool frontCounterClockwise) = 0;
+		virtual void setPrimitiveType(PrimitiveType primType) = 0;
+		virtual void setDepthTestEnable(bool enable) = 0;
+		virtual void setDepthWriteEnable(bool enable) = 0;
+		virtual void setDepthCompareOp(CompareOp op) = 0;
+		virtual void setStencilTestEnable(bool enable) = 0;
+		// Sets the fail, pass, depth fail and compare ops of both faces, masks and reference stay in the pipeline.
+		virtual void setStencilOp(const StencilOpState& frontFace, const StencilOpState& backFace) = 0;
+		virtual void setDepthBiasEnable(bool enable) = 0;
+		virtual void setPrimitiveRestartEnable(bool enable) = 0;
+		virtual void setPolygonMode(PolygonMode mode) = 0;
+		virtual void setDepthClampEnable(bool enable) = 0;
 
 		virtual void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) = 0;
 		virtual void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) = 0;
 		virtual void drawIndirect(uint64_t offset, uint32_t drawCount) = 0;
 		virtual void drawIndexedIndirect(uint64_t offset, uint32_t drawCount) = 0;
+		// The draw count is a uint32_t read from countBuffer at countOffset, clamped to maxDrawCount.
+		// Both buffers are transitioned to IndirectBuffer automatically.
+		// Needs IRenderDevice::isDrawIndirectCountSupported(), the draw is skipped otherwise.
+		virtual void drawIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+			IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount) = 0;
+		virtual void drawIndexedIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+			IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount) = 0;
 
 		virtual void setComputeState(const ComputeState& state) = 0;
 		virtual void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) = 0;
@@ -152,9 +243,34 @@ namespace rhi
 		virtual void waitIdle() = 0;
 		virtual IGraphicsPipeline* createGraphicsPipeline(const GraphicsPipelineCreateInfo& pipelineCI) = 0;
 		virtual IComputePipeline* createComputePipeline(const ComputePipelineCreateInfo& pipelineCI) = 0;
-		virtual IResourceSetLayout* createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount) = 0;
+		// Writes the pipeline cache to RenderDeviceCreateInfo::pipelineCacheFilePath.
+		// Must not run concurrently with pipeline creation.
+		virtual bool savePipelineCache() = 0;
+		// The create info is copied, its arrays only have to live until the call returns.
+		virtual IPipelineCompileTask* createGraphicsPipelineAsync(const GraphicsPipelineCreateInfo& pipelineCI,
+			PipelineCompilePriority priority = PipelineCompilePriority::Normal) = 0;
+		virtual IPipelineCompileTask* createComputePipelineAsync(const ComputePipelineCreateInfo& pipelineCI,
+			PipelineCompilePriority priority = PipelineCompilePriority::Normal) = 0;
+		virtual PipelineCompileStatistics getPipelineCompileStatistics() const = 0;
+		virtual IResourceSetLayout* createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount,
+			ResourceSetLayoutFlags flags = ResourceSetLayoutFlags::None) = 0;
 		virtual IResourceSet* createResourceSet(const IResourceSetLayout* layout) = 0;
 		virtual void writeResourceSet(IResourceSet* set, const ResourceSetBinding* bindings, uint32_t bindingCount) = 0;
+		// Bindless heap, null unless RenderDeviceCreateInfo::enableBindless is set and supported.
+		// Add the layout to the pipelines and bind the set once, shaders index its arrays with registered indices,
+		// e.g. passed in push constants, so nothing is rebound per material.
+		// The resources in the heap are not transitioned automatically, textures must be in ShaderResource
+		// and buffers in UnorderedAccess when they are accessed.
+		virtual IResourceSetLayout* getBindlessResourceSetLayout() const = 0;
+		virtual IResourceSet* getBindlessResourceSet() const = 0;
+		// Returns the index of the resource in its array, g_InvalidBindlessIndex if the array is full.
+		virtual uint32_t registerTexture(ITextureView* textureView) = 0;
+		virtual uint32_t registerBuffer(IBuffer* buffer) = 0;
+		virtual uint32_t registerSampler(ISampler* sampler) = 0;
+		// The index is reused once the command lists executed so far have finished.
+		virtual void unregisterTexture(uint32_t index) = 0;
+		virtual void unregisterBuffer(uint32_t index) = 0;
+		virtual void unregisterSampler(uint32_t index) = 0;
 		virtual ITexture* createTexture(const TextureDesc& desc) = 0;
 		virtual IBuffer* createBuffer(const BufferDesc& desc) = 0;
 		virtual IBuffer* createBuffer(const BufferDesc& desc, const void* data, uint64_t dataSize) = 0;
@@ -164,6 +280,11 @@ namespace rhi
 		virtual ICommandList* createCommandList() = 0;
 		virtual uint64_t executeCommandLists(ICommandList** cmdLists, size_t numCmdLists) = 0;
 		virtual void waitForExecution(uint64_t executeID, uint64_t timeout = UINT64_MAX) = 0;
+		// Barrier counters of all command lists executed since the last reset, e.g. reset it every frame.
+		virtual const BarrierStatistics& getBarrierStatistics() const = 0;
+		virtual void resetBarrierStatistics() = 0;
+		// Whether ICommandList::drawIndirectCount and drawIndexedIndirectCount can be used.
+		virtual bool isDrawIndirectCountSupported() const = 0;
 	};
 
 	class ISwapChain
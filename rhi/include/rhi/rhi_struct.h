@@ -19,6 +19,8 @@ namespace rhi
 	class ICommandList;
 	class IRenderDevice;
 	class ISwapChain;
+	class IPipelineCompileTask;
+	struct ShaderReflection;
 
 	// resource 
 
@@ -213,7 +215,10 @@ namespace rhi
 		ShaderResource = 1 << 0,
 		UnorderedAccess = 1 << 1,
 		RenderTarget = 1 << 2,
-		DepthStencil = 1 << 3
+		DepthStencil = 1 << 3,
+		// Source of blitTexture. Multisampled textures and textures with mips are copy sources without it,
+		// for resolveTexture and generateMips.
+		CopySource = 1 << 4
 	};
 	ENUM_CLASS_FLAG_OPERATORS(TextureUsage);
 
@@ -411,16 +416,36 @@ namespace rhi
 		const char* entry = nullptr;
 		const SpecializationConstant* specializationConstants;
 		uint32_t specializationConstantCount = 0;
+		// Parse the resources, push constant block and workgroup size of the code, see IShader::getReflection.
+		bool reflect = false;
 	};
 
 	struct ShaderDesc
 	{
 		ShaderType type = ShaderType::Unknown;
 		const char* entry = nullptr;
+		// Hash of the code, entry point and specialization constants, shaders with the same hash are interchangeable.
+		uint64_t hash = 0;
 	};
 
 	// resource set 
 
+	// Binding slots of the bindless resource set, each is an array indexed with the indices returned by
+	// IRenderDevice::registerTexture, registerBuffer and registerSampler.
+	static constexpr uint32_t g_BindlessTextureBinding = 0;
+	static constexpr uint32_t g_BindlessBufferBinding = 1;
+	static constexpr uint32_t g_BindlessSamplerBinding = 2;
+	static constexpr uint32_t g_InvalidBindlessIndex = UINT32_MAX;
+
+	enum class ResourceSetLayoutFlags : uint8_t
+	{
+		None = 0,
+		// No resource set is created with the layout, its bindings are recorded with ICommandList::pushResourceSet.
+		// Needs VK_KHR_push_descriptor, at most one layout of a pipeline can have it.
+		PushDescriptor = 1 << 0
+	};
+	ENUM_CLASS_FLAG_OPERATORS(ResourceSetLayoutFlags);
+
 	struct ResourceSetLayoutBinding
 	{
 		ShaderType visibleStages = ShaderType::Unknown;
@@ -736,6 +761,28 @@ namespace rhi
 		float lineWidth = 1.0f;
 	};
 
+	// Pipeline states that are set on the command list instead of being baked into the pipeline,
+	// so pipelines that only differ in them can be shared.
+	enum class DynamicState : uint32_t
+	{
+		None = 0,
+		CullMode = 1 << 0,
+		FrontFace = 1 << 1,
+		// Only switches between topologies of the same class (points, lines, triangles or patches) as primType.
+		PrimitiveTopology = 1 << 2,
+		DepthTestEnable = 1 << 3,
+		DepthWriteEnable = 1 << 4,
+		DepthCompareOp = 1 << 5,
+		StencilTestEnable = 1 << 6,
+		StencilOp = 1 << 7,
+		DepthBiasEnable = 1 << 8,
+		PrimitiveRestartEnable = 1 << 9,
+		// The following need RenderDeviceCreateInfo::enableExtendedDynamicState3 and VK_EXT_extended_dynamic_state3.
+		PolygonMode = 1 << 10,
+		DepthClampEnable = 1 << 11
+	};
+	ENUM_CLASS_FLAG_OPERATORS(DynamicState);
+
 	struct Viewport
 	{
 		float minX, maxX;
@@ -846,6 +893,7 @@ namespace rhi
 	struct GraphicsPipelineCreateInfo
 	{
 		PrimitiveType primType = PrimitiveType::TriangleList;
+		bool primitiveRestartEnable = false;
 
 		VertexInputAttribute* vertexInputAttributes;
 		uint32_t vertexInputAttributeCount = 0;
@@ -873,7 +921,12 @@ namespace rhi
 		uint8_t sampleCount = 1;
 		uint32_t patchControlPoints = 0;
 		uint32_t viewportCount = 1;
+		// States left out of the pipeline, set them with the ICommandList setters before drawing.
+		DynamicState dynamicStates = DynamicState::None;
+		// Views the pipeline renders with multiview, needs RenderDeviceCreateInfo::enableMultiview.
+		uint32_t viewMask = 0;
 
+		// Optional cache data the pipeline is created with, merged into the device-wide pipeline cache.
 		const void* cacheData = nullptr;
 		uint64_t cacheSize = 0;
 	};
@@ -888,13 +941,38 @@ namespace rhi
 		const PushConstantDesc* pushConstantDescs;
 		uint32_t pushConstantCount = 0;
 
+		// Optional cache data the pipeline is created with, merged into the device-wide pipeline cache.
 		const void* cacheData = nullptr;
 		uint64_t cacheSize = 0;
 	};
 
+	// Order in which queued asynchronous pipelines are compiled, see IRenderDevice::createGraphicsPipelineAsync.
+	enum class PipelineCompilePriority : uint8_t
+	{
+		Low,
+		Normal,
+		// Pipelines needed this frame.
+		High
+	};
+
+	// Counters of asynchronous pipeline compilation since the device was created.
+	// Only the tasks of createGraphicsPipelineAsync and createComputePipelineAsync are counted, not internal work
+	// such as the link time optimization of fast-linked pipelines.
+	struct PipelineCompileStatistics
+	{
+		// Tasks waiting for a worker thread.
+		uint32_t queuedCount = 0;
+		uint32_t compiledCount = 0;
+		uint32_t failedCount = 0;
+		// Compile times of the finished tasks, summed over all threads.
+		double totalCompileMs = 0.0;
+		double maxCompileMs = 0.0;
+	};
+
 	struct GraphicsPipelineDesc
 	{
 		PrimitiveType primType = PrimitiveType::TriangleList;
+		bool primitiveRestartEnable = false;
 
 		BlendState blendState;
 		RasterState rasterState;
@@ -907,6 +985,8 @@ namespace rhi
 		uint8_t sampleCount = 1;
 		uint32_t patchControlPoints = 0;
 		uint32_t viewportCount = 1;
+		DynamicState dynamicStates = DynamicState::None;
+		uint32_t viewMask = 0;
 	};
 
 	struct GraphicsState
@@ -929,6 +1009,7 @@ namespace rhi
 		IndexBufferBinding indexBuffer;
 
 		IBuffer* indirectBuffer = nullptr;
+		// Ignored inside beginRenderPass/endRenderPass, the render pass decides the attachments and their load ops.
 		// clear all rendertaget
 		bool clearRenderTarget = false;
 		bool clearDepthStencil = false;
@@ -1004,11 +1085,105 @@ namespace rhi
 
 	enum class ClearDepthStencilFlag : uint8_t
 	{
-		Depth = 0 << 0,
-		Stencil = 1 << 0
+		Depth = 1 << 0,
+		Stencil = 1 << 1
 	};
 	ENUM_CLASS_FLAG_OPERATORS(ClearDepthStencilFlag);
 
+	// render pass
+
+	enum class AttachmentLoadOp : uint8_t
+	{
+		Load,
+		Clear,
+		DontCare,
+		// The attachment is not accessed at all, falls back to Load if VK_EXT_load_store_op_none is not supported.
+		None
+	};
+
+	enum class AttachmentStoreOp : uint8_t
+	{
+		Store,
+		DontCare,
+		None
+	};
+
+	// Color attachments are resolved with Average, or SampleZero for integer formats, other modes log an error.
+	// Depth and stencil modes the device doesn't support fall back to SampleZero with an error.
+	enum class ResolveMode : uint8_t
+	{
+		None,
+		// Integer formats fall back to SampleZero.
+		Average,
+		SampleZero,
+		Min,
+		Max
+	};
+
+	struct RenderPassColorAttachment
+	{
+		ITextureView* view = nullptr;
+		AttachmentLoadOp loadOp = AttachmentLoadOp::Load;
+		AttachmentStoreOp storeOp = AttachmentStoreOp::Store;
+		ClearColor clearColor = ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		// Single sampled view of the same format the multisampled view is resolved into at the end of the pass,
+		// use AttachmentStoreOp::DontCare to keep the samples on-chip.
+		ITextureView* resolveView = nullptr;
+		ResolveMode resolveMode = ResolveMode::Average;
+	};
+
+	struct RenderPassDepthStencilAttachment
+	{
+		ITextureView* view = nullptr;
+		AttachmentLoadOp depthLoadOp = AttachmentLoadOp::Load;
+		AttachmentStoreOp depthStoreOp = AttachmentStoreOp::Store;
+		AttachmentLoadOp stencilLoadOp = AttachmentLoadOp::Load;
+		AttachmentStoreOp stencilStoreOp = AttachmentStoreOp::Store;
+		float clearDepth = 1.0f;
+		uint8_t clearStencil = 0;
+		// SampleZero is the only depth stencil resolve mode every device supports.
+		ITextureView* resolveView = nullptr;
+		ResolveMode depthResolveMode = ResolveMode::SampleZero;
+		ResolveMode stencilResolveMode = ResolveMode::SampleZero;
+	};
+
+	struct RenderPassDesc
+	{
+		RenderPassColorAttachment colorAttachments[g_MaxColorAttachments]{};
+		uint32_t colorAttachmentCount = 0;
+		RenderPassDepthStencilAttachment depthStencilAttachment;
+		// Bit i renders view i into layer i of every attachment, one recorded draw covers all views.
+		// Must match the viewMask of the pipelines drawn in the pass, 0 disables multiview.
+		uint32_t viewMask = 0;
+	};
+
+	struct ClearStatistics
+	{
+		// Clears merged into the load op of the render pass that used the view next.
+		uint32_t foldedClearCount = 0;
+		// Clears recorded as vkCmdClearAttachments, vkCmdClearColorImage or vkCmdClearDepthStencilImage.
+		uint32_t explicitClearCount = 0;
+	};
+
+	struct BarrierStatistics
+	{
+		// Number of vkCmdPipelineBarrier2 calls.
+		uint32_t pipelineBarrierCount = 0;
+		uint32_t imageBarrierCount = 0;
+		uint32_t bufferBarrierCount = 0;
+		uint32_t memoryBarrierCount = 0;
+		uint32_t splitBarrierCount = 0;
+		// Image barriers that change the image layout.
+		uint32_t layoutTransitionCount = 0;
+		// Barriers between two read only states, nothing has to be made visible by them.
+		uint32_t readToReadCount = 0;
+		// Barriers that wait on or block all commands.
+		uint32_t allCommandsCount = 0;
+		// Combination of all source and destination stages, as VkPipelineStageFlags2.
+		uint64_t srcStageMask = 0;
+		uint64_t dstStageMask = 0;
+	};
+
 	// render device
 
 	enum class MessageSeverity : uint8_t
@@ -1034,6 +1209,33 @@ namespace rhi
 		bool enableSamplerAnisotropy;
 		bool enableDepthClamp;
 		bool enableDepthBiasClamp;
+		// Dynamic polygon mode and depth clamp, ignored if the device doesn't support VK_EXT_extended_dynamic_state3.
+		bool enableExtendedDynamicState3;
+		bool enableMultiview;
+		// Device-global bindless heap, see IRenderDevice::getBindlessResourceSet. A count of 0 uses a default size,
+		// counts are clamped to the update after bind limits of the device.
+		bool enableBindless;
+		uint32_t maxBindlessTextures;
+		uint32_t maxBindlessBuffers;
+		uint32_t maxBindlessSamplers;
+		// SPIR-V of shaders/mip_downsample.comp, generateMips falls back to it for formats that can't be blitted.
+		const uint32_t* mipDownsampleShaderCode;
+		size_t mipDownsampleShaderCodeSize;
+		// Store resource sets in one device-wide descriptor buffer (VK_EXT_descriptor_buffer) instead of descriptor pools,
+		// falls back to descriptor pools if unsupported. A size of 0 uses a default size. Can't be combined with
+		// ResourceSetLayoutFlags::PushDescriptor and the bindless heap.
+		bool enableDescriptorBuffer;
+		uint64_t descriptorBufferSize;
+		// Device-wide pipeline cache loaded from this file and saved back to it when the device is destroyed,
+		// see IRenderDevice::savePipelineCache. Null keeps the cache in memory.
+		const char* pipelineCacheFilePath;
+		// Worker threads of the asynchronous pipeline creation, started by the first request.
+		// 0 uses one less than the number of hardware threads.
+		uint32_t pipelineCompileThreadCount;
+		// Build graphics pipelines from separately compiled and cached parts (VK_EXT_graphics_pipeline_library).
+		// New combinations of known parts are fast-linked and usable at once, the link time optimized pipeline replaces
+		// them once a pipeline compile thread built it. Ignored if the device doesn't support fast linking.
+		bool enableGraphicsPipelineLibrary;
 	};
 
 	// swap chain
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <tuple>
+
+namespace rhi
+{
+	// A resource a shader declares. visibleStages of the layout binding is the stage of the shader,
+	// arrayElementCount is 0 for runtime arrays.
+	struct ShaderReflectionBinding
+	{
+		uint32_t set = 0;
+		ResourceSetLayoutBinding layoutBinding;
+	};
+
+	// What the SPIR-V module of a shader declares, see ShaderCreateInfo::reflect and IShader::getReflection.
+	struct ShaderReflection
+	{
+		ShaderType stage = ShaderType::Unknown;
+		std::vector<ShaderReflectionBinding> bindings;
+		// Byte range of the push constant block, both 0 if the shader has none.
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0;
+		// LocalSize of a compute entry point, 0 if it isn't a literal.
+		uint32_t workgroupSize[3]{};
+	};
+
+	// Parses the descriptor bindings, push constant block and workgroup size of an entry point of a SPIR-V module.
+	// Only the resources the entry point or the functions it calls access are reflected.
+	// False if the code isn't valid SPIR-V.
+	bool reflectShader(const uint32_t* code, size_t codeSize, ShaderType stage, const char* entry, ShaderReflection& reflection);
+
+	// Derives the resource set layouts of a pipeline from the reflection of its shaders and shares identical
+	// layouts between pipelines. A binding is only visible to the stages that declare it, so resource sets
+	// aren't transitioned for stages that never access them. The layouts are owned by the cache.
+	class ReflectedLayoutCache
+	{
+	public:
+		explicit ReflectedLayoutCache(IRenderDevice* renderDevice)
+			:m_RenderDevice(renderDevice) {}
+		ReflectedLayoutCache(const ReflectedLayoutCache&) = delete;
+		ReflectedLayoutCache& operator=(const ReflectedLayoutCache&) = delete;
+
+		// Writes the layouts of sets 0 to setCount - 1 into resourceSetLayouts, which holds g_MaxBoundDescriptorSets entries.
+		// Fails if a shader has no reflection, the shaders disagree on a binding, a set in between is unused
+		// or a binding is a runtime array.
+		bool getResourceSetLayouts(IShader* const* shaders, uint32_t shaderCount,
+			IResourceSetLayout** resourceSetLayouts, uint32_t& setCount);
+		// One PushConstantDesc per distinct push constant block, shaders declaring the same block share its desc and
+		// setPushConstant takes their combined stages. pushConstantDescs holds shaderCount entries.
+		// Fails if the reflected offsets don't match the ranges pipeline creation lays out one after another.
+		static bool getPushConstantDescs(IShader* const* shaders, uint32_t shaderCount,
+			PushConstantDesc* pushConstantDescs, uint32_t& pushConstantCount);
+	private:
+		// (bindingSlot, type, arrayElementCount, visibleStages) sorted by bindingSlot
+		using LayoutKey = std::vector<std::tuple<uint32_t, ShaderResourceType, uint32_t, ShaderType>>;
+
+		IRenderDevice* m_RenderDevice;
+		std::map<LayoutKey, std::unique_ptr<IResourceSetLayout>> m_Layouts;
+	};
+}
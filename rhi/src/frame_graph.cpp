@@ -0,0 +1,526 @@
+#include "rhi/frame_graph.h"
+#include "rhi/common/Error.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace rhi
+{
+	static bool textureDescsAreEqual(const TextureDesc& a, const TextureDesc& b)
+	{
+		return a.dimension == b.dimension &&
+			a.width == b.width &&
+			a.height == b.height &&
+			a.arraySize == b.arraySize &&
+			a.depth == b.depth &&
+			a.sampleCount == b.sampleCount &&
+			a.mipLevels == b.mipLevels &&
+			a.format == b.format &&
+			a.usage == b.usage;
+	}
+
+	static bool bufferDescsAreEqual(const BufferDesc& a, const BufferDesc& b)
+	{
+		return a.size == b.size && a.access == b.access && a.usage == b.usage;
+	}
+
+	FrameGraphResource FrameGraphPassBuilder::createTexture(const char* name, const TextureDesc& desc)
+	{
+		FrameGraph::ResourceNode node;
+		node.name = name;
+		node.type = FrameGraph::ResourceType::Texture;
+		node.textureDesc = desc;
+		return m_Graph.addResource(std::move(node));
+	}
+
+	FrameGraphResource FrameGraphPassBuilder::createBuffer(const char* name, const BufferDesc& desc)
+	{
+		FrameGraph::ResourceNode node;
+		node.name = name;
+		node.type = FrameGraph::ResourceType::Buffer;
+		node.bufferDesc = desc;
+		return m_Graph.addResource(std::move(node));
+	}
+
+	FrameGraphResource FrameGraphPassBuilder::read(FrameGraphResource resource, ResourceState state)
+	{
+		assert(resource.isValid() && resource.index < m_Graph.m_Resources.size());
+		m_Graph.m_Passes[m_PassIndex].reads.push_back({ resource, state });
+		return resource;
+	}
+
+	FrameGraphResource FrameGraphPassBuilder::write(FrameGraphResource resource, ResourceState state)
+	{
+		assert(resource.isValid() && resource.index < m_Graph.m_Resources.size());
+		m_Graph.m_Passes[m_PassIndex].writes.push_back({ resource, state });
+		m_Graph.m_Resources[resource.index].writerPasses.push_back(m_PassIndex);
+		return resource;
+	}
+
+	void FrameGraphPassBuilder::setSideEffect()
+	{
+		m_Graph.m_Passes[m_PassIndex].hasSideEffect = true;
+	}
+
+	ITexture* FrameGraphPassResources::getTexture(FrameGraphResource resource) const
+	{
+		assert(resource.isValid() && resource.index < m_Graph.m_Resources.size());
+		const FrameGraph::ResourceNode& node = m_Graph.m_Resources[resource.index];
+		ASSERT_MSG(node.type == FrameGraph::ResourceType::Texture, "Resource ", node.name, " is not a texture.");
+		return node.texture;
+	}
+
+	IBuffer* FrameGraphPassResources::getBuffer(FrameGraphResource resource) const
+	{
+		assert(resource.isValid() && resource.index < m_Graph.m_Resources.size());
+		const FrameGraph::ResourceNode& node = m_Graph.m_Resources[resource.index];
+		ASSERT_MSG(node.type == FrameGraph::ResourceType::Buffer, "Resource ", node.name, " is not a buffer.");
+		return node.buffer;
+	}
+
+	FrameGraph::FrameGraph(IRenderDevice* renderDevice)
+		:m_RenderDevice(renderDevice)
+	{
+		assert(renderDevice);
+	}
+
+	FrameGraph::~FrameGraph()
+	{
+		// transient resources and command lists may still be referenced by in flight submissions.
+		m_RenderDevice->waitIdle();
+	}
+
+	FrameGraphResource FrameGraph::addResource(ResourceNode&& node)
+	{
+		FrameGraphResource resource;
+		resource.index = static_cast<uint32_t>(m_Resources.size());
+		m_Resources.push_back(std::move(node));
+		m_Compiled = false;
+		return resource;
+	}
+
+	FrameGraphResource FrameGraph::importTexture(const char* name, ITexture* texture)
+	{
+		assert(texture);
+		ResourceNode node;
+		node.name = name;
+		node.type = ResourceType::Texture;
+		node.imported = true;
+		node.textureDesc = texture->getDesc();
+		node.texture = texture;
+		return addResource(std::move(node));
+	}
+
+	FrameGraphResource FrameGraph::importBuffer(const char* name, IBuffer* buffer)
+	{
+		assert(buffer);
+		ResourceNode node;
+		node.name = name;
+		node.type = ResourceType::Buffer;
+		node.imported = true;
+		node.bufferDesc = buffer->getDesc();
+		node.buffer = buffer;
+		return addResource(std::move(node));
+	}
+
+	void FrameGraph::addPass(const char* name, const SetupFunc& setup, ExecuteFunc execute)
+	{
+		uint32_t passIndex = static_cast<uint32_t>(m_Passes.size());
+		PassNode& pass = m_Passes.emplace_back();
+		pass.name = name;
+		pass.execute = std::move(execute);
+
+		FrameGraphPassBuilder builder(*this, passIndex);
+		setup(builder);
+		m_Compiled = false;
+	}
+
+	void FrameGraph::cullPasses()
+	{
+		for (PassNode& pass : m_Passes)
+		{
+			pass.refCount = static_cast<uint32_t>(pass.writes.size());
+			pass.culled = false;
+		}
+
+		std::vector<uint32_t> unreferencedResources;
+		for (uint32_t i = 0; i < m_Resources.size(); ++i)
+		{
+			ResourceNode& resource = m_Resources[i];
+			// imported resources are consumed outside of the graph.
+			resource.refCount = resource.imported ? 1 : 0;
+		}
+		for (const PassNode& pass : m_Passes)
+		{
+			for (const ResourceAccess& access : pass.reads)
+			{
+				++m_Resources[access.resource.index].refCount;
+			}
+		}
+		for (uint32_t i = 0; i < m_Resources.size(); ++i)
+		{
+			if (m_Resources[i].refCount == 0)
+			{
+				unreferencedResources.push_back(i);
+			}
+		}
+
+		// Flood fill from the unreferenced resources, a pass is culled when nothing
+		// reads any of the resources it writes, which may in turn leave its inputs unreferenced.
+		while (!unreferencedResources.empty())
+		{
+			uint32_t resourceIndex = unreferencedResources.back();
+			unreferencedResources.pop_back();
+
+			for (uint32_t passIndex : m_Resources[resourceIndex].writerPasses)
+			{
+				PassNode& pass = m_Passes[passIndex];
+				if (pass.refCount == 0 || --pass.refCount != 0 || pass.hasSideEffect)
+				{
+					continue;
+				}
+
+				pass.culled = true;
+				for (const ResourceAccess& access : pass.reads)
+				{
+					if (--m_Resources[access.resource.index].refCount == 0)
+					{
+						unreferencedResources.push_back(access.resource.index);
+					}
+				}
+			}
+		}
+
+		// passes that write nothing and have no side effect produce nothing.
+		for (PassNode& pass : m_Passes)
+		{
+			if (pass.writes.empty() && !pass.hasSideEffect)
+			{
+				pass.culled = true;
+			}
+		}
+	}
+
+	void FrameGraph::computeLifetimes()
+	{
+		for (ResourceNode& resource : m_Resources)
+		{
+			resource.firstPass = UINT32_MAX;
+			resource.lastPass = 0;
+		}
+
+		auto extendLifetime = [this](FrameGraphResource resource, uint32_t passIndex)
+			{
+				ResourceNode& node = m_Resources[resource.index];
+				node.firstPass = (std::min)(node.firstPass, passIndex);
+				node.lastPass = (std::max)(node.lastPass, passIndex);
+			};
+
+		for (uint32_t i = 0; i < m_Passes.size(); ++i)
+		{
+			const PassNode& pass = m_Passes[i];
+			if (pass.culled)
+			{
+				continue;
+			}
+			for (const ResourceAccess& access : pass.reads)
+			{
+				extendLifetime(access.resource, i);
+			}
+			for (const ResourceAccess& access : pass.writes)
+			{
+				extendLifetime(access.resource, i);
+			}
+		}
+	}
+
+	ITexture* FrameGraph::acquireTexture(const TextureDesc& desc)
+	{
+		for (TransientTexture& transient : m_TransientTextures)
+		{
+			if (!transient.inUse && textureDescsAreEqual(transient.texture->getDesc(), desc))
+			{
+				transient.inUse = true;
+				return transient.texture.get();
+			}
+		}
+
+		TransientTexture& transient = m_TransientTextures.emplace_back();
+		transient.texture = std::unique_ptr<ITexture>(m_RenderDevice->createTexture(desc));
+		transient.inUse = true;
+		return transient.texture.get();
+	}
+
+	IBuffer* FrameGraph::acquireBuffer(const BufferDesc& desc)
+	{
+		for (TransientBuffer& transient : m_TransientBuffers)
+		{
+			if (!transient.inUse && bufferDescsAreEqual(transient.buffer->getDesc(), desc))
+			{
+				transient.inUse = true;
+				return transient.buffer.get();
+			}
+		}
+
+		TransientBuffer& transient = m_TransientBuffers.emplace_back();
+		transient.buffer = std::unique_ptr<IBuffer>(m_RenderDevice->createBuffer(desc));
+		transient.inUse = true;
+		return transient.buffer.get();
+	}
+
+	void FrameGraph::compile()
+	{
+		cullPasses();
+		computeLifetimes();
+
+		m_Statistics = {};
+		m_Statistics.passCount = static_cast<uint32_t>(m_Passes.size());
+
+		for (TransientTexture& transient : m_TransientTextures)
+		{
+			transient.inUse = false;
+		}
+		for (TransientBuffer& transient : m_TransientBuffers)
+		{
+			transient.inUse = false;
+		}
+
+		// Walk the live passes in order and hand out physical resources for the lifetime of every
+		// transient resource. Once its last user is done the physical resource goes back to the pool,
+		// so a later transient resource with the same desc aliases it.
+		std::vector<const void*> physicalResources;
+		for (uint32_t i = 0; i < m_Passes.size(); ++i)
+		{
+			const PassNode& pass = m_Passes[i];
+			if (pass.culled)
+			{
+				++m_Statistics.culledPassCount;
+				continue;
+			}
+
+			// Acquired by the first live pass that accesses the resource, which isn't the creator if that was culled.
+			// Resources no live pass accesses have no firstPass and are never acquired.
+			for (ResourceNode& node : m_Resources)
+			{
+				if (node.imported || node.firstPass != i)
+				{
+					continue;
+				}
+				if (node.type == ResourceType::Texture)
+				{
+					node.texture = acquireTexture(node.textureDesc);
+					physicalResources.push_back(node.texture);
+				}
+				else
+				{
+					node.buffer = acquireBuffer(node.bufferDesc);
+					physicalResources.push_back(node.buffer);
+				}
+				++m_Statistics.transientResourceCount;
+			}
+
+			for (ResourceNode& node : m_Resources)
+			{
+				if (node.imported || node.lastPass != i || node.firstPass == UINT32_MAX)
+				{
+					continue;
+				}
+				if (node.type == ResourceType::Texture)
+				{
+					for (TransientTexture& transient : m_TransientTextures)
+					{
+						if (transient.texture.get() == node.texture)
+						{
+							transient.inUse = false;
+						}
+					}
+				}
+				else
+				{
+					for (TransientBuffer& transient : m_TransientBuffers)
+					{
+						if (transient.buffer.get() == node.buffer)
+						{
+							transient.inUse = false;
+						}
+					}
+				}
+			}
+		}
+
+		std::sort(physicalResources.begin(), physicalResources.end());
+		m_Statistics.physicalResourceCount = static_cast<uint32_t>(
+			std::unique(physicalResources.begin(), physicalResources.end()) - physicalResources.begin());
+
+		m_Compiled = true;
+	}
+
+	ResourceState FrameGraph::getResourceState(const ResourceNode& node)
+	{
+		if (node.type == ResourceType::Texture)
+		{
+			return node.texture ? node.texture->getState() : ResourceState::Undefined;
+		}
+		return node.buffer ? node.buffer->getState() : ResourceState::Undefined;
+	}
+
+	void FrameGraph::recordBarriers(const PassNode& pass, ICommandList* cmdList)
+	{
+		auto transition = [this, cmdList](const ResourceAccess& access)
+			{
+				const ResourceNode& node = m_Resources[access.resource.index];
+				if (node.type == ResourceType::Texture)
+				{
+					cmdList->transitionTextureState(node.texture, access.state);
+				}
+				else
+				{
+					cmdList->transitionBufferState(node.buffer, access.state);
+				}
+			};
+
+		for (const ResourceAccess& access : pass.reads)
+		{
+			transition(access);
+		}
+		for (const ResourceAccess& access : pass.writes)
+		{
+			transition(access);
+		}
+		// one vkCmdPipelineBarrier2 for everything the pass touches.
+		cmdList->commitBarriers();
+		++m_Statistics.barrierBatchCount;
+	}
+
+	void FrameGraph::execute(ICommandList* cmdList)
+	{
+		assert(cmdList);
+		if (!m_Compiled)
+		{
+			compile();
+		}
+
+		FrameGraphPassResources resources(*this);
+		// The graph already knows every state a pass needs.
+		bool autoTransition = cmdList->getResourceAutoTransition();
+		cmdList->setResourceAutoTransition(false);
+		for (const PassNode& pass : m_Passes)
+		{
+			if (pass.culled)
+			{
+				continue;
+			}
+			recordBarriers(pass, cmdList);
+			pass.execute(resources, cmdList);
+		}
+		cmdList->setResourceAutoTransition(autoTransition);
+	}
+
+	uint64_t FrameGraph::executeParallel(uint32_t threadCount)
+	{
+		if (!m_Compiled)
+		{
+			compile();
+		}
+
+		std::vector<const PassNode*> livePasses;
+		for (const PassNode& pass : m_Passes)
+		{
+			if (!pass.culled)
+			{
+				livePasses.push_back(&pass);
+			}
+		}
+		if (livePasses.empty())
+		{
+			return 0;
+		}
+
+		while (m_CommandLists.size() < livePasses.size())
+		{
+			m_CommandLists.emplace_back(m_RenderDevice->createCommandList());
+		}
+
+		// Resource states are tracked on the resources themselves, so barriers are recorded serially
+		// in pass order. After that the pass bodies only touch their own command list.
+		for (size_t i = 0; i < livePasses.size(); ++i)
+		{
+			ICommandList* cmdList = m_CommandLists[i].get();
+			cmdList->open();
+			cmdList->setResourceAutoTransition(false);
+			recordBarriers(*livePasses[i], cmdList);
+		}
+
+#if !defined NDEBUG
+		// The states are those after the last pass now. Auto-transition stays off until the lists are closed, so the
+		// pending clears close() flushes don't transition from them either, they are recorded in the CopyDest layout
+		// the pass declared. Commands that transition regardless, e.g. generateMips, would record barriers from the
+		// wrong state and race between the workers, a pass body must not change any state.
+		std::vector<ResourceState> statesBeforeExecute(m_Resources.size(), ResourceState::Undefined);
+		for (size_t i = 0; i < m_Resources.size(); ++i)
+		{
+			statesBeforeExecute[i] = getResourceState(m_Resources[i]);
+		}
+#endif
+
+		FrameGraphPassResources resources(*this);
+		std::atomic<size_t> nextPass{ 0 };
+		auto worker = [&]()
+			{
+				for (size_t i = nextPass++; i < livePasses.size(); i = nextPass++)
+				{
+					ICommandList* cmdList = m_CommandLists[i].get();
+					livePasses[i]->execute(resources, cmdList);
+					cmdList->close();
+				}
+			};
+
+#if defined RHI_ENABLE_THREAD_RECORDING
+		threadCount = (std::max)(1u, (std::min)(threadCount, static_cast<uint32_t>(livePasses.size())));
+#else
+		// Without the device locks command lists can't allocate resource sets and upload memory concurrently.
+		threadCount = 1;
+#endif
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; ++i)
+		{
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+#if !defined NDEBUG
+		for (size_t i = 0; i < m_Resources.size(); ++i)
+		{
+			ASSERT_MSG(getResourceState(m_Resources[i]) == statesBeforeExecute[i], "A pass body of executeParallel changed the state of ",
+				m_Resources[i].name, ", declare the access in the setup of the pass instead");
+		}
+#endif
+
+		std::vector<ICommandList*> cmdLists;
+		for (size_t i = 0; i < livePasses.size(); ++i)
+		{
+			cmdLists.push_back(m_CommandLists[i].get());
+		}
+		return m_RenderDevice->executeCommandLists(cmdLists.data(), cmdLists.size());
+	}
+
+	void FrameGraph::reset()
+	{
+		m_Passes.clear();
+		m_Resources.clear();
+		for (TransientTexture& transient : m_TransientTextures)
+		{
+			transient.inUse = false;
+		}
+		for (TransientBuffer& transient : m_TransientBuffers)
+		{
+			transient.inUse = false;
+		}
+		m_Compiled = false;
+	}
+}
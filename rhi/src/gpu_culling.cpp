@@ -0,0 +1,274 @@
+#include "rhi/gpu_culling.h"
+#include "rhi/common/Error.h"
+
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace rhi
+{
+	// Matches the ViewData uniform block of shaders/gpu_culling.comp (std140).
+	struct GpuCullingViewData
+	{
+		float frustumPlanes[6][4];
+		float viewProjection[16];
+		uint32_t instanceCount;
+		uint32_t padding[3];
+	};
+
+	static constexpr uint32_t g_CullingGroupSize = 64;
+
+	GpuCulling* GpuCulling::create(IRenderDevice* renderDevice, const GpuCullingCreateInfo& createInfo)
+	{
+		assert(renderDevice);
+		auto culling = new GpuCulling(renderDevice);
+		if (!culling->init(createInfo))
+		{
+			delete culling;
+			return nullptr;
+		}
+		return culling;
+	}
+
+	GpuCulling::~GpuCulling() = default;
+
+	bool GpuCulling::init(const GpuCullingCreateInfo& createInfo)
+	{
+		if (!m_RenderDevice->isDrawIndirectCountSupported())
+		{
+			LOG_ERROR("GpuCulling needs drawIndirectCount, which is not supported by the device");
+			return false;
+		}
+		if (!createInfo.shaderCode || createInfo.shaderCodeSize == 0)
+		{
+			LOG_ERROR("GpuCulling needs the SPIR-V of gpu_culling.comp");
+			return false;
+		}
+		if (createInfo.maxInstanceCount == 0 || createInfo.maxMeshCount == 0)
+		{
+			LOG_ERROR("GpuCulling needs at least one instance and one mesh");
+			return false;
+		}
+		if (createInfo.enableOcclusionCulling && !createInfo.hizView)
+		{
+			LOG_ERROR("Occlusion culling is enabled without a depth pyramid");
+			return false;
+		}
+
+		m_MaxInstanceCount = createInfo.maxInstanceCount;
+		m_MaxMeshCount = createInfo.maxMeshCount;
+
+		SpecializationConstant occlusionCulling = SpecializationConstant::UInt32(0, createInfo.enableOcclusionCulling ? 1 : 0);
+		ShaderCreateInfo shaderCI{};
+		shaderCI.type = ShaderType::Compute;
+		shaderCI.entry = "main";
+		shaderCI.specializationConstants = &occlusionCulling;
+		shaderCI.specializationConstantCount = 1;
+		m_Shader.reset(m_RenderDevice->createShader(shaderCI, createInfo.shaderCode, createInfo.shaderCodeSize));
+		if (!m_Shader)
+		{
+			return false;
+		}
+
+		ResourceSetLayoutBinding layoutBindings[] =
+		{
+			ResourceSetLayoutBinding::UniformBuffer(ShaderType::Compute, 0),
+			ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 1),
+			ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 2),
+			ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 3),
+			ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 4),
+			ResourceSetLayoutBinding::TextureWithSampler(ShaderType::Compute, 5)
+		};
+		m_ResourceSetLayout.reset(m_RenderDevice->createResourceSetLayout(layoutBindings,
+			static_cast<uint32_t>(std::size(layoutBindings))));
+		if (!m_ResourceSetLayout)
+		{
+			return false;
+		}
+
+		IResourceSetLayout* setLayouts[] = { m_ResourceSetLayout.get() };
+		ComputePipelineCreateInfo pipelineCI{};
+		pipelineCI.computeShader = m_Shader.get();
+		pipelineCI.resourceSetLayouts = setLayouts;
+		pipelineCI.resourceSetLayoutCount = 1;
+		pipelineCI.pushConstantDescs = nullptr;
+		pipelineCI.pushConstantCount = 0;
+		m_Pipeline.reset(m_RenderDevice->createComputePipeline(pipelineCI));
+		if (!m_Pipeline)
+		{
+			return false;
+		}
+
+		BufferDesc bufferDesc{};
+		bufferDesc.access = BufferAccess::GpuOnly;
+
+		bufferDesc.size = sizeof(GpuCullingViewData);
+		bufferDesc.usage = BufferUsage::UniformBuffer;
+		m_ViewBuffer.reset(m_RenderDevice->createBuffer(bufferDesc));
+
+		bufferDesc.size = sizeof(GpuCullingInstance) * m_MaxInstanceCount;
+		bufferDesc.usage = BufferUsage::StorageBuffer;
+		m_InstanceBuffer.reset(m_RenderDevice->createBuffer(bufferDesc));
+
+		bufferDesc.size = sizeof(GpuCullingMesh) * m_MaxMeshCount;
+		m_MeshBuffer.reset(m_RenderDevice->createBuffer(bufferDesc));
+
+		bufferDesc.size = sizeof(DrawIndexedIndirectCommand) * m_MaxInstanceCount;
+		bufferDesc.usage = BufferUsage::StorageBuffer | BufferUsage::IndirectBuffer;
+		m_DrawCommandBuffer.reset(m_RenderDevice->createBuffer(bufferDesc));
+
+		bufferDesc.size = sizeof(uint32_t);
+		m_DrawCountBuffer.reset(m_RenderDevice->createBuffer(bufferDesc));
+
+		if (!m_ViewBuffer || !m_InstanceBuffer || !m_MeshBuffer || !m_DrawCommandBuffer || !m_DrawCountBuffer)
+		{
+			return false;
+		}
+
+		ITextureView* hizView = createInfo.hizView;
+		if (!createInfo.enableOcclusionCulling)
+		{
+			// the binding is statically unused, but every binding of a set must be written
+			TextureDesc dummyDesc{};
+			dummyDesc.dimension = TextureDimension::Texture2D;
+			dummyDesc.format = Format::R32_FLOAT;
+			dummyDesc.usage = TextureUsage::ShaderResource;
+			m_DummyHizTexture.reset(m_RenderDevice->createTexture(dummyDesc));
+			if (!m_DummyHizTexture)
+			{
+				return false;
+			}
+			hizView = m_DummyHizTexture->getDefaultView();
+		}
+
+		SamplerDesc samplerDesc{};
+		samplerDesc.magFilter = FilterMode::nearest;
+		samplerDesc.minFilter = FilterMode::nearest;
+		samplerDesc.mipmapMode = FilterMode::nearest;
+		m_HizSampler.reset(m_RenderDevice->createSampler(samplerDesc));
+		if (!m_HizSampler)
+		{
+			return false;
+		}
+
+		m_ResourceSet.reset(m_RenderDevice->createResourceSet(m_ResourceSetLayout.get()));
+		if (!m_ResourceSet)
+		{
+			return false;
+		}
+		ResourceSetBinding bindings[] =
+		{
+			ResourceSetBinding::UniformBuffer(m_ViewBuffer.get(), 0),
+			ResourceSetBinding::StorageBuffer(m_InstanceBuffer.get(), 1),
+			ResourceSetBinding::StorageBuffer(m_MeshBuffer.get(), 2),
+			ResourceSetBinding::StorageBuffer(m_DrawCommandBuffer.get(), 3),
+			ResourceSetBinding::StorageBuffer(m_DrawCountBuffer.get(), 4),
+			ResourceSetBinding::TextureWithSampler(hizView, m_HizSampler.get(), 5)
+		};
+		m_RenderDevice->writeResourceSet(m_ResourceSet.get(), bindings, static_cast<uint32_t>(std::size(bindings)));
+
+		return true;
+	}
+
+	void GpuCulling::computeFrustumPlanes(const float viewProjection[16], float frustumPlanes[6][4])
+	{
+		// row i of the column major matrix
+		auto row = [viewProjection](uint32_t i, uint32_t j) { return viewProjection[j * 4 + i]; };
+
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			frustumPlanes[0][j] = row(3, j) + row(0, j); // left
+			frustumPlanes[1][j] = row(3, j) - row(0, j); // right
+			frustumPlanes[2][j] = row(3, j) + row(1, j); // bottom
+			frustumPlanes[3][j] = row(3, j) - row(1, j); // top
+			frustumPlanes[4][j] = row(2, j);             // near, z >= 0
+			frustumPlanes[5][j] = row(3, j) - row(2, j); // far
+		}
+
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			float* plane = frustumPlanes[i];
+			float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length > 0.f)
+			{
+				for (uint32_t j = 0; j < 4; ++j)
+				{
+					plane[j] /= length;
+				}
+			}
+		}
+	}
+
+	void GpuCulling::updateInstances(ICommandList* cmdList, const GpuCullingInstance* instances, uint32_t instanceCount, uint32_t firstInstance)
+	{
+		assert(cmdList);
+		assert(firstInstance + instanceCount <= m_MaxInstanceCount);
+		if (instanceCount == 0)
+		{
+			return;
+		}
+		cmdList->updateBuffer(m_InstanceBuffer.get(), instances, sizeof(GpuCullingInstance) * instanceCount,
+			sizeof(GpuCullingInstance) * firstInstance);
+	}
+
+	void GpuCulling::updateMeshes(ICommandList* cmdList, const GpuCullingMesh* meshes, uint32_t meshCount)
+	{
+		assert(cmdList);
+		assert(meshCount <= m_MaxMeshCount);
+		if (meshCount == 0)
+		{
+			return;
+		}
+		cmdList->updateBuffer(m_MeshBuffer.get(), meshes, sizeof(GpuCullingMesh) * meshCount, 0);
+	}
+
+	void GpuCulling::setInstanceCount(uint32_t instanceCount)
+	{
+		assert(instanceCount <= m_MaxInstanceCount);
+		m_InstanceCount = instanceCount;
+	}
+
+	void GpuCulling::cull(ICommandList* cmdList, const GpuCullingView& view)
+	{
+		assert(cmdList);
+
+		GpuCullingViewData viewData{};
+		std::memcpy(viewData.frustumPlanes, view.frustumPlanes, sizeof(viewData.frustumPlanes));
+		std::memcpy(viewData.viewProjection, view.viewProjection, sizeof(viewData.viewProjection));
+		viewData.instanceCount = m_InstanceCount;
+		cmdList->updateBuffer(m_ViewBuffer.get(), &viewData, sizeof(viewData), 0);
+
+		const uint32_t zero = 0;
+		cmdList->updateBuffer(m_DrawCountBuffer.get(), &zero, sizeof(zero), 0);
+
+		if (m_InstanceCount == 0)
+		{
+			return;
+		}
+
+		ComputeState state{};
+		state.pipeline = m_Pipeline.get();
+		state.resourceSets[0] = m_ResourceSet.get();
+		state.resourceSetCount = 1;
+		cmdList->setComputeState(state);
+		cmdList->dispatch((m_InstanceCount + g_CullingGroupSize - 1) / g_CullingGroupSize, 1, 1);
+	}
+
+	void GpuCulling::prepareDraw(ICommandList* cmdList)
+	{
+		assert(cmdList);
+		cmdList->transitionBufferState(m_DrawCommandBuffer.get(), ResourceState::IndirectBuffer);
+		cmdList->transitionBufferState(m_DrawCountBuffer.get(), ResourceState::IndirectBuffer);
+		cmdList->commitBarriers();
+	}
+
+	void GpuCulling::draw(ICommandList* cmdList)
+	{
+		assert(cmdList);
+		if (m_InstanceCount == 0)
+		{
+			return;
+		}
+		cmdList->drawIndexedIndirectCount(m_DrawCommandBuffer.get(), 0, m_DrawCountBuffer.get(), 0, m_InstanceCount);
+	}
+}
@@ -0,0 +1,256 @@
+#include "rhi/pipeline_state_cache.h"
+
+namespace rhi
+{
+	static void appendStencilOpState(std::vector<uint64_t>& key, const StencilOpState& state, bool dynamicOps)
+	{
+		if (!dynamicOps)
+		{
+			key.push_back(static_cast<uint64_t>(state.failOp));
+			key.push_back(static_cast<uint64_t>(state.passOp));
+			key.push_back(static_cast<uint64_t>(state.depthFailOp));
+			key.push_back(static_cast<uint64_t>(state.compareOp));
+		}
+		key.push_back(state.writeMask);
+		key.push_back(state.compareMak);
+		key.push_back(state.referenceValue);
+	}
+
+	// Layouts are keyed by their content like the pipeline layouts of the device, a layout handle may be reused once
+	// the layout is destroyed.
+	static void appendLayouts(std::vector<uint64_t>& key, const IResourceSetLayout* bindlessLayout,
+		IResourceSetLayout* const* resourceSetLayouts, uint32_t resourceSetLayoutCount,
+		const PushConstantDesc* pushConstantDescs, uint32_t pushConstantCount)
+	{
+		key.push_back(resourceSetLayoutCount);
+		for (uint32_t i = 0; i < resourceSetLayoutCount; ++i)
+		{
+			if (bindlessLayout && resourceSetLayouts[i] == bindlessLayout)
+			{
+				// update after bind, unlike a user layout with the same bindings
+				key.push_back(UINT64_MAX);
+				continue;
+			}
+			const ResourceSetLayoutBinding* bindings = resourceSetLayouts[i]->getBindings();
+			uint32_t bindingCount = resourceSetLayouts[i]->getBindingCount();
+			key.push_back(bindingCount);
+			key.push_back(static_cast<uint64_t>(resourceSetLayouts[i]->getFlags()));
+			for (uint32_t j = 0; j < bindingCount; ++j)
+			{
+				const ResourceSetLayoutBinding& binding = bindings[j];
+				key.push_back(binding.bindingSlot);
+				key.push_back(static_cast<uint64_t>(binding.type));
+				key.push_back(binding.arrayElementCount);
+				key.push_back(static_cast<uint64_t>(binding.visibleStages));
+			}
+		}
+		key.push_back(pushConstantCount);
+		for (uint32_t i = 0; i < pushConstantCount; ++i)
+		{
+			key.push_back(static_cast<uint64_t>(pushConstantDescs[i].stage));
+			key.push_back(pushConstantDescs[i].size);
+		}
+	}
+
+	PipelineStateCache::Key PipelineStateCache::getKey(const GraphicsPipelineCreateInfo& pipelineCI) const
+	{
+		auto isDynamic = [&](DynamicState state) { return (pipelineCI.dynamicStates & state) != 0; };
+
+		Key key;
+		key.reserve(128);
+		key.push_back(static_cast<uint64_t>(pipelineCI.primType));
+		key.push_back(isDynamic(DynamicState::PrimitiveRestartEnable) ? 0 : pipelineCI.primitiveRestartEnable);
+
+		key.push_back(pipelineCI.vertexInputAttributeCount);
+		for (uint32_t i = 0; i < pipelineCI.vertexInputAttributeCount; ++i)
+		{
+			const VertexInputAttribute& attribute = pipelineCI.vertexInputAttributes[i];
+			key.push_back(attribute.bindingBufferSlot);
+			key.push_back(attribute.location);
+			key.push_back(static_cast<uint64_t>(attribute.format));
+			key.push_back(attribute.isInstanced);
+			key.push_back(attribute.offsetInElement);
+			key.push_back(attribute.elementStride);
+		}
+
+		appendLayouts(key, m_RenderDevice->getBindlessResourceSetLayout(), pipelineCI.resourceSetLayouts, pipelineCI.resourceSetLayoutCount,
+			pipelineCI.pushConstantDescs, pipelineCI.pushConstantCount);
+
+		key.push_back(getShaderHash(pipelineCI.vertexShader));
+		key.push_back(getShaderHash(pipelineCI.fragmentShader));
+		key.push_back(getShaderHash(pipelineCI.tessControlShader));
+		key.push_back(getShaderHash(pipelineCI.tessEvaluationShader));
+		key.push_back(getShaderHash(pipelineCI.geometryShader));
+
+		key.push_back(pipelineCI.blendState.alphaToCoverageEnable);
+		for (uint32_t i = 0; i < pipelineCI.renderTargetFormatCount; ++i)
+		{
+			const BlendState::RenderTargetBlendState& blend = pipelineCI.blendState.renderTargetBlendStates[i];
+			key.push_back(blend.blendEnable);
+			if (blend.blendEnable)
+			{
+				key.push_back(static_cast<uint64_t>(blend.srcColorBlend));
+				key.push_back(static_cast<uint64_t>(blend.destColorBlend));
+				key.push_back(static_cast<uint64_t>(blend.colorBlendOp));
+				key.push_back(static_cast<uint64_t>(blend.srcAlphaBlend));
+				key.push_back(static_cast<uint64_t>(blend.destAlphaBlend));
+				key.push_back(static_cast<uint64_t>(blend.alphaBlendOp));
+			}
+			key.push_back(static_cast<uint64_t>(blend.colorWriteMask));
+		}
+
+		const RasterState& raster = pipelineCI.rasterState;
+		key.push_back(isDynamic(DynamicState::PolygonMode) ? 0 : static_cast<uint64_t>(raster.fillMode));
+		key.push_back(isDynamic(DynamicState::CullMode) ? 0 : static_cast<uint64_t>(raster.cullMode));
+		key.push_back(isDynamic(DynamicState::DepthClampEnable) ? 0 : raster.depthClampEnable);
+		key.push_back(isDynamic(DynamicState::DepthBiasEnable) ? 0 : raster.depthBiasEnable);
+		key.push_back(isDynamic(DynamicState::FrontFace) ? 0 : raster.frontCounterClockwise);
+		key.push_back(floatBits(raster.lineWidth));
+
+		const DepthStencilState& depthStencil = pipelineCI.depthStencilState;
+		bool depthTest = isDynamic(DynamicState::DepthTestEnable) || depthStencil.depthTestEnable;
+		key.push_back(isDynamic(DynamicState::DepthTestEnable) ? 0 : depthStencil.depthTestEnable);
+		key.push_back(isDynamic(DynamicState::DepthWriteEnable) ? 0 : depthStencil.depthWriteEnable);
+		key.push_back(isDynamic(DynamicState::DepthCompareOp) || !depthTest ? 0 : static_cast<uint64_t>(depthStencil.depthCompareOp));
+		key.push_back(isDynamic(DynamicState::StencilTestEnable) ? 0 : depthStencil.stencilTestEnable);
+		if (isDynamic(DynamicState::StencilTestEnable) || depthStencil.stencilTestEnable)
+		{
+			key.push_back(depthStencil.stencilReadMask);
+			key.push_back(depthStencil.stencilWriteMask);
+			appendStencilOpState(key, depthStencil.frontFaceStencil, isDynamic(DynamicState::StencilOp));
+			appendStencilOpState(key, depthStencil.backFaceStencil, isDynamic(DynamicState::StencilOp));
+		}
+
+		key.push_back(pipelineCI.renderTargetFormatCount);
+		for (uint32_t i = 0; i < pipelineCI.renderTargetFormatCount; ++i)
+		{
+			key.push_back(static_cast<uint64_t>(pipelineCI.renderTargetFormats[i]));
+		}
+		key.push_back(static_cast<uint64_t>(pipelineCI.depthStencilFormat));
+		key.push_back(pipelineCI.sampleCount);
+		key.push_back(pipelineCI.primType == PrimitiveType::PatchList ? pipelineCI.patchControlPoints : 0);
+		key.push_back(pipelineCI.viewportCount);
+		key.push_back(static_cast<uint64_t>(pipelineCI.dynamicStates));
+		key.push_back(pipelineCI.viewMask);
+		return key;
+	}
+
+	PipelineStateCache::Key PipelineStateCache::getKey(const ComputePipelineCreateInfo& pipelineCI) const
+	{
+		Key key;
+		key.push_back(getShaderHash(pipelineCI.computeShader));
+		appendLayouts(key, m_RenderDevice->getBindlessResourceSetLayout(), pipelineCI.resourceSetLayouts, pipelineCI.resourceSetLayoutCount,
+			pipelineCI.pushConstantDescs, pipelineCI.pushConstantCount);
+		return key;
+	}
+
+	size_t PipelineStateCache::KeyHash::operator()(const Key& key) const
+	{
+		return static_cast<size_t>(hashBytes(key.data(), key.size() * sizeof(uint64_t)));
+	}
+
+	uint64_t PipelineStateCache::hashPipeline(const GraphicsPipelineCreateInfo& pipelineCI) const
+	{
+		Key key = getKey(pipelineCI);
+		return hashBytes(key.data(), key.size() * sizeof(uint64_t));
+	}
+
+	uint64_t PipelineStateCache::hashPipeline(const ComputePipelineCreateInfo& pipelineCI) const
+	{
+		Key key = getKey(pipelineCI);
+		return hashBytes(key.data(), key.size() * sizeof(uint64_t));
+	}
+
+	static IGraphicsPipeline* createPipeline(IRenderDevice* renderDevice, const GraphicsPipelineCreateInfo& pipelineCI)
+	{
+		return renderDevice->createGraphicsPipeline(pipelineCI);
+	}
+
+	static IComputePipeline* createPipeline(IRenderDevice* renderDevice, const ComputePipelineCreateInfo& pipelineCI)
+	{
+		return renderDevice->createComputePipeline(pipelineCI);
+	}
+
+	template<typename PipelineType, typename CreateInfoType>
+	std::shared_ptr<PipelineType> PipelineStateCache::getPipeline(std::unordered_map<Key, std::weak_ptr<PipelineType>, KeyHash>& pipelines,
+		const CreateInfoType& pipelineCI)
+	{
+		Key key = getKey(pipelineCI);
+		{
+			std::lock_guard lock(m_Mutex);
+			++m_RequestCount;
+			auto it = pipelines.find(key);
+			if (it != pipelines.end())
+			{
+				if (std::shared_ptr<PipelineType> pipeline = it->second.lock())
+				{
+					++m_HitCount;
+					return pipeline;
+				}
+			}
+		}
+
+		// created without the lock, so other requests don't wait for the compilation
+		std::shared_ptr<PipelineType> pipeline(createPipeline(m_RenderDevice, pipelineCI));
+		if (!pipeline)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard lock(m_Mutex);
+		auto [it, inserted] = pipelines.try_emplace(std::move(key));
+		if (!inserted)
+		{
+			// another thread created the same pipeline meanwhile, ours is released again
+			if (std::shared_ptr<PipelineType> existing = it->second.lock())
+			{
+				return existing;
+			}
+		}
+		it->second = pipeline;
+
+		// drop the entries of released pipelines whenever the map doubled
+		if (pipelines.size() >= 64 && (pipelines.size() & (pipelines.size() - 1)) == 0)
+		{
+			for (auto entry = pipelines.begin(); entry != pipelines.end();)
+			{
+				entry = entry->second.expired() ? pipelines.erase(entry) : std::next(entry);
+			}
+		}
+		return pipeline;
+	}
+
+	std::shared_ptr<IGraphicsPipeline> PipelineStateCache::getGraphicsPipeline(const GraphicsPipelineCreateInfo& pipelineCI)
+	{
+		return getPipeline(m_GraphicsPipelines, pipelineCI);
+	}
+
+	std::shared_ptr<IComputePipeline> PipelineStateCache::getComputePipeline(const ComputePipelineCreateInfo& pipelineCI)
+	{
+		return getPipeline(m_ComputePipelines, pipelineCI);
+	}
+
+	PipelineStateCacheStatistics PipelineStateCache::getStatistics() const
+	{
+		std::lock_guard lock(m_Mutex);
+		PipelineStateCacheStatistics statistics{};
+		statistics.requestCount = m_RequestCount;
+		statistics.hitCount = m_HitCount;
+		for (const auto& [key, pipeline] : m_GraphicsPipelines)
+		{
+			statistics.pipelineCount += pipeline.expired() ? 0 : 1;
+		}
+		for (const auto& [key, pipeline] : m_ComputePipelines)
+		{
+			statistics.pipelineCount += pipeline.expired() ? 0 : 1;
+		}
+		return statistics;
+	}
+
+	void PipelineStateCache::resetStatistics()
+	{
+		std::lock_guard lock(m_Mutex);
+		m_RequestCount = 0;
+		m_HitCount = 0;
+	}
+}
@@ -0,0 +1,687 @@
+#include "rhi/shader_reflection.h"
+#include "rhi/common/Error.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace rhi
+{
+	// The subset of the SPIR-V specification the reflection needs.
+	constexpr uint32_t g_SpvMagicNumber = 0x07230203;
+	constexpr uint32_t g_SpvHeaderWordCount = 5;
+
+	enum SpvOp : uint32_t
+	{
+		SpvOpEntryPoint = 15,
+		SpvOpExecutionMode = 16,
+		SpvOpTypeBool = 20,
+		SpvOpTypeInt = 21,
+		SpvOpTypeFloat = 22,
+		SpvOpTypeVector = 23,
+		SpvOpTypeMatrix = 24,
+		SpvOpTypeImage = 25,
+		SpvOpTypeSampler = 26,
+		SpvOpTypeSampledImage = 27,
+		SpvOpTypeArray = 28,
+		SpvOpTypeRuntimeArray = 29,
+		SpvOpTypeStruct = 30,
+		SpvOpTypePointer = 32,
+		SpvOpConstant = 43,
+		SpvOpSpecConstant = 50,
+		SpvOpFunction = 54,
+		SpvOpFunctionEnd = 56,
+		SpvOpFunctionCall = 57,
+		SpvOpVariable = 59,
+		SpvOpDecorate = 71,
+		SpvOpMemberDecorate = 72
+	};
+
+	enum SpvDecoration : uint32_t
+	{
+		SpvDecorationBlock = 2,
+		SpvDecorationBufferBlock = 3,
+		SpvDecorationArrayStride = 6,
+		SpvDecorationMatrixStride = 7,
+		SpvDecorationBinding = 33,
+		SpvDecorationDescriptorSet = 34,
+		SpvDecorationOffset = 35
+	};
+
+	enum SpvStorageClass : uint32_t
+	{
+		SpvStorageClassUniformConstant = 0,
+		SpvStorageClassUniform = 2,
+		SpvStorageClassPushConstant = 9,
+		SpvStorageClassStorageBuffer = 12
+	};
+
+	constexpr uint32_t g_SpvExecutionModeLocalSize = 17;
+	constexpr uint32_t g_SpvDimBuffer = 5;
+
+	struct SpvMember
+	{
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+	};
+
+	struct SpvId
+	{
+		// the instruction that defines the id, nullptr if it isn't a type, constant or variable
+		const uint32_t* instruction = nullptr;
+		uint32_t wordCount = 0;
+		uint32_t set = UINT32_MAX;
+		uint32_t binding = UINT32_MAX;
+		uint32_t arrayStride = 0;
+		bool block = false;
+		bool bufferBlock = false;
+		// a variable declared outside of the functions
+		bool globalVariable = false;
+		std::vector<SpvMember> members;
+	};
+
+	struct SpvFunction
+	{
+		std::vector<uint32_t> callees;
+		// global variables the function body names
+		std::vector<uint32_t> variables;
+	};
+
+	class SpvModule
+	{
+	public:
+		explicit SpvModule(uint32_t idBound)
+			:m_Ids(idBound) {}
+
+		bool parse(const uint32_t* code, size_t wordCount, const char* entry, ShaderReflection& reflection);
+		bool reflectVariables(ShaderReflection& reflection) const;
+	private:
+		SpvId* getId(uint32_t id) { return id < m_Ids.size() ? &m_Ids[id] : nullptr; }
+		const SpvId* getType(uint32_t id, uint32_t minWordCount) const;
+		uint32_t getOpcode(uint32_t id) const;
+		uint32_t getConstant(uint32_t id) const;
+		uint32_t getTypeSize(uint32_t typeId, uint32_t matrixStride, uint32_t depth) const;
+		ShaderResourceType getResourceType(uint32_t typeId, uint32_t storageClass) const;
+		std::vector<bool> getEntryPointVariables() const;
+
+		std::vector<SpvId> m_Ids;
+		std::vector<uint32_t> m_Variables;
+		std::unordered_map<uint32_t, SpvFunction> m_Functions;
+		uint32_t m_EntryPointId = UINT32_MAX;
+	};
+
+	const SpvId* SpvModule::getType(uint32_t id, uint32_t minWordCount) const
+	{
+		if (id >= m_Ids.size() || m_Ids[id].instruction == nullptr || m_Ids[id].wordCount < minWordCount)
+		{
+			return nullptr;
+		}
+		return &m_Ids[id];
+	}
+
+	uint32_t SpvModule::getOpcode(uint32_t id) const
+	{
+		const SpvId* type = getType(id, 1);
+		return type ? type->instruction[0] & 0xFFFF : 0;
+	}
+
+	uint32_t SpvModule::getConstant(uint32_t id) const
+	{
+		// spec constants are reflected with their default value
+		const SpvId* constant = getType(id, 4);
+		if (!constant || (getOpcode(id) != SpvOpConstant && getOpcode(id) != SpvOpSpecConstant))
+		{
+			return 0;
+		}
+		return constant->instruction[3];
+	}
+
+	uint32_t SpvModule::getTypeSize(uint32_t typeId, uint32_t matrixStride, uint32_t depth) const
+	{
+		// guards against malformed modules with cyclic types
+		if (depth > 32)
+		{
+			return 0;
+		}
+		const SpvId* type = getType(typeId, 2);
+		if (!type)
+		{
+			return 0;
+		}
+		const uint32_t* inst = type->instruction;
+		switch (getOpcode(typeId))
+		{
+		case SpvOpTypeBool:
+			return 4;
+		case SpvOpTypeInt:
+		case SpvOpTypeFloat:
+			return type->wordCount >= 3 ? inst[2] / 8 : 0;
+		case SpvOpTypeVector:
+			return type->wordCount >= 4 ? inst[3] * getTypeSize(inst[2], 0, depth + 1) : 0;
+		case SpvOpTypeMatrix:
+			if (type->wordCount < 4)
+			{
+				return 0;
+			}
+			return inst[3] * (matrixStride != 0 ? matrixStride : getTypeSize(inst[2], 0, depth + 1));
+		case SpvOpTypeArray:
+			if (type->wordCount < 4)
+			{
+				return 0;
+			}
+			return getConstant(inst[3]) * (type->arrayStride != 0 ? type->arrayStride : getTypeSize(inst[2], matrixStride, depth + 1));
+		case SpvOpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t i = 2; i < type->wordCount; ++i)
+			{
+				uint32_t memberIndex = i - 2;
+				SpvMember member = memberIndex < type->members.size() ? type->members[memberIndex] : SpvMember{};
+				size = (std::max)(size, member.offset + getTypeSize(inst[i], member.matrixStride, depth + 1));
+			}
+			return size;
+		}
+		default:
+			// runtime arrays have no static size
+			return 0;
+		}
+	}
+
+	ShaderResourceType SpvModule::getResourceType(uint32_t typeId, uint32_t storageClass) const
+	{
+		const SpvId* type = getType(typeId, 2);
+		if (!type)
+		{
+			return ShaderResourceType::Unknown;
+		}
+		switch (getOpcode(typeId))
+		{
+		case SpvOpTypeSampler:
+			return ShaderResourceType::Sampler;
+		case SpvOpTypeSampledImage:
+			return ShaderResourceType::TextureWithSampler;
+		case SpvOpTypeImage:
+		{
+			if (type->wordCount < 9)
+			{
+				return ShaderResourceType::Unknown;
+			}
+			// Sampled is 1 for images used with a sampler and 2 for storage images
+			bool storage = type->instruction[7] == 2;
+			if (type->instruction[3] == g_SpvDimBuffer)
+			{
+				return storage ? ShaderResourceType::StorageTexelBuffer : ShaderResourceType::UniformTexelBuffer;
+			}
+			return storage ? ShaderResourceType::StorageTexture : ShaderResourceType::SampledTexture;
+		}
+		case SpvOpTypeStruct:
+			if (storageClass == SpvStorageClassStorageBuffer || type->bufferBlock)
+			{
+				return ShaderResourceType::StorageBuffer;
+			}
+			if (storageClass == SpvStorageClassUniform && type->block)
+			{
+				return ShaderResourceType::UniformBuffer;
+			}
+			return ShaderResourceType::Unknown;
+		default:
+			return ShaderResourceType::Unknown;
+		}
+	}
+
+	std::vector<bool> SpvModule::getEntryPointVariables() const
+	{
+		std::vector<bool> used(m_Ids.size(), false);
+		std::vector<bool> visited(m_Ids.size(), false);
+		std::vector<uint32_t> functions{ m_EntryPointId };
+		visited[m_EntryPointId] = true;
+		while (!functions.empty())
+		{
+			uint32_t functionId = functions.back();
+			functions.pop_back();
+			auto it = m_Functions.find(functionId);
+			if (it == m_Functions.end())
+			{
+				continue;
+			}
+			for (uint32_t variableId : it->second.variables)
+			{
+				used[variableId] = true;
+			}
+			for (uint32_t callee : it->second.callees)
+			{
+				if (callee < visited.size() && !visited[callee])
+				{
+					visited[callee] = true;
+					functions.push_back(callee);
+				}
+			}
+		}
+		return used;
+	}
+
+	bool SpvModule::parse(const uint32_t* code, size_t wordCount, const char* entry, ShaderReflection& reflection)
+	{
+		uint32_t entryPointId = UINT32_MAX;
+		SpvFunction* function = nullptr;
+		size_t offset = g_SpvHeaderWordCount;
+		while (offset < wordCount)
+		{
+			const uint32_t* inst = code + offset;
+			uint32_t instWordCount = inst[0] >> 16;
+			uint32_t opcode = inst[0] & 0xFFFF;
+			if (instWordCount == 0 || offset + instWordCount > wordCount)
+			{
+				LOG_ERROR("Invalid SPIR-V instruction at word ", offset);
+				return false;
+			}
+			offset += instWordCount;
+
+			if (function)
+			{
+				// Every operand that names a global variable counts as a use. A literal that happens to equal
+				// the id keeps a resource the entry point doesn't access, which is harmless.
+				for (uint32_t i = 1; i < instWordCount; ++i)
+				{
+					if (inst[i] < m_Ids.size() && m_Ids[inst[i]].globalVariable)
+					{
+						function->variables.push_back(inst[i]);
+					}
+				}
+				if (opcode == SpvOpFunctionCall && instWordCount >= 4)
+				{
+					function->callees.push_back(inst[3]);
+				}
+			}
+
+			switch (opcode)
+			{
+			case SpvOpEntryPoint:
+			{
+				if (instWordCount < 4)
+				{
+					break;
+				}
+				const char* name = reinterpret_cast<const char*>(inst + 3);
+				size_t maxLength = (instWordCount - 3) * sizeof(uint32_t);
+				if (entryPointId == UINT32_MAX && strncmp(name, entry, maxLength) == 0)
+				{
+					entryPointId = inst[2];
+				}
+				break;
+			}
+			case SpvOpExecutionMode:
+				if (instWordCount >= 6 && inst[1] == entryPointId && inst[2] == g_SpvExecutionModeLocalSize)
+				{
+					reflection.workgroupSize[0] = inst[3];
+					reflection.workgroupSize[1] = inst[4];
+					reflection.workgroupSize[2] = inst[5];
+				}
+				break;
+			case SpvOpDecorate:
+			{
+				SpvId* id = instWordCount >= 3 ? getId(inst[1]) : nullptr;
+				if (!id)
+				{
+					break;
+				}
+				switch (inst[2])
+				{
+				case SpvDecorationBlock:
+					id->block = true;
+					break;
+				case SpvDecorationBufferBlock:
+					id->bufferBlock = true;
+					break;
+				case SpvDecorationArrayStride:
+					id->arrayStride = instWordCount >= 4 ? inst[3] : 0;
+					break;
+				case SpvDecorationBinding:
+					id->binding = instWordCount >= 4 ? inst[3] : UINT32_MAX;
+					break;
+				case SpvDecorationDescriptorSet:
+					id->set = instWordCount >= 4 ? inst[3] : UINT32_MAX;
+					break;
+				default:
+					break;
+				}
+				break;
+			}
+			case SpvOpMemberDecorate:
+			{
+				SpvId* id = instWordCount >= 5 ? getId(inst[1]) : nullptr;
+				if (!id || (inst[3] != SpvDecorationOffset && inst[3] != SpvDecorationMatrixStride))
+				{
+					break;
+				}
+				if (id->members.size() <= inst[2])
+				{
+					id->members.resize(size_t(inst[2]) + 1);
+				}
+				if (inst[3] == SpvDecorationOffset)
+				{
+					id->members[inst[2]].offset = inst[4];
+				}
+				else
+				{
+					id->members[inst[2]].matrixStride = inst[4];
+				}
+				break;
+			}
+			case SpvOpTypeBool:
+			case SpvOpTypeInt:
+			case SpvOpTypeFloat:
+			case SpvOpTypeVector:
+			case SpvOpTypeMatrix:
+			case SpvOpTypeImage:
+			case SpvOpTypeSampler:
+			case SpvOpTypeSampledImage:
+			case SpvOpTypeArray:
+			case SpvOpTypeRuntimeArray:
+			case SpvOpTypeStruct:
+			case SpvOpTypePointer:
+			{
+				SpvId* id = instWordCount >= 2 ? getId(inst[1]) : nullptr;
+				if (id)
+				{
+					id->instruction = inst;
+					id->wordCount = instWordCount;
+				}
+				break;
+			}
+			case SpvOpFunction:
+				function = instWordCount >= 3 ? &m_Functions[inst[2]] : nullptr;
+				break;
+			case SpvOpFunctionEnd:
+				function = nullptr;
+				break;
+			case SpvOpConstant:
+			case SpvOpSpecConstant:
+			case SpvOpVariable:
+			{
+				// the result type comes before the result id
+				SpvId* id = instWordCount >= 4 ? getId(inst[2]) : nullptr;
+				if (id)
+				{
+					id->instruction = inst;
+					id->wordCount = instWordCount;
+					if (opcode == SpvOpVariable && !function)
+					{
+						id->globalVariable = true;
+						m_Variables.push_back(inst[2]);
+					}
+				}
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		if (entryPointId == UINT32_MAX || entryPointId >= m_Ids.size())
+		{
+			LOG_ERROR("The SPIR-V module has no entry point named ", entry);
+			return false;
+		}
+		m_EntryPointId = entryPointId;
+		return true;
+	}
+
+	bool SpvModule::reflectVariables(ShaderReflection& reflection) const
+	{
+		// only the resources the entry point and the functions it calls access, other entry points of the module
+		// and dead code may declare bindings the pipeline doesn't have
+		std::vector<bool> used = getEntryPointVariables();
+		for (uint32_t variableId : m_Variables)
+		{
+			if (!used[variableId])
+			{
+				continue;
+			}
+			const SpvId& variable = m_Ids[variableId];
+			uint32_t storageClass = variable.instruction[3];
+			const SpvId* pointer = getType(variable.instruction[1], 4);
+			if (!pointer || getOpcode(variable.instruction[1]) != SpvOpTypePointer)
+			{
+				continue;
+			}
+			uint32_t typeId = pointer->instruction[3];
+
+			if (storageClass == SpvStorageClassPushConstant)
+			{
+				const SpvId* block = getType(typeId, 2);
+				if (!block || getOpcode(typeId) != SpvOpTypeStruct)
+				{
+					continue;
+				}
+				uint32_t begin = UINT32_MAX;
+				for (uint32_t i = 2; i < block->wordCount; ++i)
+				{
+					uint32_t memberIndex = i - 2;
+					begin = (std::min)(begin, memberIndex < block->members.size() ? block->members[memberIndex].offset : 0);
+				}
+				uint32_t end = getTypeSize(typeId, 0, 0);
+				if (begin != UINT32_MAX && end > begin)
+				{
+					reflection.pushConstantOffset = begin;
+					reflection.pushConstantSize = end - begin;
+				}
+				continue;
+			}
+
+			if (storageClass != SpvStorageClassUniformConstant && storageClass != SpvStorageClassUniform &&
+				storageClass != SpvStorageClassStorageBuffer)
+			{
+				continue;
+			}
+			if (variable.binding == UINT32_MAX)
+			{
+				continue;
+			}
+
+			uint32_t arrayElementCount = 1;
+			for (uint32_t depth = 0; depth < 32; ++depth)
+			{
+				const SpvId* type = getType(typeId, 3);
+				uint32_t opcode = getOpcode(typeId);
+				if (type && opcode == SpvOpTypeArray && type->wordCount >= 4)
+				{
+					arrayElementCount *= getConstant(type->instruction[3]);
+				}
+				else if (type && opcode == SpvOpTypeRuntimeArray)
+				{
+					arrayElementCount = 0;
+				}
+				else
+				{
+					break;
+				}
+				typeId = type->instruction[2];
+			}
+
+			ShaderReflectionBinding binding{};
+			binding.set = variable.set == UINT32_MAX ? 0 : variable.set;
+			binding.layoutBinding.visibleStages = reflection.stage;
+			binding.layoutBinding.type = getResourceType(typeId, storageClass);
+			binding.layoutBinding.bindingSlot = variable.binding;
+			binding.layoutBinding.arrayElementCount = arrayElementCount;
+			if (binding.layoutBinding.type == ShaderResourceType::Unknown)
+			{
+				LOG_WARNING("Skipped the binding ", variable.binding, " of set ", binding.set, ", its type isn't supported");
+				continue;
+			}
+			reflection.bindings.push_back(binding);
+		}
+
+		std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+			[](const ShaderReflectionBinding& a, const ShaderReflectionBinding& b)
+			{
+				return a.set != b.set ? a.set < b.set : a.layoutBinding.bindingSlot < b.layoutBinding.bindingSlot;
+			});
+		return true;
+	}
+
+	bool reflectShader(const uint32_t* code, size_t codeSize, ShaderType stage, const char* entry, ShaderReflection& reflection)
+	{
+		assert(code != nullptr);
+		assert(entry != nullptr);
+
+		size_t wordCount = codeSize / sizeof(uint32_t);
+		if (codeSize % sizeof(uint32_t) != 0 || wordCount < g_SpvHeaderWordCount || code[0] != g_SpvMagicNumber)
+		{
+			LOG_ERROR("The shader code isn't a SPIR-V module");
+			return false;
+		}
+
+		reflection = ShaderReflection{};
+		reflection.stage = stage;
+
+		SpvModule module(code[3]);
+		return module.parse(code, wordCount, entry, reflection) && module.reflectVariables(reflection);
+	}
+
+	bool ReflectedLayoutCache::getResourceSetLayouts(IShader* const* shaders, uint32_t shaderCount,
+		IResourceSetLayout** resourceSetLayouts, uint32_t& setCount)
+	{
+		setCount = 0;
+		std::vector<ResourceSetLayoutBinding> setBindings[g_MaxBoundDescriptorSets];
+		for (uint32_t i = 0; i < shaderCount; ++i)
+		{
+			const ShaderReflection* reflection = shaders[i]->getReflection();
+			if (!reflection)
+			{
+				LOG_ERROR("The shader wasn't created with ShaderCreateInfo::reflect");
+				return false;
+			}
+			for (const ShaderReflectionBinding& binding : reflection->bindings)
+			{
+				if (binding.set >= g_MaxBoundDescriptorSets)
+				{
+					LOG_ERROR("Set ", binding.set, " exceeds g_MaxBoundDescriptorSets");
+					return false;
+				}
+				if (binding.layoutBinding.arrayElementCount == 0)
+				{
+					LOG_ERROR("The binding ", binding.layoutBinding.bindingSlot, " of set ", binding.set,
+						" is a runtime array, use the bindless heap for it");
+					return false;
+				}
+
+				std::vector<ResourceSetLayoutBinding>& bindings = setBindings[binding.set];
+				auto it = std::find_if(bindings.begin(), bindings.end(), [&](const ResourceSetLayoutBinding& layoutBinding)
+					{
+						return layoutBinding.bindingSlot == binding.layoutBinding.bindingSlot;
+					});
+				if (it == bindings.end())
+				{
+					bindings.push_back(binding.layoutBinding);
+					continue;
+				}
+				if (it->type != binding.layoutBinding.type || it->arrayElementCount != binding.layoutBinding.arrayElementCount)
+				{
+					LOG_ERROR("The shaders declare the binding ", binding.layoutBinding.bindingSlot, " of set ", binding.set,
+						" differently");
+					return false;
+				}
+				it->visibleStages = it->visibleStages | binding.layoutBinding.visibleStages;
+			}
+		}
+
+		for (uint32_t set = 0; set < g_MaxBoundDescriptorSets; ++set)
+		{
+			if (!setBindings[set].empty())
+			{
+				setCount = set + 1;
+			}
+		}
+
+		for (uint32_t set = 0; set < setCount; ++set)
+		{
+			std::vector<ResourceSetLayoutBinding>& bindings = setBindings[set];
+			if (bindings.empty())
+			{
+				LOG_ERROR("Set ", set, " is unused but a later set is, resource set layouts can't be empty");
+				setCount = 0;
+				return false;
+			}
+			std::sort(bindings.begin(), bindings.end(), [](const ResourceSetLayoutBinding& a, const ResourceSetLayoutBinding& b)
+				{
+					return a.bindingSlot < b.bindingSlot;
+				});
+
+			LayoutKey key;
+			key.reserve(bindings.size());
+			for (const ResourceSetLayoutBinding& binding : bindings)
+			{
+				key.emplace_back(binding.bindingSlot, binding.type, binding.arrayElementCount, binding.visibleStages);
+			}
+
+			auto it = m_Layouts.find(key);
+			if (it == m_Layouts.end())
+			{
+				std::unique_ptr<IResourceSetLayout> layout(
+					m_RenderDevice->createResourceSetLayout(bindings.data(), static_cast<uint32_t>(bindings.size())));
+				if (!layout)
+				{
+					setCount = 0;
+					return false;
+				}
+				it = m_Layouts.emplace(std::move(key), std::move(layout)).first;
+			}
+			resourceSetLayouts[set] = it->second.get();
+		}
+		return true;
+	}
+
+	bool ReflectedLayoutCache::getPushConstantDescs(IShader* const* shaders, uint32_t shaderCount,
+		PushConstantDesc* pushConstantDescs, uint32_t& pushConstantCount)
+	{
+		pushConstantCount = 0;
+		// (offset, size, stages) of each distinct block
+		std::vector<std::tuple<uint32_t, uint32_t, ShaderType>> blocks;
+		for (uint32_t i = 0; i < shaderCount; ++i)
+		{
+			const ShaderReflection* reflection = shaders[i]->getReflection();
+			if (!reflection)
+			{
+				LOG_ERROR("The shader wasn't created with ShaderCreateInfo::reflect");
+				return false;
+			}
+			if (reflection->pushConstantSize == 0)
+			{
+				continue;
+			}
+			auto it = std::find_if(blocks.begin(), blocks.end(), [&](const std::tuple<uint32_t, uint32_t, ShaderType>& block)
+				{
+					return std::get<0>(block) == reflection->pushConstantOffset && std::get<1>(block) == reflection->pushConstantSize;
+				});
+			if (it == blocks.end())
+			{
+				blocks.emplace_back(reflection->pushConstantOffset, reflection->pushConstantSize, reflection->stage);
+			}
+			else
+			{
+				std::get<2>(*it) = std::get<2>(*it) | reflection->stage;
+			}
+		}
+		std::sort(blocks.begin(), blocks.end());
+
+		// pipeline creation places the ranges one after another from offset 0
+		uint32_t offset = 0;
+		for (const auto& block : blocks)
+		{
+			if (std::get<0>(block) != offset)
+			{
+				LOG_ERROR("A push constant block starts at byte ", std::get<0>(block), " but its range would start at byte ", offset,
+					", the blocks of a pipeline must be identical or follow each other from offset 0");
+				pushConstantCount = 0;
+				return false;
+			}
+			pushConstantDescs[pushConstantCount].stage = std::get<2>(block);
+			pushConstantDescs[pushConstantCount].size = std::get<1>(block);
+			++pushConstantCount;
+			offset += std::get<1>(block);
+		}
+		return true;
+	}
+}
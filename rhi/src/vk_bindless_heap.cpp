@@ -0,0 +1,222 @@
+#include "vk_bindless_heap.h"
+
+#include "vk_errors.h"
+#include "vk_resource.h"
+#include "rhi/common/Error.h"
+
+#include <array>
+
+namespace rhi
+{
+	uint32_t BindlessIndexAllocator::allocate()
+	{
+		if (!m_FreeIndices.empty())
+		{
+			uint32_t index = m_FreeIndices.back();
+			m_FreeIndices.pop_back();
+			return index;
+		}
+		if (m_NextIndex < m_Capacity)
+		{
+			return m_NextIndex++;
+		}
+		return g_InvalidBindlessIndex;
+	}
+
+	void BindlessIndexAllocator::release(uint32_t index, uint64_t retireID)
+	{
+		assert(index < m_NextIndex);
+		assert(m_RetiredIndices.empty() || m_RetiredIndices.back().retireID <= retireID);
+		m_RetiredIndices.push_back(RetiredIndex{ retireID, index });
+	}
+
+	void BindlessIndexAllocator::recycle(uint64_t lastFinishedID)
+	{
+		while (!m_RetiredIndices.empty() && m_RetiredIndices.front().retireID <= lastFinishedID)
+		{
+			m_FreeIndices.push_back(m_RetiredIndices.front().index);
+			m_RetiredIndices.pop_front();
+		}
+	}
+
+	BindlessHeapVk::~BindlessHeapVk()
+	{
+		delete m_ResourceSet;
+		delete m_ResourceSetLayout;
+	}
+
+	bool BindlessHeapVk::init(uint32_t textureCount, uint32_t bufferCount, uint32_t samplerCount)
+	{
+		m_TextureIndices.init(textureCount);
+		m_BufferIndices.init(bufferCount);
+		m_SamplerIndices.init(samplerCount);
+
+		std::array<ResourceSetLayoutBinding, 3> layoutBindings =
+		{
+			ResourceSetLayoutBinding::SampledTexture(ShaderType::All, g_BindlessTextureBinding, textureCount),
+			ResourceSetLayoutBinding::StorageBuffer(ShaderType::All, g_BindlessBufferBinding, bufferCount),
+			ResourceSetLayoutBinding::Sampler(ShaderType::All, g_BindlessSamplerBinding, samplerCount)
+		};
+
+		std::array<VkDescriptorSetLayoutBinding, 3> vkBindings{};
+		for (size_t i = 0; i < layoutBindings.size(); ++i)
+		{
+			vkBindings[i].binding = layoutBindings[i].bindingSlot;
+			vkBindings[i].descriptorType = shaderResourceTypeToVkDescriptorType(layoutBindings[i].type);
+			vkBindings[i].descriptorCount = layoutBindings[i].arrayElementCount;
+			vkBindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+		}
+
+		// Slots that are never registered stay unwritten, and slots are written while the set is in use.
+		constexpr VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		// Only the binding with the highest number may have a variable count.
+		std::array<VkDescriptorBindingFlags, 3> vkBindingFlags = { bindingFlags, bindingFlags,
+			bindingFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+		bindingFlagsCI.bindingCount = static_cast<uint32_t>(vkBindingFlags.size());
+		bindingFlagsCI.pBindingFlags = vkBindingFlags.data();
+
+		m_ResourceSetLayout = new ResourceSetLayoutVk(m_Context);
+		m_ResourceSetLayout->resourceSetLayoutBindings.assign(layoutBindings.begin(), layoutBindings.end());
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+		descriptorSetLayoutCI.pNext = &bindingFlagsCI;
+		descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(vkBindings.size());
+		descriptorSetLayoutCI.pBindings = vkBindings.data();
+		VkResult err = vkCreateDescriptorSetLayout(m_Context.device, &descriptorSetLayoutCI, nullptr, &m_ResourceSetLayout->descriptorSetLayout);
+		CHECK_VK_RESULT(err, "Could not create the bindless descriptor set layout");
+		if (err != VK_SUCCESS)
+		{
+			delete m_ResourceSetLayout;
+			m_ResourceSetLayout = nullptr;
+			return false;
+		}
+
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
+		for (size_t i = 0; i < vkBindings.size(); ++i)
+		{
+			poolSizes[i].type = vkBindings[i].descriptorType;
+			poolSizes[i].descriptorCount = vkBindings[i].descriptorCount;
+		}
+
+		m_ResourceSet = new ResourceSetVk(m_Context);
+		m_ResourceSet->resourceSetLayout = m_ResourceSetLayout;
+
+		VkDescriptorPoolCreateInfo poolCI{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolCI.maxSets = 1;
+		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCI.pPoolSizes = poolSizes.data();
+		err = vkCreateDescriptorPool(m_Context.device, &poolCI, nullptr, &m_ResourceSet->descriptorPool);
+		CHECK_VK_RESULT(err, "Could not create the bindless descriptor pool");
+		if (err != VK_SUCCESS)
+		{
+			delete m_ResourceSet;
+			m_ResourceSet = nullptr;
+			return false;
+		}
+
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountAI{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO };
+		variableCountAI.descriptorSetCount = 1;
+		variableCountAI.pDescriptorCounts = &samplerCount;
+
+		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.pNext = &variableCountAI;
+		allocInfo.descriptorPool = m_ResourceSet->descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_ResourceSetLayout->descriptorSetLayout;
+		err = vkAllocateDescriptorSets(m_Context.device, &allocInfo, &m_ResourceSet->descriptorSet);
+		CHECK_VK_RESULT(err, "Could not allocate the bindless descriptor set");
+		return err == VK_SUCCESS;
+	}
+
+	void BindlessHeapVk::writeDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type,
+		const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		write.dstSet = m_ResourceSet->descriptorSet;
+		write.dstBinding = binding;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		write.pImageInfo = imageInfo;
+		write.pBufferInfo = bufferInfo;
+		vkUpdateDescriptorSets(m_Context.device, 1, &write, 0, nullptr);
+	}
+
+	uint32_t BindlessHeapVk::registerTexture(ITextureView* textureView)
+	{
+		assert(textureView);
+		uint32_t index = m_TextureIndices.allocate();
+		if (index == g_InvalidBindlessIndex)
+		{
+			LOG_ERROR("The bindless heap is out of texture slots (", m_TextureIndices.getCapacity(), ")");
+			return index;
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = checked_cast<TextureViewVk*>(textureView)->imageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		writeDescriptor(g_BindlessTextureBinding, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &imageInfo, nullptr);
+		return index;
+	}
+
+	uint32_t BindlessHeapVk::registerBuffer(IBuffer* buffer)
+	{
+		assert(buffer);
+		uint32_t index = m_BufferIndices.allocate();
+		if (index == g_InvalidBindlessIndex)
+		{
+			LOG_ERROR("The bindless heap is out of buffer slots (", m_BufferIndices.getCapacity(), ")");
+			return index;
+		}
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = checked_cast<BufferVk*>(buffer)->buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+		writeDescriptor(g_BindlessBufferBinding, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &bufferInfo);
+		return index;
+	}
+
+	uint32_t BindlessHeapVk::registerSampler(ISampler* sampler)
+	{
+		assert(sampler);
+		uint32_t index = m_SamplerIndices.allocate();
+		if (index == g_InvalidBindlessIndex)
+		{
+			LOG_ERROR("The bindless heap is out of sampler slots (", m_SamplerIndices.getCapacity(), ")");
+			return index;
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = checked_cast<SamplerVk*>(sampler)->sampler;
+		writeDescriptor(g_BindlessSamplerBinding, index, VK_DESCRIPTOR_TYPE_SAMPLER, &imageInfo, nullptr);
+		return index;
+	}
+
+	void BindlessHeapVk::unregisterTexture(uint32_t index, uint64_t retireID)
+	{
+		m_TextureIndices.release(index, retireID);
+	}
+
+	void BindlessHeapVk::unregisterBuffer(uint32_t index, uint64_t retireID)
+	{
+		m_BufferIndices.release(index, retireID);
+	}
+
+	void BindlessHeapVk::unregisterSampler(uint32_t index, uint64_t retireID)
+	{
+		m_SamplerIndices.release(index, retireID);
+	}
+
+	void BindlessHeapVk::recycle(uint64_t lastFinishedID)
+	{
+		m_TextureIndices.recycle(lastFinishedID);
+		m_BufferIndices.recycle(lastFinishedID);
+		m_SamplerIndices.recycle(lastFinishedID);
+	}
+}
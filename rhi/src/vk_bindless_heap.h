@@ -0,0 +1,71 @@
+#pragma once
+
+#include "rhi/rhi.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+
+namespace rhi
+{
+	struct ContextVk;
+	class ResourceSetLayoutVk;
+	class ResourceSetVk;
+
+	// Hands out the slots of one array of the bindless heap.
+	// Released slots are retired with the last submitted execute ID and only reused once it has finished.
+	class BindlessIndexAllocator
+	{
+	public:
+		void init(uint32_t capacity) { m_Capacity = capacity; }
+		// g_InvalidBindlessIndex if the array is full.
+		uint32_t allocate();
+		void release(uint32_t index, uint64_t retireID);
+		void recycle(uint64_t lastFinishedID);
+		uint32_t getCapacity() const { return m_Capacity; }
+	private:
+		struct RetiredIndex
+		{
+			uint64_t retireID = 0;
+			uint32_t index = 0;
+		};
+		uint32_t m_Capacity = 0;
+		uint32_t m_NextIndex = 0;
+		std::vector<uint32_t> m_FreeIndices;
+		// Ordered by retireID.
+		std::deque<RetiredIndex> m_RetiredIndices;
+	};
+
+	// Device-global descriptor set with large arrays of sampled textures, storage buffers and samplers.
+	// Built on descriptor indexing: the bindings are partially bound and update after bind, so slots are written
+	// while the set is bound by in flight command buffers, and the sampler array has a variable descriptor count.
+	class BindlessHeapVk
+	{
+	public:
+		explicit BindlessHeapVk(const ContextVk& context)
+			:m_Context(context) {}
+		~BindlessHeapVk();
+		bool init(uint32_t textureCount, uint32_t bufferCount, uint32_t samplerCount);
+
+		uint32_t registerTexture(ITextureView* textureView);
+		uint32_t registerBuffer(IBuffer* buffer);
+		uint32_t registerSampler(ISampler* sampler);
+		void unregisterTexture(uint32_t index, uint64_t retireID);
+		void unregisterBuffer(uint32_t index, uint64_t retireID);
+		void unregisterSampler(uint32_t index, uint64_t retireID);
+		void recycle(uint64_t lastFinishedID);
+
+		ResourceSetLayoutVk* getResourceSetLayout() const { return m_ResourceSetLayout; }
+		ResourceSetVk* getResourceSet() const { return m_ResourceSet; }
+	private:
+		void writeDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type,
+			const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+		const ContextVk& m_Context;
+		ResourceSetLayoutVk* m_ResourceSetLayout = nullptr;
+		ResourceSetVk* m_ResourceSet = nullptr;
+		BindlessIndexAllocator m_TextureIndices;
+		BindlessIndexAllocator m_BufferIndices;
+		BindlessIndexAllocator m_SamplerIndices;
+	};
+}
@@ -5,6 +5,7 @@
 #include "vk_resource.h"
 #include "rhi/common/Error.h"
 
+#include <algorithm>
 #include <array>
 #include <optional>
 
@@ -25,6 +26,20 @@ namespace rhi
 		{
 			buffer->lastUsedExecuteID = excuteID;
 		}
+		for (auto resourceSet : referencedResourceSets)
+		{
+			resourceSet->markSubmitted(excuteID);
+		}
+		referencedResourceSets.clear();
+	}
+
+	void CommandBuffer::releaseUnsubmittedReferences()
+	{
+		for (auto resourceSet : referencedResourceSets)
+		{
+			resourceSet->releaseReference();
+		}
+		referencedResourceSets.clear();
 	}
 
 	void CommandBuffer::resetLastUsedExecuteID()
@@ -36,13 +51,92 @@ namespace rhi
 		referencedHostVisibleBuffer.clear();
 	}
 
-	CommandListVk::~CommandListVk()
+	ResourceIndexMap::ResourceIndexMap(uint32_t initialCapacity)
+	{
+		assert(isPowerOfTwo(initialCapacity));
+		m_Slots.resize(initialCapacity);
+	}
+
+	inline static uint32_t hashResourcePointer(const void* resource)
+	{
+		// Fibonacci hashing, the low bits of heap pointers are mostly zero.
+		uint64_t key = reinterpret_cast<uintptr_t>(resource) >> 4;
+		return static_cast<uint32_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	uint32_t ResourceIndexMap::probe(const void* resource) const
+	{
+		const uint32_t mask = static_cast<uint32_t>(m_Slots.size()) - 1;
+		uint32_t slot = hashResourcePointer(resource) & mask;
+		while (m_Slots[slot].resource != nullptr && m_Slots[slot].resource != resource)
+		{
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	uint32_t ResourceIndexMap::find(const void* resource) const
+	{
+		assert(resource);
+		return m_Slots[probe(resource)].index;
+	}
+
+	uint32_t ResourceIndexMap::insert(const void* resource, uint32_t index)
+	{
+		assert(resource);
+		Slot& slot = m_Slots[probe(resource)];
+		if (slot.resource == resource)
+		{
+			return slot.index;
+		}
+
+		slot.resource = resource;
+		slot.index = index;
+		// keep the load factor below 1/2 so probe sequences stay short.
+		if (++m_Count * 2 > m_Slots.size())
+		{
+			grow();
+		}
+		return index;
+	}
+
+	void ResourceIndexMap::grow()
+	{
+		std::vector<Slot> oldSlots(m_Slots.size() * 2);
+		oldSlots.swap(m_Slots);
+		for (const Slot& slot : oldSlots)
+		{
+			if (slot.resource != nullptr)
+			{
+				m_Slots[probe(slot.resource)] = slot;
+			}
+		}
+	}
+
+	void ResourceIndexMap::clear()
 	{
+		if (m_Count != 0)
+		{
+			std::fill(m_Slots.begin(), m_Slots.end(), Slot{});
+			m_Count = 0;
+		}
+	}
 
+	CommandListVk::~CommandListVk()
+	{
+		if (m_CurrentCmdBuf)
+		{
+			m_CurrentCmdBuf->releaseUnsubmittedReferences();
+		}
 	}
 
 	void CommandListVk::open()
 	{
+		// binds of a recording that was never submitted no longer keep the sets in use
+		if (m_CurrentCmdBuf)
+		{
+			m_CurrentCmdBuf->releaseUnsubmittedReferences();
+		}
 		m_CurrentCmdBuf = m_RenderDevice.getOrCreateCommandBuffer();
 
 		VkCommandBufferBeginInfo cmdBufferBeginInfo{};
@@ -51,14 +145,26 @@ namespace rhi
 
 		vkBeginCommandBuffer(m_CurrentCmdBuf->vkCmdBuf, &cmdBufferBeginInfo);
 
+		if (const DescriptorBufferVk* descriptorBuffer = m_RenderDevice.getDescriptorBuffer())
+		{
+			m_RenderDevice.extensionFunctions.cmdBindDescriptorBuffers(m_CurrentCmdBuf->vkCmdBuf, 1, &descriptorBuffer->getBindingInfo());
+		}
+
 		//clear states
 		m_LastGraphicsState = {};
 		m_LastComputeState = {};
+		m_BarrierStatistics = {};
+		m_ClearStatistics = {};
+		m_DynamicStates = {};
+		m_InRenderPass = false;
 	}
 
 	void CommandListVk::close()
 	{
+		ASSERT_MSG(m_SplitBarriers.empty(), "Every begin transition must be paired with an end transition before close.");
+		ASSERT_MSG(!m_InRenderPass, "Every beginRenderPass must be paired with an endRenderPass before close.");
 		endRendering();
+		flushPendingClears(nullptr);
 		commitBarriers();
 		vkEndCommandBuffer(m_CurrentCmdBuf->vkCmdBuf);
 	}
@@ -77,6 +183,27 @@ namespace rhi
 		m_EnableAutoTransition = enable;
 	}
 
+	void CommandListVk::setGlobalMemoryBarriers(bool enable)
+	{
+		m_UseGlobalMemoryBarriers = enable;
+	}
+
+	void CommandListVk::setBarrierAnalysis(bool enable)
+	{
+		m_BarrierAnalysis = enable;
+	}
+
+	void CommandListVk::addGlobalBarrier(ResourceState stateBefore, ResourceState stateAfter)
+	{
+		if (!m_HasGlobalBarrier)
+		{
+			m_GlobalBarrierRequester = m_BarrierRequester;
+		}
+		m_GlobalBarrierBefore = m_GlobalBarrierBefore | stateBefore;
+		m_GlobalBarrierAfter = m_GlobalBarrierAfter | stateAfter;
+		m_HasGlobalBarrier = true;
+	}
+
 	inline static bool resourceStateHasWriteAccess(ResourceState state)
 	{
 		const ResourceState writeAccessStates =
@@ -85,9 +212,28 @@ namespace rhi
 			ResourceState::UnorderedAccess |
 			ResourceState::CopyDest |
 			ResourceState::ResolveDest;
-		return (state & writeAccessStates) == state;
+		return (state & writeAccessStates) != 0;
 	}
 
+	// Remembers the outermost command that records barriers, so the barrier analysis can report it.
+	class BarrierRequesterScope
+	{
+	public:
+		BarrierRequesterScope(const char*& requester, const char* name)
+			:m_Requester(requester),
+			m_Previous(requester)
+		{
+			if (m_Requester == nullptr)
+			{
+				m_Requester = name;
+			}
+		}
+		~BarrierRequesterScope() { m_Requester = m_Previous; }
+	private:
+		const char*& m_Requester;
+		const char* m_Previous;
+	};
+
 	void CommandListVk::transitionFromSubmmitedState(ITexture* texture, ResourceState newState)
 	{
 		assert(texture);
@@ -101,10 +247,7 @@ namespace rhi
 
 		if (transitionNecessary)
 		{
-			TextureBarrier& barrier = m_TextureBarriers.emplace_back();
-			barrier.texture = textureVk;
-			barrier.stateBefore = oldState;
-			barrier.stateAfter = newState;
+			addTextureBarrier(textureVk, oldState, newState);
 		}
 
 		textureVk->setState(newState);
@@ -117,13 +260,40 @@ namespace rhi
 			texture->submittedState = texture->getState();
 		}
 		m_TrackingSubmittedStates.clear();
+		m_TrackingSubmittedIndices.clear();
+	}
+
+	void CommandListVk::addTextureBarrier(TextureVk* texture, ResourceState stateBefore, ResourceState stateAfter)
+	{
+		uint32_t index = m_TextureBarrierIndices.insert(texture, static_cast<uint32_t>(m_TextureBarriers.size()));
+		if (index != m_TextureBarriers.size())
+		{
+			// The texture already has a pending barrier in this batch, nothing has accessed it since,
+			// so fold the two transitions into one. Layouts can't be combined, the last one wins.
+			m_TextureBarriers[index].stateAfter = stateAfter;
+			return;
+		}
+
+		TextureBarrier& barrier = m_TextureBarriers.emplace_back();
+		barrier.texture = texture;
+		barrier.stateBefore = stateBefore;
+		barrier.stateAfter = stateAfter;
+		barrier.requester = m_BarrierRequester;
 	}
 
 	void CommandListVk::transitionTextureState(ITexture* texture, ResourceState newState)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(texture);
 		auto textureVk = checked_cast<TextureVk*>(texture);
 
+		// A pending clear has to happen before the texture is used for anything but rendering,
+		// as an attachment it is folded into the load op instead.
+		if (!m_PendingClears.empty() && newState != ResourceState::RenderTarget && newState != ResourceState::DepthWrite)
+		{
+			flushPendingClears(textureVk);
+		}
+
 		ResourceState oldState = textureVk->getState();
 
 		// Always add barrier after writes.
@@ -132,18 +302,31 @@ namespace rhi
 
 		if (transitionNecessary)
 		{
-			TextureBarrier& barrier = m_TextureBarriers.emplace_back();
-			barrier.texture = textureVk;
-			barrier.stateBefore = oldState;
-			barrier.stateAfter = newState;
+			// No layout change, so a memory barrier is enough unless the texture already has a pending layout transition.
+			bool sameLayout = oldState != ResourceState::Undefined &&
+				resourceStateToVkImageLayout(oldState) == resourceStateToVkImageLayout(newState);
+			if (m_UseGlobalMemoryBarriers && sameLayout &&
+				m_TextureBarrierIndices.find(textureVk) == ResourceIndexMap::InvalidIndex)
+			{
+				addGlobalBarrier(oldState, newState);
+			}
+			else
+			{
+				addTextureBarrier(textureVk, oldState, newState);
+			}
 		}
 
-		m_TrackingSubmittedStates.push_back(textureVk);
+		if (m_TrackingSubmittedIndices.find(textureVk) == ResourceIndexMap::InvalidIndex)
+		{
+			m_TrackingSubmittedIndices.insert(textureVk, static_cast<uint32_t>(m_TrackingSubmittedStates.size()));
+			m_TrackingSubmittedStates.push_back(textureVk);
+		}
 		textureVk->setState(newState);
 	}
 
 	void CommandListVk::transitionBufferState(IBuffer* buffer, ResourceState newState)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(buffer);
 		auto bufferVk = checked_cast<BufferVk*>(buffer);
 
@@ -159,34 +342,173 @@ namespace rhi
 		bool isAfterWrites = resourceStateHasWriteAccess(oldState);
 		bool transitionNecessary = oldState != newState || isAfterWrites;
 
-		if (transitionNecessary)
+		if (transitionNecessary && m_UseGlobalMemoryBarriers &&
+			m_BufferBarrierIndices.find(bufferVk) == ResourceIndexMap::InvalidIndex)
+		{
+			addGlobalBarrier(oldState, newState);
+		}
+		else if (transitionNecessary)
 		{
 			// See if this buffer is already used for a different purpose in this batch.
 			// If it is, combine the state bits.
 			// Example: same buffer used as index and vertex buffer, or as SRV and indirect arguments.
-			for (BufferBarrier& barrier : m_BufferBarriers)
+			uint32_t index = m_BufferBarrierIndices.insert(bufferVk, static_cast<uint32_t>(m_BufferBarriers.size()));
+			if (index != m_BufferBarriers.size())
 			{
-				if (barrier.buffer == bufferVk)
+				BufferBarrier& barrier = m_BufferBarriers[index];
+				if (barrier.size == VK_WHOLE_SIZE)
 				{
 					barrier.stateAfter = ResourceState(barrier.stateAfter | newState);
 					bufferVk->setState(barrier.stateAfter);
 					return;
 				}
+				// Only parts of the buffer have pending barriers, and barriers in one batch
+				// are not ordered against each other, so flush them first.
+				commitBarriers();
+				m_BufferBarrierIndices.insert(bufferVk, 0);
 			}
 
 			BufferBarrier& barrier = m_BufferBarriers.emplace_back();
 			barrier.buffer = bufferVk;
 			barrier.stateBefore = oldState;
 			barrier.stateAfter = newState;
+			barrier.requester = m_BarrierRequester;
 		}
 
 		bufferVk->setState(newState);
 	}
 
+	void CommandListVk::transitionBufferState(IBuffer* buffer, ResourceState newState, uint64_t offset, uint64_t size)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(buffer);
+		auto bufferVk = checked_cast<BufferVk*>(buffer);
+		const uint64_t bufferSize = bufferVk->getDesc().size;
+		if (size == VK_WHOLE_SIZE)
+		{
+			size = bufferSize - offset;
+		}
+		assert(offset + size <= bufferSize);
+		if (size == 0)
+		{
+			return;
+		}
+
+		if (offset == 0 && size == bufferSize)
+		{
+			transitionBufferState(buffer, newState);
+			return;
+		}
+
+		// Flush the batch if a pending barrier of this buffer overlaps the range.
+		uint32_t firstIndex = m_BufferBarrierIndices.find(bufferVk);
+		if (firstIndex != ResourceIndexMap::InvalidIndex)
+		{
+			for (size_t i = firstIndex; i < m_BufferBarriers.size(); ++i)
+			{
+				const BufferBarrier& barrier = m_BufferBarriers[i];
+				bool overlaps = barrier.size == VK_WHOLE_SIZE ||
+					(barrier.offset < offset + size && offset < barrier.offset + barrier.size);
+				if (barrier.buffer == bufferVk && overlaps)
+				{
+					commitBarriers();
+					firstIndex = ResourceIndexMap::InvalidIndex;
+					break;
+				}
+			}
+		}
+
+		m_BufferRangeStates.clear();
+		bufferVk->getRangeStates(offset, size, m_BufferRangeStates);
+		for (const BufferRangeState& rangeState : m_BufferRangeStates)
+		{
+			// Always add barrier after writes.
+			bool isAfterWrites = resourceStateHasWriteAccess(rangeState.state);
+			if (rangeState.state == newState && !isAfterWrites)
+			{
+				continue;
+			}
+
+			if (m_UseGlobalMemoryBarriers && firstIndex == ResourceIndexMap::InvalidIndex)
+			{
+				addGlobalBarrier(rangeState.state, newState);
+				continue;
+			}
+
+			// merge with the previous barrier if it covers the adjacent range with the same transition.
+			if (!m_BufferBarriers.empty())
+			{
+				BufferBarrier& lastBarrier = m_BufferBarriers.back();
+				if (lastBarrier.buffer == bufferVk && lastBarrier.size != VK_WHOLE_SIZE &&
+					lastBarrier.offset + lastBarrier.size == rangeState.offset &&
+					lastBarrier.stateBefore == rangeState.state && lastBarrier.stateAfter == newState)
+				{
+					lastBarrier.size += rangeState.size;
+					continue;
+				}
+			}
+
+			m_BufferBarrierIndices.insert(bufferVk, static_cast<uint32_t>(m_BufferBarriers.size()));
+			BufferBarrier& barrier = m_BufferBarriers.emplace_back();
+			barrier.buffer = bufferVk;
+			barrier.stateBefore = rangeState.state;
+			barrier.stateAfter = newState;
+			barrier.offset = rangeState.offset;
+			barrier.size = rangeState.size;
+			barrier.requester = m_BarrierRequester;
+		}
+
+		bufferVk->setRangeState(offset, size, newState);
+	}
+
+	static void fillVkImageMemoryBarrier(const TextureVk* texture, ResourceState stateBefore, ResourceState stateAfter,
+		VkImageMemoryBarrier2& imageBarrier)
+	{
+		VkImageLayout oldLayout = resourceStateToVkImageLayout(stateBefore);
+		VkImageLayout newLayout = resourceStateToVkImageLayout(stateAfter);
+		assert(newLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+		VkImageSubresourceRange subresourceRange{};
+		subresourceRange.aspectMask = getVkAspectMask(texture->format);
+		subresourceRange.baseArrayLayer = 0;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.layerCount = texture->getDesc().arraySize;
+		subresourceRange.levelCount = texture->getDesc().mipLevels;
+
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		imageBarrier.pNext = nullptr;
+		imageBarrier.srcStageMask = resourceStatesToVkPipelineStageFlags2(stateBefore);
+		imageBarrier.srcAccessMask = resourceStatesToVkAccessFlags2(stateBefore);
+		imageBarrier.dstStageMask = resourceStatesToVkPipelineStageFlags2(stateAfter);
+		imageBarrier.dstAccessMask = resourceStatesToVkAccessFlags2(stateAfter);
+		imageBarrier.oldLayout = oldLayout;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = texture->image;
+		imageBarrier.subresourceRange = subresourceRange;
+	}
+
+	static void fillVkBufferMemoryBarrier(const BufferVk* buffer, ResourceState stateBefore, ResourceState stateAfter,
+		uint64_t offset, uint64_t size, VkBufferMemoryBarrier2& bufferBarrier)
+	{
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		bufferBarrier.pNext = nullptr;
+		bufferBarrier.srcStageMask = resourceStatesToVkPipelineStageFlags2(stateBefore);
+		bufferBarrier.srcAccessMask = resourceStatesToVkAccessFlags2(stateBefore);
+		bufferBarrier.dstStageMask = resourceStatesToVkPipelineStageFlags2(stateAfter);
+		bufferBarrier.dstAccessMask = resourceStatesToVkAccessFlags2(stateAfter);
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = buffer->buffer;
+		bufferBarrier.offset = offset;
+		bufferBarrier.size = size;
+	}
+
 	void CommandListVk::commitBarriers()
 	{
 		endRendering();
-		if (m_BufferBarriers.empty() && m_TextureBarriers.empty())
+		if (m_BufferBarriers.empty() && m_TextureBarriers.empty() && !m_HasGlobalBarrier)
 		{
 			return;
 		}
@@ -197,36 +519,10 @@ namespace rhi
 		for (int i = 0; i < m_TextureBarriers.size(); ++i)
 		{
 			const TextureBarrier& barrier = m_TextureBarriers[i];
-
-			VkImageLayout oldLayout = resourceStateToVkImageLayout(barrier.stateBefore);
-			VkImageLayout newLayout = resourceStateToVkImageLayout(barrier.stateAfter);
-			assert(newLayout != VK_IMAGE_LAYOUT_UNDEFINED);
-
-			VkPipelineStageFlags2 srcStage = resourceStatesToVkPipelineStageFlags2(barrier.stateBefore);
-			VkPipelineStageFlags2 dstStage = resourceStatesToVkPipelineStageFlags2(barrier.stateAfter);
-
-			VkAccessFlags2 srcAccessMask = resourceStatesToVkAccessFlags2(barrier.stateBefore);
-			VkAccessFlags2 dstAccessMask = resourceStatesToVkAccessFlags2(barrier.stateAfter);
-
-			VkImageSubresourceRange subresourceRange{};
-			subresourceRange.aspectMask = getVkAspectMask(barrier.texture->format);
-			subresourceRange.baseArrayLayer = 0;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.layerCount = barrier.texture->getDesc().arraySize;
-			subresourceRange.levelCount = barrier.texture->getDesc().mipLevels;
-
-			m_VkImageMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-			m_VkImageMemoryBarriers[i].pNext = nullptr;
-			m_VkImageMemoryBarriers[i].srcStageMask = srcStage;
-			m_VkImageMemoryBarriers[i].srcAccessMask = srcAccessMask;
-			m_VkImageMemoryBarriers[i].dstStageMask = dstStage;
-			m_VkImageMemoryBarriers[i].dstAccessMask = dstAccessMask;
-			m_VkImageMemoryBarriers[i].oldLayout = oldLayout;
-			m_VkImageMemoryBarriers[i].newLayout = newLayout;
-			m_VkImageMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			m_VkImageMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			m_VkImageMemoryBarriers[i].image = barrier.texture->image;
-			m_VkImageMemoryBarriers[i].subresourceRange = subresourceRange;
+			VkImageMemoryBarrier2& imageBarrier = m_VkImageMemoryBarriers[i];
+			fillVkImageMemoryBarrier(barrier.texture, barrier.stateBefore, barrier.stateAfter, imageBarrier);
+			analyzeBarrier(barrier.texture, barrier.stateBefore, barrier.stateAfter, imageBarrier.srcStageMask, imageBarrier.dstStageMask,
+				imageBarrier.oldLayout != imageBarrier.newLayout, false, barrier.requester);
 		}
 
 		for (int i = 0; i < m_BufferBarriers.size(); ++i)
@@ -237,30 +533,32 @@ namespace rhi
 			//{
 			//	continue;
 			//}
+			VkBufferMemoryBarrier2& bufferBarrier = m_VkBufferMemoryBarriers[i];
+			fillVkBufferMemoryBarrier(barrier.buffer, barrier.stateBefore, barrier.stateAfter,
+				barrier.offset, barrier.size, bufferBarrier);
+			analyzeBarrier(barrier.buffer, barrier.stateBefore, barrier.stateAfter, bufferBarrier.srcStageMask, bufferBarrier.dstStageMask,
+				false, true, barrier.requester);
+		}
 
-			VkPipelineStageFlags2 srcStage = resourceStatesToVkPipelineStageFlags2(barrier.stateBefore);
-			VkPipelineStageFlags2 dstStage = resourceStatesToVkPipelineStageFlags2(barrier.stateAfter);
-
-			VkAccessFlags2 srcAccessMask = resourceStatesToVkAccessFlags2(barrier.stateBefore);
-			VkAccessFlags2 dstAccessMask = resourceStatesToVkAccessFlags2(barrier.stateAfter);
-
-			m_VkBufferMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
-			m_VkBufferMemoryBarriers[i].pNext = nullptr;
-			m_VkBufferMemoryBarriers[i].srcStageMask = srcStage;
-			m_VkBufferMemoryBarriers[i].srcAccessMask = srcAccessMask;
-			m_VkBufferMemoryBarriers[i].dstStageMask = dstStage;
-			m_VkBufferMemoryBarriers[i].dstAccessMask = dstAccessMask;
-			m_VkBufferMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			m_VkBufferMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			m_VkBufferMemoryBarriers[i].buffer = barrier.buffer->buffer;
-			m_VkBufferMemoryBarriers[i].size = barrier.buffer->getDesc().size;
-			m_VkBufferMemoryBarriers[i].offset = 0;
+		VkMemoryBarrier2 memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		memoryBarrier.pNext = nullptr;
+		memoryBarrier.srcStageMask = resourceStatesToVkPipelineStageFlags2(m_GlobalBarrierBefore);
+		memoryBarrier.srcAccessMask = resourceStatesToVkAccessFlags2(m_GlobalBarrierBefore);
+		memoryBarrier.dstStageMask = resourceStatesToVkPipelineStageFlags2(m_GlobalBarrierAfter);
+		memoryBarrier.dstAccessMask = resourceStatesToVkAccessFlags2(m_GlobalBarrierAfter);
+		if (m_HasGlobalBarrier)
+		{
+			analyzeBarrier(nullptr, m_GlobalBarrierBefore, m_GlobalBarrierAfter, memoryBarrier.srcStageMask, memoryBarrier.dstStageMask,
+				false, false, m_GlobalBarrierRequester);
 		}
 
 		VkDependencyInfo dependencyInfo{};
 		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
 		dependencyInfo.pNext = nullptr;
 		dependencyInfo.dependencyFlags = 0;
+		dependencyInfo.memoryBarrierCount = m_HasGlobalBarrier ? 1 : 0;
+		dependencyInfo.pMemoryBarriers = &memoryBarrier;
 		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(m_VkImageMemoryBarriers.size());
 		dependencyInfo.pImageMemoryBarriers = m_VkImageMemoryBarriers.data();
 		dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(m_VkBufferMemoryBarriers.size());
@@ -268,10 +566,176 @@ namespace rhi
 
 		vkCmdPipelineBarrier2(m_CurrentCmdBuf->vkCmdBuf, &dependencyInfo);
 
+		m_BarrierStatistics.pipelineBarrierCount++;
+		m_BarrierStatistics.imageBarrierCount += dependencyInfo.imageMemoryBarrierCount;
+		m_BarrierStatistics.bufferBarrierCount += dependencyInfo.bufferMemoryBarrierCount;
+		m_BarrierStatistics.memoryBarrierCount += dependencyInfo.memoryBarrierCount;
+
 		m_BufferBarriers.clear();
 		m_TextureBarriers.clear();
+		m_BufferBarrierIndices.clear();
+		m_TextureBarrierIndices.clear();
 		m_VkBufferMemoryBarriers.clear();
 		m_VkImageMemoryBarriers.clear();
+		m_HasGlobalBarrier = false;
+		m_GlobalBarrierBefore = ResourceState::Undefined;
+		m_GlobalBarrierAfter = ResourceState::Undefined;
+		m_GlobalBarrierRequester = nullptr;
+	}
+
+	void CommandListVk::analyzeBarrier(const void* resource, ResourceState stateBefore, ResourceState stateAfter,
+		VkPipelineStageFlags2 srcStages, VkPipelineStageFlags2 dstStages, bool layoutTransition, bool isBuffer, const char* requester)
+	{
+		m_BarrierStatistics.srcStageMask |= srcStages;
+		m_BarrierStatistics.dstStageMask |= dstStages;
+
+		bool readToRead = stateBefore != ResourceState::Undefined && !resourceStateHasWriteAccess(stateBefore) &&
+			!resourceStateHasWriteAccess(stateAfter) && !layoutTransition;
+		bool allCommands = ((srcStages | dstStages) & VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT) != 0;
+		if (layoutTransition)
+		{
+			m_BarrierStatistics.layoutTransitionCount++;
+		}
+		if (readToRead)
+		{
+			m_BarrierStatistics.readToReadCount++;
+		}
+		if (allCommands)
+		{
+			m_BarrierStatistics.allCommandsCount++;
+		}
+
+		if (!m_BarrierAnalysis)
+		{
+			return;
+		}
+
+		const char* resourceType = resource == nullptr ? "global memory" : (isBuffer ? "buffer" : "texture");
+		const char* requesterName = requester != nullptr ? requester : "unknown";
+		if (readToRead)
+		{
+			LOG_WARNING("Redundant read to read barrier on ", resourceType, " ", resource,
+				" (states ", uint32_t(stateBefore), " -> ", uint32_t(stateAfter), ") requested by ", requesterName);
+		}
+		else if (isBuffer && stateBefore == ResourceState::Undefined)
+		{
+			LOG_WARNING("Barrier from Undefined has no effect on buffer ", resource, ", requested by ", requesterName);
+		}
+		if (allCommands)
+		{
+			LOG_WARNING("Over-broad barrier on ", resourceType, " ", resource, " waits on or blocks all commands (states ",
+				uint32_t(stateBefore), " -> ", uint32_t(stateAfter), "), requested by ", requesterName);
+		}
+	}
+
+	void CommandListVk::uavBarrier()
+	{
+		assert(m_CurrentCmdBuf);
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+
+		addGlobalBarrier(ResourceState::UnorderedAccess, ResourceState::UnorderedAccess);
+		commitBarriers();
+	}
+
+	void CommandListVk::beginTextureTransition(ITexture* texture, ResourceState newState)
+	{
+		assert(texture);
+		assert(m_CurrentCmdBuf);
+		auto textureVk = checked_cast<TextureVk*>(texture);
+		flushPendingClears(textureVk);
+
+		// The texture may still have a pending barrier in this batch, and
+		// vkCmdSetEvent2 must not be recorded inside a rendering section.
+		commitBarriers();
+
+		SplitBarrier& splitBarrier = m_SplitBarriers.emplace_back();
+		splitBarrier.resource = textureVk;
+		splitBarrier.isTexture = true;
+		splitBarrier.event = m_RenderDevice.getOrCreateEvent();
+		m_BarrierStatistics.splitBarrierCount++;
+		fillVkImageMemoryBarrier(textureVk, textureVk->getState(), newState, splitBarrier.imageBarrier);
+
+		VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &splitBarrier.imageBarrier;
+		vkCmdSetEvent2(m_CurrentCmdBuf->vkCmdBuf, splitBarrier.event, &dependencyInfo);
+
+		if (m_TrackingSubmittedIndices.find(textureVk) == ResourceIndexMap::InvalidIndex)
+		{
+			m_TrackingSubmittedIndices.insert(textureVk, static_cast<uint32_t>(m_TrackingSubmittedStates.size()));
+			m_TrackingSubmittedStates.push_back(textureVk);
+		}
+		textureVk->setState(newState);
+	}
+
+	void CommandListVk::endTextureTransition(ITexture* texture)
+	{
+		assert(texture);
+		endSplitBarrier(checked_cast<TextureVk*>(texture));
+	}
+
+	void CommandListVk::beginBufferTransition(IBuffer* buffer, ResourceState newState)
+	{
+		assert(buffer);
+		assert(m_CurrentCmdBuf);
+		auto bufferVk = checked_cast<BufferVk*>(buffer);
+
+		commitBarriers();
+
+		SplitBarrier& splitBarrier = m_SplitBarriers.emplace_back();
+		splitBarrier.resource = bufferVk;
+		splitBarrier.isTexture = false;
+		splitBarrier.event = m_RenderDevice.getOrCreateEvent();
+		m_BarrierStatistics.splitBarrierCount++;
+		fillVkBufferMemoryBarrier(bufferVk, bufferVk->getState(), newState, 0, VK_WHOLE_SIZE, splitBarrier.bufferBarrier);
+
+		VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		dependencyInfo.bufferMemoryBarrierCount = 1;
+		dependencyInfo.pBufferMemoryBarriers = &splitBarrier.bufferBarrier;
+		vkCmdSetEvent2(m_CurrentCmdBuf->vkCmdBuf, splitBarrier.event, &dependencyInfo);
+
+		bufferVk->setState(newState);
+	}
+
+	void CommandListVk::endBufferTransition(IBuffer* buffer)
+	{
+		assert(buffer);
+		endSplitBarrier(checked_cast<BufferVk*>(buffer));
+	}
+
+	void CommandListVk::endSplitBarrier(const void* resource)
+	{
+		auto iter = std::find_if(m_SplitBarriers.begin(), m_SplitBarriers.end(),
+			[resource](const SplitBarrier& splitBarrier) { return splitBarrier.resource == resource; });
+		if (iter == m_SplitBarriers.end())
+		{
+			LOG_ERROR("The resource has no split transition in progress.");
+			return;
+		}
+
+		endRendering();
+
+		// The dependency info must match the one passed to vkCmdSetEvent2.
+		VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		VkPipelineStageFlags2 dstStage;
+		if (iter->isTexture)
+		{
+			dependencyInfo.imageMemoryBarrierCount = 1;
+			dependencyInfo.pImageMemoryBarriers = &iter->imageBarrier;
+			dstStage = iter->imageBarrier.dstStageMask;
+		}
+		else
+		{
+			dependencyInfo.bufferMemoryBarrierCount = 1;
+			dependencyInfo.pBufferMemoryBarriers = &iter->bufferBarrier;
+			dstStage = iter->bufferBarrier.dstStageMask;
+		}
+		vkCmdWaitEvents2(m_CurrentCmdBuf->vkCmdBuf, 1, &iter->event, &dependencyInfo);
+		// Unsignal the event once the wait is done, so it can go back to the pool after this submission.
+		vkCmdResetEvent2(m_CurrentCmdBuf->vkCmdBuf, iter->event, dstStage);
+
+		m_CurrentCmdBuf->referencedEvents.push_back(iter->event);
+		m_SplitBarriers.erase(iter);
 	}
 
 	void CommandListVk::setBufferBarrier(BufferVk* buffer, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
@@ -295,68 +759,67 @@ namespace rhi
 		dependencyInfo.pBufferMemoryBarriers = &barrier;
 
 		vkCmdPipelineBarrier2(m_CurrentCmdBuf->vkCmdBuf, &dependencyInfo);
+
+		m_BarrierStatistics.pipelineBarrierCount++;
+		m_BarrierStatistics.bufferBarrierCount++;
+	}
+
+	static int findAttachment(const RenderPassDesc& desc, const ITextureView* textureView)
+	{
+		for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
+		{
+			if (desc.colorAttachments[i].view == textureView)
+			{
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
 	}
 
 	void CommandListVk::clearColorTexture(ITextureView* textureView, const ClearColor& color)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(textureView);
 		assert(m_CurrentCmdBuf);
 		auto tv = checked_cast<TextureViewVk*>(textureView);
 		auto texture = checked_cast<TextureVk*>(tv->getTexture());
-		VkClearColorValue clearValue = convertVkClearColor(color, texture->desc.format);
-
-		// Check if the textureView is one of the currently bound renderTargetView
-		int rendetTargetIndex = -1;
-		for (uint32_t i = 0; i < m_LastGraphicsState.renderTargetCount; ++i)
-		{
-			if (m_LastGraphicsState.renderTargetViews[i] == textureView)
-			{
-				rendetTargetIndex = i;
-			}
-		}
 
+		// Check if the textureView is one of the render targets of the current rendering section
+		int rendetTargetIndex = m_RenderingStarted ? findAttachment(m_RenderPassDesc, textureView) : -1;
 		if (rendetTargetIndex != -1)
 		{
 			VkClearAttachment clearAttachment{};
 			clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			clearAttachment.colorAttachment = static_cast<uint32_t>(rendetTargetIndex);
-			clearAttachment.clearValue.color = clearValue;
+			clearAttachment.clearValue.color = convertVkClearColor(color, texture->desc.format);
 
 			VkClearRect clearRect{};
 			clearRect.rect.offset = { 0, 0 };
 			clearRect.rect.extent = { texture->desc.width,  texture->desc.height };
 			clearRect.baseArrayLayer = 0;
-			clearRect.layerCount = texture->desc.arraySize;
+			// with multiview the clear covers the layers of all views in the mask
+			clearRect.layerCount = m_RenderPassDesc.viewMask != 0 ? 1 : texture->desc.arraySize;
 
 			vkCmdClearAttachments(m_CurrentCmdBuf->vkCmdBuf, 1, &clearAttachment, 1, &clearRect);
+			m_ClearStatistics.explicitClearCount++;
+			return;
 		}
-		else
-		{
-			if (m_EnableAutoTransition)
-			{
-				transitionTextureState(tv->getTexture(), ResourceState::CopyDest);
-			}
-			commitBarriers();
-
-			VkImageSubresourceRange imageSubresourceRange{};
-			imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageSubresourceRange.baseArrayLayer = tv->desc.baseArrayLayer;
-			imageSubresourceRange.layerCount = tv->desc.arrayLayerCount;
-			imageSubresourceRange.baseMipLevel = tv->desc.baseMipLevel;
-			imageSubresourceRange.levelCount = tv->desc.mipLevelCount;
 
-			vkCmdClearColorImage(m_CurrentCmdBuf->vkCmdBuf, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &imageSubresourceRange);
-		}
+		// Defer the clear, the next render pass using the view as attachment turns it into a load op.
+		PendingClear* pendingClear = getPendingClear(tv);
+		pendingClear->isColor = true;
+		pendingClear->color = color;
 	}
 
 	void CommandListVk::clearDepthStencil(ITextureView* textureView, ClearDepthStencilFlag flag, float depthVal, uint8_t stencilVal)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(textureView);
 		assert(m_CurrentCmdBuf);
 		auto tv = checked_cast<TextureViewVk*>(textureView);
 		auto texture = checked_cast<TextureVk*>(tv->getTexture());
 
-		if (textureView == m_LastGraphicsState.depthStencilView)
+		if (m_RenderingStarted && textureView == m_RenderPassDesc.depthStencilAttachment.view)
 		{
 			VkClearAttachment clearAttachment{};
 			if ((flag & ClearDepthStencilFlag::Depth) != 0)
@@ -376,42 +839,203 @@ namespace rhi
 			clearRect.rect.offset = { 0, 0 };
 			clearRect.rect.extent = { texture->desc.width,  texture->desc.height };
 			clearRect.baseArrayLayer = 0;
-			clearRect.layerCount = texture->desc.arraySize;
+			// with multiview the clear covers the layers of all views in the mask
+			clearRect.layerCount = m_RenderPassDesc.viewMask != 0 ? 1 : texture->desc.arraySize;
 
 			vkCmdClearAttachments(m_CurrentCmdBuf->vkCmdBuf, 1, &clearAttachment, 1, &clearRect);
+			m_ClearStatistics.explicitClearCount++;
+			return;
 		}
-		else
-		{
-			if (m_EnableAutoTransition)
-			{
-				transitionTextureState(texture, ResourceState::CopyDest);
-			}
-			commitBarriers();
 
-			VkImageSubresourceRange imageSubresourceRange{};
-			if ((flag & ClearDepthStencilFlag::Depth) != 0)
-			{
+		PendingClear* pendingClear = getPendingClear(tv);
+		pendingClear->isColor = false;
+		// A second clear of the same view only overrides the aspects it clears.
+		if ((flag & ClearDepthStencilFlag::Depth) != 0)
+		{
+			pendingClear->depth = depthVal;
+		}
+		if ((flag & ClearDepthStencilFlag::Stencil) != 0)
+		{
+			pendingClear->stencil = stencilVal;
+		}
+		pendingClear->depthStencilFlag = pendingClear->depthStencilFlag | flag;
+	}
+
+	CommandListVk::PendingClear* CommandListVk::getPendingClear(TextureViewVk* textureView)
+	{
+		for (size_t i = 0; i < m_PendingClears.size(); ++i)
+		{
+			if (m_PendingClears[i].view == textureView)
+			{
+				return &m_PendingClears[i];
+			}
+			if (m_PendingClears[i].view->getTexture() == textureView->getTexture())
+			{
+				// Another view of the texture may overlap, keep the order of the two clears.
+				flushPendingClear(i);
+				break;
+			}
+		}
+		PendingClear& pendingClear = m_PendingClears.emplace_back();
+		pendingClear.view = textureView;
+		return &pendingClear;
+	}
+
+	void CommandListVk::flushPendingClears(const ITexture* texture)
+	{
+		for (size_t i = 0; i < m_PendingClears.size(); ++i)
+		{
+			if (texture == nullptr || m_PendingClears[i].view->getTexture() == texture)
+			{
+				flushPendingClear(i);
+				--i;
+			}
+		}
+	}
+
+	void CommandListVk::flushPendingClear(size_t index)
+	{
+		// Remove it first, the transition below would flush it again.
+		PendingClear pendingClear = m_PendingClears[index];
+		m_PendingClears.erase(m_PendingClears.begin() + index);
+
+		TextureViewVk* tv = pendingClear.view;
+		auto texture = checked_cast<TextureVk*>(tv->getTexture());
+		if (m_EnableAutoTransition)
+		{
+			transitionTextureState(texture, ResourceState::CopyDest);
+		}
+		commitBarriers();
+
+		VkImageSubresourceRange imageSubresourceRange{};
+		imageSubresourceRange.baseArrayLayer = tv->desc.baseArrayLayer;
+		imageSubresourceRange.layerCount = tv->desc.arrayLayerCount;
+		imageSubresourceRange.baseMipLevel = tv->desc.baseMipLevel;
+		imageSubresourceRange.levelCount = tv->desc.mipLevelCount;
+
+		if (pendingClear.isColor)
+		{
+			imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			VkClearColorValue clearValue = convertVkClearColor(pendingClear.color, texture->desc.format);
+			vkCmdClearColorImage(m_CurrentCmdBuf->vkCmdBuf, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &imageSubresourceRange);
+		}
+		else
+		{
+			if ((pendingClear.depthStencilFlag & ClearDepthStencilFlag::Depth) != 0)
+			{
 				imageSubresourceRange.aspectMask |= VK_IMAGE_ASPECT_DEPTH_BIT;
 			}
-			if ((flag & ClearDepthStencilFlag::Stencil) != 0)
+			if ((pendingClear.depthStencilFlag & ClearDepthStencilFlag::Stencil) != 0)
 			{
 				imageSubresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 			}
-			imageSubresourceRange.baseArrayLayer = tv->desc.baseArrayLayer;
-			imageSubresourceRange.layerCount = tv->desc.arrayLayerCount;
-			imageSubresourceRange.baseMipLevel = tv->desc.baseMipLevel;
-			imageSubresourceRange.levelCount = tv->desc.mipLevelCount;
 
 			VkClearDepthStencilValue clearValue;
-			clearValue.depth = depthVal;
-			clearValue.stencil = stencilVal;
+			clearValue.depth = pendingClear.depth;
+			clearValue.stencil = pendingClear.stencil;
 
 			vkCmdClearDepthStencilImage(m_CurrentCmdBuf->vkCmdBuf, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &imageSubresourceRange);
 		}
+		m_ClearStatistics.explicitClearCount++;
+	}
+
+	void CommandListVk::flushUnfoldablePendingClears(const RenderPassDesc& desc)
+	{
+		bool flushed = false;
+		for (size_t i = 0; i < m_PendingClears.size(); ++i)
+		{
+			const PendingClear& pendingClear = m_PendingClears[i];
+			const ITexture* texture = pendingClear.view->getTexture();
+			bool isAttachment = false;
+			bool foldable = false;
+			for (uint32_t j = 0; j < desc.colorAttachmentCount; ++j)
+			{
+				if (desc.colorAttachments[j].view->getTexture() == texture)
+				{
+					isAttachment = true;
+					foldable = foldable || (desc.colorAttachments[j].view == pendingClear.view && pendingClear.isColor);
+				}
+			}
+			const RenderPassDepthStencilAttachment& depthStencil = desc.depthStencilAttachment;
+			if (depthStencil.view && depthStencil.view->getTexture() == texture)
+			{
+				isAttachment = true;
+				foldable = foldable || (depthStencil.view == pendingClear.view && !pendingClear.isColor);
+			}
+			if (isAttachment && !foldable)
+			{
+				// Another view of an attachment texture, left pending it would wipe what the pass renders.
+				flushPendingClear(i);
+				--i;
+				flushed = true;
+			}
+		}
+
+		if (flushed && m_EnableAutoTransition)
+		{
+			// the clears moved the attachments to CopyDest
+			for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
+			{
+				transitionTextureState(desc.colorAttachments[i].view->getTexture(), ResourceState::RenderTarget);
+			}
+			if (desc.depthStencilAttachment.view)
+			{
+				transitionTextureState(desc.depthStencilAttachment.view->getTexture(), ResourceState::DepthWrite);
+			}
+			commitBarriers();
+		}
+	}
+
+	void CommandListVk::foldPendingClears(RenderPassDesc& desc)
+	{
+		if (m_PendingClears.empty())
+		{
+			return;
+		}
+
+		for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
+		{
+			RenderPassColorAttachment& attachment = desc.colorAttachments[i];
+			for (size_t j = 0; j < m_PendingClears.size(); ++j)
+			{
+				const PendingClear& pendingClear = m_PendingClears[j];
+				if (pendingClear.view == attachment.view && pendingClear.isColor)
+				{
+					attachment.loadOp = AttachmentLoadOp::Clear;
+					attachment.clearColor = pendingClear.color;
+					m_PendingClears.erase(m_PendingClears.begin() + j);
+					m_ClearStatistics.foldedClearCount++;
+					break;
+				}
+			}
+		}
+
+		RenderPassDepthStencilAttachment& depthStencil = desc.depthStencilAttachment;
+		for (size_t j = 0; j < m_PendingClears.size(); ++j)
+		{
+			const PendingClear& pendingClear = m_PendingClears[j];
+			if (pendingClear.view == depthStencil.view && !pendingClear.isColor)
+			{
+				if ((pendingClear.depthStencilFlag & ClearDepthStencilFlag::Depth) != 0)
+				{
+					depthStencil.depthLoadOp = AttachmentLoadOp::Clear;
+					depthStencil.clearDepth = pendingClear.depth;
+				}
+				if ((pendingClear.depthStencilFlag & ClearDepthStencilFlag::Stencil) != 0)
+				{
+					depthStencil.stencilLoadOp = AttachmentLoadOp::Clear;
+					depthStencil.clearStencil = pendingClear.stencil;
+				}
+				m_PendingClears.erase(m_PendingClears.begin() + j);
+				m_ClearStatistics.foldedClearCount++;
+				break;
+			}
+		}
 	}
 
 	void CommandListVk::copyBuffer(IBuffer* srcBuffer, uint64_t srcOffset, IBuffer* dstBuffer, uint64_t dstOffset, uint64_t dataSize)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(srcBuffer && dstBuffer);
 		assert(m_CurrentCmdBuf);
 
@@ -432,8 +1056,8 @@ namespace rhi
 
 		if (m_EnableAutoTransition)
 		{
-			transitionBufferState(srcBuffer, ResourceState::CopySource);
-			transitionBufferState(dstBuffer, ResourceState::CopyDest);
+			transitionBufferState(srcBuffer, ResourceState::CopySource, srcOffset, dataSize);
+			transitionBufferState(dstBuffer, ResourceState::CopyDest, dstOffset, dataSize);
 		}
 		commitBarriers();
 
@@ -446,6 +1070,7 @@ namespace rhi
 
 	void CommandListVk::updateBuffer(IBuffer* buffer, const void* data, uint64_t dataSize, uint64_t offset)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(buffer);
 		assert(m_CurrentCmdBuf);
 		auto buf = checked_cast<BufferVk*>(buffer);
@@ -462,14 +1087,14 @@ namespace rhi
 		if ((offset & 3) == 0 && (dataSize & 3) == 0 && dataSize < vkCmdUpdateBufferLimit)
 		{
 
+			// Round up the write size to a multiple of 4
+			const uint64_t sizeToWrite = (dataSize + 3) & ~uint64_t(3);
 			if (m_EnableAutoTransition)
 			{
-				transitionBufferState(buf, ResourceState::CopyDest);
+				transitionBufferState(buf, ResourceState::CopyDest, offset, sizeToWrite);
 			}
 			commitBarriers();
 
-			// Round up the write size to a multiple of 4
-			const uint64_t sizeToWrite = (dataSize + 3) & ~uint64_t(3);
 			vkCmdUpdateBuffer(m_CurrentCmdBuf->vkCmdBuf, buf->buffer, offset, sizeToWrite, data);
 		}
 		else
@@ -479,12 +1104,13 @@ namespace rhi
 			stageBufferDesc.usage = BufferUsage::None;
 			auto& stageBuffer = m_CurrentCmdBuf->referencedInternalStageBuffer.emplace_back();
 			stageBuffer = std::unique_ptr<BufferVk>(checked_cast<BufferVk*>(m_RenderDevice.createBuffer(stageBufferDesc, data, dataSize)));
-			copyBuffer(stageBuffer.get(), 0, buf, 0, dataSize);
+			copyBuffer(stageBuffer.get(), 0, buf, offset, dataSize);
 		}
 	}
 
 	void* CommandListVk::mapBuffer(IBuffer* buffer, MapBufferUsage usage)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(buffer);
 		assert(m_CurrentCmdBuf);
 		auto buf = checked_cast<BufferVk*>(buffer);
@@ -503,6 +1129,7 @@ namespace rhi
 
 	void CommandListVk::updateTexture(ITexture* texture, const void* data, uint64_t dataSize, const TextureUpdateInfo& updateInfo)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(m_CurrentCmdBuf);
 		auto tex = checked_cast<TextureVk*>(texture);
 
@@ -544,6 +1171,8 @@ namespace rhi
 		bufferCopyRegion.imageOffset = { static_cast<int32_t>(updateInfo.dstRegion.minX), static_cast<int32_t>(updateInfo.dstRegion.minY), static_cast<int32_t>(updateInfo.dstRegion.minZ) };
 		bufferCopyRegion.imageExtent = { updateInfo.dstRegion.getWidth(), updateInfo.dstRegion.getHeight(), updateInfo.dstRegion.getDepth() };
 
+		// pending clears land first, also when the caller tracks the states
+		flushPendingClears(tex);
 		if (m_EnableAutoTransition)
 		{
 			transitionTextureState(tex, ResourceState::CopyDest);
@@ -553,8 +1182,255 @@ namespace rhi
 		vkCmdCopyBufferToImage(m_CurrentCmdBuf->vkCmdBuf, stageBuffer->buffer, tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	}
 
+	void CommandListVk::resolveTexture(ITexture* dstTexture, ITexture* srcTexture)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(m_CurrentCmdBuf);
+		assert(dstTexture && srcTexture);
+		auto dst = checked_cast<TextureVk*>(dstTexture);
+		auto src = checked_cast<TextureVk*>(srcTexture);
+		ASSERT_MSG(src->desc.sampleCount > 1 && dst->desc.sampleCount == 1, "Resolve from a multisampled texture into a single sampled one.");
+		ASSERT_MSG(src->desc.format == dst->desc.format, "Resolve needs the same format on both textures.");
+		ASSERT_MSG(!getFormatInfo(src->desc.format).hasDepth && !getFormatInfo(src->desc.format).hasStencil,
+			"Depth stencil can only be resolved in a render pass.");
+
+		flushPendingClears(src);
+		flushPendingClears(dst);
+		if (m_EnableAutoTransition)
+		{
+			transitionTextureState(src, ResourceState::ResolveSource);
+			transitionTextureState(dst, ResourceState::ResolveDest);
+		}
+		commitBarriers();
+
+		VkImageResolve region{};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = 0;
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = (std::min)(src->desc.arraySize, dst->desc.arraySize);
+		region.dstSubresource = region.srcSubresource;
+		region.extent.width = (std::min)(src->desc.width, dst->desc.width);
+		region.extent.height = (std::min)(src->desc.height, dst->desc.height);
+		region.extent.depth = 1;
+
+		vkCmdResolveImage(m_CurrentCmdBuf->vkCmdBuf, src->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			dst->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	static bool isFormatFeatureSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatFeatureFlags features)
+	{
+		VkFormatProperties properties{};
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+		return (properties.optimalTilingFeatures & features) == features;
+	}
+
+	void CommandListVk::blitTexture(ITexture* srcTexture, ITexture* dstTexture, FilterMode filter)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(m_CurrentCmdBuf);
+		assert(srcTexture && dstTexture);
+		ASSERT_MSG(srcTexture != dstTexture, "Use generateMips to blit between the mips of a texture.");
+		auto src = checked_cast<TextureVk*>(srcTexture);
+		auto dst = checked_cast<TextureVk*>(dstTexture);
+		ASSERT_MSG(src->desc.sampleCount == 1 && dst->desc.sampleCount == 1, "Multisampled textures can't be blitted, use resolveTexture.");
+		ASSERT_MSG((getVkImageUsageFlags(src->desc) & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0,
+			"The source of a blit needs TextureUsage::CopySource.");
+
+		VkFormatFeatureFlags srcFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+		if (filter == FilterMode::Linear)
+		{
+			srcFeatures |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		}
+		if (!isFormatFeatureSupported(m_RenderDevice.context.physicalDevice, src->format, srcFeatures) ||
+			!isFormatFeatureSupported(m_RenderDevice.context.physicalDevice, dst->format, VK_FORMAT_FEATURE_BLIT_DST_BIT))
+		{
+			LOG_ERROR("blitTexture: the formats don't support ", filter == FilterMode::Linear ? "linear " : "", "blits");
+			return;
+		}
+
+		flushPendingClears(src);
+		flushPendingClears(dst);
+		if (m_EnableAutoTransition)
+		{
+			transitionTextureState(src, ResourceState::CopySource);
+			transitionTextureState(dst, ResourceState::CopyDest);
+		}
+		commitBarriers();
+
+		VkImageBlit region{};
+		region.srcSubresource.aspectMask = getVkAspectMask(src->format);
+		region.srcSubresource.mipLevel = 0;
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = (std::min)(src->desc.arraySize, dst->desc.arraySize);
+		region.srcOffsets[1] = { static_cast<int32_t>(src->desc.width), static_cast<int32_t>(src->desc.height),
+			src->desc.dimension == TextureDimension::Texture3D ? static_cast<int32_t>(src->desc.depth) : 1 };
+		region.dstSubresource = region.srcSubresource;
+		region.dstSubresource.aspectMask = getVkAspectMask(dst->format);
+		region.dstOffsets[1] = { static_cast<int32_t>(dst->desc.width), static_cast<int32_t>(dst->desc.height),
+			dst->desc.dimension == TextureDimension::Texture3D ? static_cast<int32_t>(dst->desc.depth) : 1 };
+
+		vkCmdBlitImage(m_CurrentCmdBuf->vkCmdBuf, src->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			dst->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+			filter == FilterMode::Linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+	}
+
+	void CommandListVk::recordMipBarrier(TextureVk* texture, uint32_t mipLevel, ResourceState stateBefore, ResourceState stateAfter)
+	{
+		VkImageMemoryBarrier2 imageBarrier{};
+		fillVkImageMemoryBarrier(texture, stateBefore, stateAfter, imageBarrier);
+		imageBarrier.subresourceRange.baseMipLevel = mipLevel;
+		imageBarrier.subresourceRange.levelCount = 1;
+		analyzeBarrier(texture, stateBefore, stateAfter, imageBarrier.srcStageMask, imageBarrier.dstStageMask,
+			imageBarrier.oldLayout != imageBarrier.newLayout, false, m_BarrierRequester);
+
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+		vkCmdPipelineBarrier2(m_CurrentCmdBuf->vkCmdBuf, &dependencyInfo);
+
+		m_BarrierStatistics.pipelineBarrierCount++;
+		m_BarrierStatistics.imageBarrierCount++;
+	}
+
+	void CommandListVk::generateMips(ITexture* texture)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(m_CurrentCmdBuf);
+		assert(texture);
+		auto textureVk = checked_cast<TextureVk*>(texture);
+		const TextureDesc& desc = textureVk->desc;
+		ASSERT_MSG(desc.sampleCount == 1, "Multisampled textures have no mips.");
+		ASSERT_MSG(!getFormatInfo(desc.format).hasDepth && !getFormatInfo(desc.format).hasStencil,
+			"Mips of depth stencil textures can't be filtered, build them with a compute shader.");
+		if (desc.mipLevels <= 1)
+		{
+			return;
+		}
+
+		if (isFormatFeatureSupported(m_RenderDevice.context.physicalDevice, textureVk->format,
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+		{
+			generateMipsWithBlit(textureVk);
+			return;
+		}
+
+		if (!m_RenderDevice.mipDownsample.pipeline)
+		{
+			LOG_ERROR("generateMips: the format can't be blitted and no mip downsample shader was provided");
+			return;
+		}
+		if ((desc.usage & TextureUsage::UnorderedAccess) == 0 || desc.dimension == TextureDimension::Texture3D ||
+			desc.dimension == TextureDimension::Texture1D || desc.dimension == TextureDimension::Texture1DArray ||
+			!isFormatFeatureSupported(m_RenderDevice.context.physicalDevice, textureVk->format,
+				VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+		{
+			LOG_ERROR("generateMips: the compute path needs a 2D texture with UnorderedAccess usage and a filterable storage format");
+			return;
+		}
+		generateMipsWithCompute(textureVk);
+	}
+
+	void CommandListVk::generateMipsWithBlit(TextureVk* texture)
+	{
+		const TextureDesc& desc = texture->desc;
+		const bool is3D = desc.dimension == TextureDimension::Texture3D;
+
+		// the content of mip 0 is kept unless the texture is still Undefined, the other mips are overwritten
+		transitionTextureState(texture, ResourceState::CopyDest);
+		commitBarriers();
+
+		VkImageBlit region{};
+		region.srcSubresource.aspectMask = getVkAspectMask(texture->format);
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = desc.arraySize;
+		region.dstSubresource = region.srcSubresource;
+
+		int32_t width = static_cast<int32_t>(desc.width);
+		int32_t height = static_cast<int32_t>(desc.height);
+		int32_t depth = is3D ? static_cast<int32_t>(desc.depth) : 1;
+		for (uint32_t mip = 1; mip < desc.mipLevels; ++mip)
+		{
+			// the previous mip was just written, read it from now on
+			recordMipBarrier(texture, mip - 1, ResourceState::CopyDest, ResourceState::CopySource);
+
+			region.srcSubresource.mipLevel = mip - 1;
+			region.srcOffsets[1] = { width, height, depth };
+			width = (std::max)(width / 2, 1);
+			height = (std::max)(height / 2, 1);
+			depth = (std::max)(depth / 2, 1);
+			region.dstSubresource.mipLevel = mip;
+			region.dstOffsets[1] = { width, height, depth };
+
+			vkCmdBlitImage(m_CurrentCmdBuf->vkCmdBuf, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+		}
+
+		recordMipBarrier(texture, desc.mipLevels - 1, ResourceState::CopyDest, ResourceState::CopySource);
+		texture->setState(ResourceState::CopySource);
+	}
+
+	void CommandListVk::generateMipsWithCompute(TextureVk* texture)
+	{
+		const TextureDesc& desc = texture->desc;
+		const MipDownsamplePipelineVk& mipDownsample = m_RenderDevice.mipDownsample;
+		auto pipeline = checked_cast<ComputePipelineVk*>(mipDownsample.pipeline.get());
+
+		// the content of mip 0 is kept unless the texture is still Undefined, the other mips are overwritten
+		transitionTextureState(texture, ResourceState::UnorderedAccess);
+		commitBarriers();
+
+		// The mips are bound directly, binding them with setComputeState would transition the whole texture.
+		vkCmdBindPipeline(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+		m_LastComputeState = {};
+
+		auto createMipView = [&](uint32_t mip)
+			{
+				TextureViewDesc viewDesc{};
+				viewDesc.dimension = TextureDimension::Texture2DArray;
+				viewDesc.baseArrayLayer = 0;
+				viewDesc.arrayLayerCount = desc.arraySize;
+				viewDesc.baseMipLevel = mip;
+				viewDesc.mipLevelCount = 1;
+				ITextureView* view = texture->createView(viewDesc);
+				m_CurrentCmdBuf->referencedInternalTextureViews.emplace_back(view);
+				return view;
+			};
+
+		ITextureView* srcView = createMipView(0);
+		uint32_t width = desc.width;
+		uint32_t height = desc.height;
+		for (uint32_t mip = 1; mip < desc.mipLevels; ++mip)
+		{
+			recordMipBarrier(texture, mip - 1, ResourceState::UnorderedAccess, ResourceState::ShaderResource);
+
+			ITextureView* dstView = createMipView(mip);
+			IResourceSet* resourceSet = m_RenderDevice.createResourceSet(mipDownsample.resourceSetLayout.get());
+			m_CurrentCmdBuf->referencedInternalResourceSets.emplace_back(resourceSet);
+			ResourceSetBinding bindings[] =
+			{
+				ResourceSetBinding::TextureWithSampler(srcView, mipDownsample.sampler.get(), 0),
+				ResourceSetBinding::StorageTexture(dstView, 1)
+			};
+			m_RenderDevice.writeResourceSet(resourceSet, bindings, 2);
+
+			uint32_t boundVersion = 0;
+			bindResourceSets(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, &resourceSet, 1, &boundVersion);
+
+			width = (std::max)(width / 2, 1u);
+			height = (std::max)(height / 2, 1u);
+			vkCmdDispatch(m_CurrentCmdBuf->vkCmdBuf, (width + 7) / 8, (height + 7) / 8, desc.arraySize);
+
+			srcView = dstView;
+		}
+
+		recordMipBarrier(texture, desc.mipLevels - 1, ResourceState::UnorderedAccess, ResourceState::ShaderResource);
+		texture->setState(ResourceState::ShaderResource);
+	}
+
 	void CommandListVk::transitionResourceSet(IResourceSet* set, ShaderType dstVisibleStages)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(set);
 		auto resourceSet = checked_cast<ResourceSetVk*>(set);
 
@@ -564,117 +1440,392 @@ namespace rhi
 			{
 				continue;
 			}
+			transitionResourceSetBinding(itemWithVisibleStages.binding);
+		}
+	}
 
-			switch (itemWithVisibleStages.binding.type)
+	void CommandListVk::bindResourceSets(VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+		IResourceSet* const* resourceSets, uint32_t resourceSetCount, uint32_t* boundVersions)
+	{
+		if (resourceSetCount == 0)
+		{
+			return;
+		}
+
+		uint32_t bufferIndices[g_MaxBoundDescriptorSets]{};
+		VkDeviceSize offsets[g_MaxBoundDescriptorSets]{};
+		VkDescriptorSet descriptorSets[g_MaxBoundDescriptorSets]{};
+		for (uint32_t i = 0; i < resourceSetCount; ++i)
+		{
+			assert(resourceSets[i] != nullptr);
+			auto resourceSet = checked_cast<ResourceSetVk*>(resourceSets[i]);
+			offsets[i] = resourceSet->descriptorBufferOffset;
+			descriptorSets[i] = resourceSet->descriptorSet;
+			boundVersions[i] = resourceSet->version;
+			// writes until the submit must not touch this version
+			if (resourceSet->isVersioned())
 			{
-			case ShaderResourceType::TextureWithSampler:
-			case ShaderResourceType::SampledTexture:
+				resourceSet->addReference();
+				m_CurrentCmdBuf->referencedResourceSets.push_back(resourceSet);
+			}
+		}
+
+		if (m_RenderDevice.getDescriptorBuffer())
+		{
+			// every set lives in the one descriptor buffer bound in open()
+			m_RenderDevice.extensionFunctions.cmdSetDescriptorBufferOffsets(m_CurrentCmdBuf->vkCmdBuf, bindPoint, pipelineLayout,
+				0, resourceSetCount, bufferIndices, offsets);
+			return;
+		}
+		vkCmdBindDescriptorSets(m_CurrentCmdBuf->vkCmdBuf, bindPoint, pipelineLayout, 0, resourceSetCount, descriptorSets, 0, nullptr);
+	}
+
+	bool CommandListVk::resourceSetsChanged(IResourceSet* const* resourceSets, uint32_t resourceSetCount,
+		IResourceSet* const* lastResourceSets, uint32_t lastResourceSetCount, const uint32_t* boundVersions)
+	{
+		if (arraysAreDifferent(resourceSets, resourceSetCount, lastResourceSets, lastResourceSetCount))
+		{
+			return true;
+		}
+		// a set written after it was bound moved to a new version
+		for (uint32_t i = 0; i < resourceSetCount; ++i)
+		{
+			if (checked_cast<ResourceSetVk*>(resourceSets[i])->version != boundVersions[i])
 			{
-				assert(itemWithVisibleStages.binding.textureView);
-				auto textureView = checked_cast<TextureViewVk*>(itemWithVisibleStages.binding.textureView);
-				transitionTextureState(textureView->getTexture(), ResourceState::ShaderResource);
-				break;
+				return true;
 			}
-			case ShaderResourceType::StorageTexture:
+		}
+		return false;
+	}
+
+	void CommandListVk::transitionResourceSetBinding(const ResourceSetBinding& binding)
+	{
+		switch (binding.type)
+		{
+		case ShaderResourceType::TextureWithSampler:
+		case ShaderResourceType::SampledTexture:
+		{
+			assert(binding.textureView);
+			auto textureView = checked_cast<TextureViewVk*>(binding.textureView);
+			transitionTextureState(textureView->getTexture(), ResourceState::ShaderResource);
+			break;
+		}
+		case ShaderResourceType::StorageTexture:
+		{
+			assert(binding.textureView);
+			auto textureView = checked_cast<TextureViewVk*>(binding.textureView);
+			transitionTextureState(textureView->getTexture(), ResourceState::UnorderedAccess);
+			break;
+		}
+		case ShaderResourceType::UniformBuffer:
+		{
+			assert(binding.buffer);
+			auto buffer = checked_cast<BufferVk*>(binding.buffer);
+			transitionBufferState(buffer, ResourceState::ShaderResource);
+			break;
+		}
+		case ShaderResourceType::StorageBuffer:
+		{
+			assert(binding.buffer);
+			auto buffer = checked_cast<BufferVk*>(binding.buffer);
+			transitionBufferState(buffer, ResourceState::UnorderedAccess);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	void CommandListVk::transitionResourceSet(IResourceSet* resourceSet)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(resourceSet);
+
+		switch (m_LastPipelineType)
+		{
+		case rhi::CommandListVk::PipelineType::Graphics:
+		{
+			constexpr ShaderType graphicsStages = ShaderType::Vertex | ShaderType::Fragment |
+				ShaderType::Geometry | ShaderType::TessellationControl | ShaderType::TessellationEvaluation;
+			transitionResourceSet(resourceSet, graphicsStages);
+			break;
+		}
+		case rhi::CommandListVk::PipelineType::Compute:
+			transitionResourceSet(resourceSet, ShaderType::Compute);
+			break;
+		case rhi::CommandListVk::PipelineType::Unknown:
+		default:
+			LOG_ERROR("Must set pipelineState before transition resourceSet.");
+			break;
+		}
+	}
+
+	// The implicit render pass that setGraphicsState starts outside of beginRenderPass/endRenderPass.
+	static RenderPassDesc getRenderPassDesc(const GraphicsState& state)
+	{
+		RenderPassDesc desc;
+		desc.colorAttachmentCount = state.renderTargetCount;
+		for (uint32_t i = 0; i < state.renderTargetCount; ++i)
+		{
+			RenderPassColorAttachment& colorAttachment = desc.colorAttachments[i];
+			colorAttachment.view = state.renderTargetViews[i];
+			colorAttachment.loadOp = state.clearRenderTarget ? AttachmentLoadOp::Clear : AttachmentLoadOp::Load;
+		}
+
+		RenderPassDepthStencilAttachment& depthStencilAttachment = desc.depthStencilAttachment;
+		depthStencilAttachment.view = state.depthStencilView;
+		depthStencilAttachment.depthLoadOp = state.clearDepthStencil ? AttachmentLoadOp::Clear : AttachmentLoadOp::Load;
+		depthStencilAttachment.stencilLoadOp = depthStencilAttachment.depthLoadOp;
+		desc.viewMask = state.pipeline->getDesc().viewMask;
+		return desc;
+	}
+
+	static VkAttachmentLoadOp getVkLoadOp(AttachmentLoadOp op, bool loadOpNoneSupported)
+	{
+		if (op == AttachmentLoadOp::None && !loadOpNoneSupported)
+		{
+			return VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+		return convertVkAttachmentLoadOp(op);
+	}
+
+	// Non-integer color formats can only be resolved with Average, integer ones only with SampleZero.
+	static ResolveMode getColorResolveMode(ResolveMode mode, Format format)
+	{
+		FormatComponentType componentType = getFormatInfo(format).componentType;
+		if (componentType == FormatComponentType::Uint || componentType == FormatComponentType::Sint)
+		{
+			if (mode == ResolveMode::Min || mode == ResolveMode::Max)
 			{
-				assert(itemWithVisibleStages.binding.textureView);
-				auto textureView = checked_cast<TextureViewVk*>(itemWithVisibleStages.binding.textureView);
-				transitionTextureState(textureView->getTexture(), ResourceState::UnorderedAccess);
-				break;
+				LOG_ERROR("Integer color attachments can't be resolved with Min or Max, SampleZero is used");
 			}
-			case ShaderResourceType::UniformBuffer:
+			return ResolveMode::SampleZero;
+		}
+		if (mode != ResolveMode::Average)
+		{
+			LOG_ERROR("Color attachments with a non-integer format can only be resolved with Average, Average is used");
+		}
+		return ResolveMode::Average;
+	}
+
+	// SampleZero is supported by every device.
+	static ResolveMode getDepthStencilResolveMode(ResolveMode mode, VkResolveModeFlags supportedModes, const char* aspect)
+	{
+		if (mode == ResolveMode::None || (convertVkResolveMode(mode) & supportedModes) != 0)
+		{
+			return mode;
+		}
+		LOG_ERROR("The device doesn't support the ", aspect, " resolve mode ", uint32_t(mode), ", SampleZero is used");
+		return ResolveMode::SampleZero;
+	}
+
+	static void fillVkDepthStencilResolve(ITextureView* resolveView, ResolveMode mode, VkRenderingAttachmentInfo& attachment)
+	{
+		attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+		attachment.resolveImageView = VK_NULL_HANDLE;
+		if (resolveView != nullptr && mode != ResolveMode::None)
+		{
+			attachment.resolveMode = convertVkResolveMode(mode);
+			attachment.resolveImageView = checked_cast<TextureViewVk*>(resolveView)->imageView;
+			attachment.resolveImageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		}
+	}
+
+	static void fillVkRenderingInfo(const RenderPassDesc& desc, bool loadOpNoneSupported,
+		const VkPhysicalDeviceDepthStencilResolveProperties& resolveProperties, VkRenderingInfo& renderingInfo,
+		std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments>& colorAttachments,
+		VkRenderingAttachmentInfo& depthAttachment, VkRenderingAttachmentInfo& stencilAttachment)
+	{
+		const RenderPassDepthStencilAttachment& depthStencil = desc.depthStencilAttachment;
+		assert(desc.colorAttachmentCount > 0 || depthStencil.view != nullptr);
+		ITextureView* firstView = desc.colorAttachmentCount > 0 ? desc.colorAttachments[0].view : depthStencil.view;
+		auto firstTextureView = checked_cast<TextureViewVk*>(firstView);
+		const TextureDesc& firstTextureDesc = firstTextureView->getTexture()->getDesc();
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent.width = (std::max)(1u, firstTextureDesc.width >> firstTextureView->desc.baseMipLevel);
+		renderingInfo.renderArea.extent.height = (std::max)(1u, firstTextureDesc.height >> firstTextureView->desc.baseMipLevel);
+		renderingInfo.layerCount = 1;
+
+		for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
+		{
+			const RenderPassColorAttachment& attachment = desc.colorAttachments[i];
+			assert(attachment.view != nullptr);
+			auto rtv = checked_cast<TextureViewVk*>(attachment.view);
+			auto& colorAttachment = colorAttachments[i];
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachment.pNext = nullptr;
+			colorAttachment.imageView = rtv->imageView;
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = getVkLoadOp(attachment.loadOp, loadOpNoneSupported);
+			colorAttachment.storeOp = convertVkAttachmentStoreOp(attachment.storeOp);
+			colorAttachment.clearValue.color = convertVkClearColor(attachment.clearColor, rtv->getTexture()->getDesc().format);
+			colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			colorAttachment.resolveImageView = VK_NULL_HANDLE;
+			if (attachment.resolveView != nullptr && attachment.resolveMode != ResolveMode::None)
 			{
-				assert(itemWithVisibleStages.binding.buffer);
-				auto buffer = checked_cast<BufferVk*>(itemWithVisibleStages.binding.buffer);
-				transitionBufferState(buffer, ResourceState::ShaderResource);
-				break;
+				ResolveMode resolveMode = getColorResolveMode(attachment.resolveMode, rtv->getTexture()->getDesc().format);
+				colorAttachment.resolveMode = convertVkResolveMode(resolveMode);
+				colorAttachment.resolveImageView = checked_cast<TextureViewVk*>(attachment.resolveView)->imageView;
+				colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 			}
-			case ShaderResourceType::StorageBuffer:
+		}
+
+		renderingInfo.pDepthAttachment = nullptr;
+		renderingInfo.pStencilAttachment = nullptr;
+		if (depthStencil.view != nullptr)
+		{
+			auto dsv = checked_cast<TextureViewVk*>(depthStencil.view);
+			const FormatInfo& formatInfo = getFormatInfo(dsv->getTexture()->getDesc().format);
+			ResolveMode depthResolveMode = ResolveMode::None;
+			ResolveMode stencilResolveMode = ResolveMode::None;
+			if (depthStencil.resolveView != nullptr)
 			{
-				assert(itemWithVisibleStages.binding.buffer);
-				auto buffer = checked_cast<BufferVk*>(itemWithVisibleStages.binding.buffer);
-				transitionBufferState(buffer, ResourceState::UnorderedAccess);
-				break;
+				if (formatInfo.hasDepth)
+				{
+					depthResolveMode = getDepthStencilResolveMode(depthStencil.depthResolveMode,
+						resolveProperties.supportedDepthResolveModes, "depth");
+				}
+				if (formatInfo.hasStencil)
+				{
+					stencilResolveMode = getDepthStencilResolveMode(depthStencil.stencilResolveMode,
+						resolveProperties.supportedStencilResolveModes, "stencil");
+				}
+				bool oneIsNone = depthResolveMode == ResolveMode::None || stencilResolveMode == ResolveMode::None;
+				if (formatInfo.hasDepth && formatInfo.hasStencil && depthResolveMode != stencilResolveMode &&
+					!resolveProperties.independentResolve && !(oneIsNone && resolveProperties.independentResolveNone))
+				{
+					LOG_ERROR("The device can't resolve depth and stencil with different modes, stencil uses the depth mode");
+					stencilResolveMode = getDepthStencilResolveMode(depthResolveMode, resolveProperties.supportedStencilResolveModes, "stencil");
+					depthResolveMode = stencilResolveMode;
+				}
 			}
-			default:
-				break;
+			if (formatInfo.hasDepth)
+			{
+				depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				depthAttachment.pNext = nullptr;
+				depthAttachment.imageView = dsv->imageView;
+				depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+				depthAttachment.loadOp = getVkLoadOp(depthStencil.depthLoadOp, loadOpNoneSupported);
+				depthAttachment.storeOp = convertVkAttachmentStoreOp(depthStencil.depthStoreOp);
+				depthAttachment.clearValue.depthStencil = { depthStencil.clearDepth, depthStencil.clearStencil };
+				fillVkDepthStencilResolve(depthStencil.resolveView, depthResolveMode, depthAttachment);
+				renderingInfo.pDepthAttachment = &depthAttachment;
+			}
+			if (formatInfo.hasStencil)
+			{
+				stencilAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				stencilAttachment.pNext = nullptr;
+				stencilAttachment.imageView = dsv->imageView;
+				stencilAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+				stencilAttachment.loadOp = getVkLoadOp(depthStencil.stencilLoadOp, loadOpNoneSupported);
+				stencilAttachment.storeOp = convertVkAttachmentStoreOp(depthStencil.stencilStoreOp);
+				stencilAttachment.clearValue.depthStencil = { depthStencil.clearDepth, depthStencil.clearStencil };
+				fillVkDepthStencilResolve(depthStencil.resolveView, stencilResolveMode, stencilAttachment);
+				renderingInfo.pStencilAttachment = &stencilAttachment;
+			}
+		}
+
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.pNext = nullptr;
+		renderingInfo.colorAttachmentCount = desc.colorAttachmentCount;
+		renderingInfo.pColorAttachments = colorAttachments.data();
+		renderingInfo.viewMask = desc.viewMask;
+	}
+
+	void CommandListVk::beginRendering(bool resume)
+	{
+		assert(!m_RenderingStarted);
+		RenderPassDesc desc = m_RenderPassDesc;
+		if (resume)
+		{
+			// A resumed rendering section has to keep what the previous section of the pass rendered.
+			RenderPassDepthStencilAttachment& depthStencil = desc.depthStencilAttachment;
+			bool contentLost = m_InRenderPass && depthStencil.view != nullptr &&
+				(depthStencil.depthStoreOp != AttachmentStoreOp::Store || depthStencil.stencilStoreOp != AttachmentStoreOp::Store);
+			depthStencil.depthLoadOp = AttachmentLoadOp::Load;
+			depthStencil.stencilLoadOp = AttachmentLoadOp::Load;
+			for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
+			{
+				contentLost = contentLost || (m_InRenderPass && desc.colorAttachments[i].storeOp != AttachmentStoreOp::Store);
+				desc.colorAttachments[i].loadOp = AttachmentLoadOp::Load;
+			}
+			if (contentLost)
+			{
+				LOG_WARNING("The render pass was split by barriers, attachments not using AttachmentStoreOp::Store lose their content.");
 			}
 		}
+		flushUnfoldablePendingClears(desc);
+		foldPendingClears(desc);
+
+		std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
+		VkRenderingAttachmentInfo depthAttachment{};
+		VkRenderingAttachmentInfo stencilAttachment{};
+
+		VkRenderingInfo renderingInfo{};
+		fillVkRenderingInfo(desc, m_RenderDevice.optionalExtensions.loadStoreOpNone, m_RenderDevice.getDepthStencilResolveProperties(),
+			renderingInfo, colorAttachments, depthAttachment, stencilAttachment);
+
+		vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
+		m_RenderingStarted = true;
 	}
 
-	void CommandListVk::transitionResourceSet(IResourceSet* resourceSet)
+	bool CommandListVk::hasPendingBarriers() const
 	{
-		assert(resourceSet);
-
-		switch (m_LastPipelineType)
-		{
-		case rhi::CommandListVk::PipelineType::Graphics:
-		{
-			constexpr ShaderType graphicsStages = ShaderType::Vertex | ShaderType::Fragment |
-				ShaderType::Geometry | ShaderType::TessellationControl | ShaderType::TessellationEvaluation;
-			transitionResourceSet(resourceSet, graphicsStages);
-			break;
-		}
-		case rhi::CommandListVk::PipelineType::Compute:
-			transitionResourceSet(resourceSet, ShaderType::Compute);
-			break;
-		case rhi::CommandListVk::PipelineType::Unknown:
-		default:
-			LOG_ERROR("Must set pipelineState before transition resourceSet.");
-			break;
-		}
+		return !m_TextureBarriers.empty() || !m_BufferBarriers.empty() || m_HasGlobalBarrier;
 	}
 
-	static inline void fillVkRenderingInfo(const GraphicsState& state, VkRenderingInfo& renderingInfo,
-		std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments>& colorAttachments, 
-		VkRenderingAttachmentInfo& depthStencilAttachment)
+	void CommandListVk::beginRenderPass(const RenderPassDesc& desc)
 	{
-		if (state.renderTargetCount > 0)
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(m_CurrentCmdBuf);
+		ASSERT_MSG(!m_InRenderPass, "beginRenderPass must not be nested.");
+		ASSERT_MSG(desc.viewMask == 0 || m_RenderDevice.optionalFeatures.multiview, "A viewMask needs RenderDeviceCreateInfo::enableMultiview.");
+
+		assert(desc.colorAttachmentCount > 0 || desc.depthStencilAttachment.view != nullptr);
+		for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
 		{
-			auto rtv = checked_cast<TextureViewVk*>(state.renderTargetViews[0]);
-			auto texture = checked_cast<TextureVk*>(rtv->getTexture());
-			renderingInfo.renderArea.extent = { texture->getDesc().width , texture->getDesc().height };
+			assert(desc.colorAttachments[i].view != nullptr);
+			transitionTextureState(desc.colorAttachments[i].view->getTexture(), ResourceState::RenderTarget);
 		}
-		else
+		if (desc.depthStencilAttachment.view)
 		{
-			auto dsv = checked_cast<TextureViewVk*>(state.depthStencilView);
-			auto texture = checked_cast<TextureVk*>(dsv->getTexture());
-			renderingInfo.renderArea.extent = { texture->getDesc().width , texture->getDesc().height };
+			transitionTextureState(desc.depthStencilAttachment.view->getTexture(), ResourceState::DepthWrite);
 		}
-		renderingInfo.layerCount = 1;
-
-		for (uint32_t i = 0; i < state.renderTargetCount; ++i)
+		// Resolves are attachment writes. A clear pending on a resolve target can't be folded into the pass,
+		// it must land before the resolve overwrites it.
+		for (uint32_t i = 0; i < desc.colorAttachmentCount; ++i)
 		{
-			auto rtv = checked_cast<TextureViewVk*>(state.renderTargetViews[i]);
-			auto& colorAttachment = colorAttachments[i];
-			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-			colorAttachment.pNext = nullptr;
-			colorAttachment.imageView = rtv->imageView;
-			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			colorAttachment.loadOp = state.clearRenderTarget ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachment.clearValue = { 0.0f, 0.0f, 0.f, 0.0f };
+			if (ITextureView* resolveView = desc.colorAttachments[i].resolveView)
+			{
+				flushPendingClears(resolveView->getTexture());
+				transitionTextureState(resolveView->getTexture(), ResourceState::RenderTarget);
+			}
+		}
+		if (ITextureView* resolveView = desc.depthStencilAttachment.resolveView)
+		{
+			flushPendingClears(resolveView->getTexture());
+			transitionTextureState(resolveView->getTexture(), ResourceState::DepthWrite);
 		}
+		endRendering();
+		commitBarriers();
 
-		depthStencilAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-		depthStencilAttachment.pNext = nullptr;
-		depthStencilAttachment.imageView = checked_cast<TextureViewVk*>(state.depthStencilView)->imageView;
-		depthStencilAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		depthStencilAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthStencilAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthStencilAttachment.clearValue.depthStencil = { 1.0f,  0 };
+		m_RenderPassDesc = desc;
+		m_InRenderPass = true;
+		beginRendering(false);
+	}
 
-		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
-		renderingInfo.pNext = nullptr;
-		renderingInfo.colorAttachmentCount = state.renderTargetCount;
-		renderingInfo.pColorAttachments = colorAttachments.data();
-		renderingInfo.pDepthAttachment = &depthStencilAttachment;
-		renderingInfo.pStencilAttachment = &depthStencilAttachment;
-		renderingInfo.viewMask = 0;
+	void CommandListVk::endRenderPass()
+	{
+		assert(m_CurrentCmdBuf);
+		ASSERT_MSG(m_InRenderPass, "endRenderPass without beginRenderPass.");
+
+		endRendering();
+		m_InRenderPass = false;
 	}
 
 	void CommandListVk::setGraphicsState(const GraphicsState& state)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(m_CurrentCmdBuf);
 
 		constexpr ShaderType graphicsStages = ShaderType::Vertex | ShaderType::Fragment |
@@ -701,6 +1852,11 @@ namespace rhi
 						m_CurrentCmdBuf->referencedHostVisibleBuffer.push_back(buffer);
 					}
 				}
+				else if (itemWithVisibleStages.binding.textureView && !m_PendingClears.empty())
+				{
+					// without auto transition no transition flushed the clears of the texture
+					flushPendingClears(itemWithVisibleStages.binding.textureView->getTexture());
+				}
 			}
 		}
 
@@ -750,32 +1906,41 @@ namespace rhi
 			}
 		}
 
-		assert(state.renderTargetCount > 0 || state.depthStencilView != nullptr);
-		for (uint32_t i = 0; i < state.renderTargetCount; ++i)
+		assert(state.pipeline != nullptr);
+		if (m_InRenderPass)
 		{
-			assert(state.renderTargetViews[i] != nullptr);
-			auto rtv = checked_cast<TextureViewVk*>(state.renderTargetViews[i]);
-			transitionTextureState(rtv->getTexture(), ResourceState::RenderTarget);
+			ASSERT_MSG(state.pipeline->getDesc().viewMask == m_RenderPassDesc.viewMask,
+				"The viewMask of the pipeline must match the one of the render pass.");
+			// The attachments belong to the render pass. Barriers must not be placed within a render section,
+			// so pending ones end it here and the next draw resumes the pass.
+			if (hasPendingBarriers())
+			{
+				commitBarriers();
+			}
 		}
-		if (state.depthStencilView)
+		else
 		{
-			auto dsv = checked_cast<TextureViewVk*>(state.depthStencilView);
-			transitionTextureState(dsv->getTexture(), ResourceState::DepthWrite);
-		}
-		// Because once the graphics state is set, the render target is always changed. 
-		// and Barrier must not be placed within a render section started with vkCmdBeginRendering
-		endRendering();
-		commitBarriers();
-
-		std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
-		VkRenderingAttachmentInfo depthAttachment{};
-
-		VkRenderingInfo renderingInfo{};
-		fillVkRenderingInfo(state, renderingInfo, colorAttachments, depthAttachment);
+			assert(state.renderTargetCount > 0 || state.depthStencilView != nullptr);
+			for (uint32_t i = 0; i < state.renderTargetCount; ++i)
+			{
+				assert(state.renderTargetViews[i] != nullptr);
+				auto rtv = checked_cast<TextureViewVk*>(state.renderTargetViews[i]);
+				transitionTextureState(rtv->getTexture(), ResourceState::RenderTarget);
+			}
+			if (state.depthStencilView)
+			{
+				auto dsv = checked_cast<TextureViewVk*>(state.depthStencilView);
+				transitionTextureState(dsv->getTexture(), ResourceState::DepthWrite);
+			}
+			// Because once the graphics state is set, the render target is always changed. 
+			// and Barrier must not be placed within a render section started with vkCmdBeginRendering
+			endRendering();
+			commitBarriers();
 
-		// Start a dynamic rendering section
-		vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
-		m_RenderingStarted = true;
+			// Start a dynamic rendering section
+			m_RenderPassDesc = getRenderPassDesc(state);
+			beginRendering(false);
+		}
 
 		if (arraysAreDifferent(state.vertexBuffers, state.vertexBufferCount,
 			m_LastGraphicsState.vertexBuffers, m_LastGraphicsState.vertexBufferCount))
@@ -827,22 +1992,18 @@ namespace rhi
 		assert(state.pipeline != nullptr);
 		GraphicsPipelineVk* pipeline = checked_cast<GraphicsPipelineVk*>(state.pipeline);
 
-		if (arraysAreDifferent(state.resourceSets, state.resourceSetCount,
-			m_LastGraphicsState.resourceSets, m_LastGraphicsState.resourceSetCount))
+		if (resourceSetsChanged(state.resourceSets, state.resourceSetCount,
+			m_LastGraphicsState.resourceSets, m_LastGraphicsState.resourceSetCount, m_LastGraphicsSetVersions))
 		{
-			VkDescriptorSet descriptorSets[g_MaxBoundDescriptorSets]{};
-			for (uint32_t i = 0; i < state.resourceSetCount; ++i)
-			{
-				assert(state.resourceSets[i] != nullptr);
-				auto resourceSet = checked_cast<ResourceSetVk*>(state.resourceSets[i]);
-				descriptorSets[i] = resourceSet->descriptorSet;
-			} 
-			vkCmdBindDescriptorSets(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipelineLayout, 0, state.resourceSetCount, descriptorSets, 0, nullptr);
+			bindResourceSets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipelineLayout, state.resourceSets, state.resourceSetCount,
+				m_LastGraphicsSetVersions);
 		}
 
 		if (state.pipeline != m_LastGraphicsState.pipeline)
 		{
-			vkCmdBindPipeline(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+			vkCmdBindPipeline(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
+			// states baked into the pipeline overwrite what was set dynamically
+			m_DynamicStates.valid = m_DynamicStates.valid & pipeline->desc.dynamicStates;
 		}
 
 		m_LastPipelineType = PipelineType::Graphics;
@@ -866,6 +2027,159 @@ namespace rhi
 		vkCmdSetScissor(m_CurrentCmdBuf->vkCmdBuf, 0, scissorCount, rects);
 	}
 
+	template<typename T>
+	bool CommandListVk::updateDynamicState(DynamicState state, T& cachedValue, T value)
+	{
+		assert(m_CurrentCmdBuf);
+		if ((m_DynamicStates.valid & state) != 0 && cachedValue == value)
+		{
+			return false;
+		}
+		cachedValue = value;
+		m_DynamicStates.valid = m_DynamicStates.valid | state;
+		return true;
+	}
+
+	void CommandListVk::setCullMode(CullMode cullMode)
+	{
+		if (updateDynamicState(DynamicState::CullMode, m_DynamicStates.cullMode, cullMode))
+		{
+			vkCmdSetCullMode(m_CurrentCmdBuf->vkCmdBuf, convertCullMode(cullMode));
+		}
+	}
+
+	void CommandListVk::setFrontFace(bool frontCounterClockwise)
+	{
+		if (updateDynamicState(DynamicState::FrontFace, m_DynamicStates.frontCounterClockwise, frontCounterClockwise))
+		{
+			vkCmdSetFrontFace(m_CurrentCmdBuf->vkCmdBuf, frontCounterClockwise ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE);
+		}
+	}
+
+	void CommandListVk::setPrimitiveType(PrimitiveType primType)
+	{
+		if (updateDynamicState(DynamicState::PrimitiveTopology, m_DynamicStates.primType, primType))
+		{
+			vkCmdSetPrimitiveTopology(m_CurrentCmdBuf->vkCmdBuf, convertPrimitiveTopology(primType));
+		}
+	}
+
+	void CommandListVk::setDepthTestEnable(bool enable)
+	{
+		if (updateDynamicState(DynamicState::DepthTestEnable, m_DynamicStates.depthTestEnable, enable))
+		{
+			vkCmdSetDepthTestEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
+	void CommandListVk::setDepthWriteEnable(bool enable)
+	{
+		if (updateDynamicState(DynamicState::DepthWriteEnable, m_DynamicStates.depthWriteEnable, enable))
+		{
+			vkCmdSetDepthWriteEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
+	void CommandListVk::setDepthCompareOp(CompareOp op)
+	{
+		if (updateDynamicState(DynamicState::DepthCompareOp, m_DynamicStates.depthCompareOp, op))
+		{
+			vkCmdSetDepthCompareOp(m_CurrentCmdBuf->vkCmdBuf, convertCompareOp(op));
+		}
+	}
+
+	void CommandListVk::setStencilTestEnable(bool enable)
+	{
+		if (updateDynamicState(DynamicState::StencilTestEnable, m_DynamicStates.stencilTestEnable, enable))
+		{
+			vkCmdSetStencilTestEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
+	static bool stencilOpsAreEqual(const StencilOpState& a, const StencilOpState& b)
+	{
+		return a.failOp == b.failOp &&
+			a.passOp == b.passOp &&
+			a.depthFailOp == b.depthFailOp &&
+			a.compareOp == b.compareOp;
+	}
+
+	void CommandListVk::setStencilOp(const StencilOpState& frontFace, const StencilOpState& backFace)
+	{
+		assert(m_CurrentCmdBuf);
+		const bool valid = (m_DynamicStates.valid & DynamicState::StencilOp) != 0;
+		const bool frontChanged = !valid || !stencilOpsAreEqual(frontFace, m_DynamicStates.frontFaceStencil);
+		const bool backChanged = !valid || !stencilOpsAreEqual(backFace, m_DynamicStates.backFaceStencil);
+
+		auto setStencilOp = [this](VkStencilFaceFlags faceMask, const StencilOpState& state)
+			{
+				VkStencilOpState vkState = convertStencilOpState(state);
+				vkCmdSetStencilOp(m_CurrentCmdBuf->vkCmdBuf, faceMask, vkState.failOp, vkState.passOp, vkState.depthFailOp, vkState.compareOp);
+			};
+
+		if (frontChanged && backChanged && stencilOpsAreEqual(frontFace, backFace))
+		{
+			setStencilOp(VK_STENCIL_FACE_FRONT_AND_BACK, frontFace);
+		}
+		else
+		{
+			if (frontChanged)
+			{
+				setStencilOp(VK_STENCIL_FACE_FRONT_BIT, frontFace);
+			}
+			if (backChanged)
+			{
+				setStencilOp(VK_STENCIL_FACE_BACK_BIT, backFace);
+			}
+		}
+
+		m_DynamicStates.frontFaceStencil = frontFace;
+		m_DynamicStates.backFaceStencil = backFace;
+		m_DynamicStates.valid = m_DynamicStates.valid | DynamicState::StencilOp;
+	}
+
+	void CommandListVk::setDepthBiasEnable(bool enable)
+	{
+		if (updateDynamicState(DynamicState::DepthBiasEnable, m_DynamicStates.depthBiasEnable, enable))
+		{
+			vkCmdSetDepthBiasEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
+	void CommandListVk::setPrimitiveRestartEnable(bool enable)
+	{
+		if (updateDynamicState(DynamicState::PrimitiveRestartEnable, m_DynamicStates.primitiveRestartEnable, enable))
+		{
+			vkCmdSetPrimitiveRestartEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
+	void CommandListVk::setPolygonMode(PolygonMode mode)
+	{
+		if (!m_RenderDevice.optionalExtensions.extendedDynamicState3)
+		{
+			LOG_ERROR("Dynamic PolygonMode needs VK_EXT_extended_dynamic_state3");
+			return;
+		}
+		if (updateDynamicState(DynamicState::PolygonMode, m_DynamicStates.polygonMode, mode))
+		{
+			m_RenderDevice.extensionFunctions.cmdSetPolygonMode(m_CurrentCmdBuf->vkCmdBuf, convertPolygonMode(mode));
+		}
+	}
+
+	void CommandListVk::setDepthClampEnable(bool enable)
+	{
+		if (!m_RenderDevice.optionalExtensions.extendedDynamicState3)
+		{
+			LOG_ERROR("Dynamic DepthClampEnable needs VK_EXT_extended_dynamic_state3");
+			return;
+		}
+		if (updateDynamicState(DynamicState::DepthClampEnable, m_DynamicStates.depthClampEnable, enable))
+		{
+			m_RenderDevice.extensionFunctions.cmdSetDepthClampEnable(m_CurrentCmdBuf->vkCmdBuf, enable);
+		}
+	}
+
 	void CommandListVk::setPushConstant(ShaderType stages, const void* data)
 	{
 		assert(m_CurrentCmdBuf);
@@ -899,18 +2213,130 @@ namespace rhi
 		}
 	}
 
+	void CommandListVk::pushResourceSet(uint32_t setIndex, const ResourceSetBinding* bindings, uint32_t bindingCount)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		assert(m_CurrentCmdBuf);
+		assert(bindings != nullptr && bindingCount != 0);
+
+		VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		uint32_t pushDescriptorSetIndex = UINT32_MAX;
+		uint32_t boundSetCount = 0;
+		switch (m_LastPipelineType)
+		{
+		case PipelineType::Graphics:
+		{
+			auto pipeline = checked_cast<GraphicsPipelineVk*>(m_LastGraphicsState.pipeline);
+			pipelineLayout = pipeline->pipelineLayout;
+			pushDescriptorSetIndex = pipeline->pushDescriptorSetIndex;
+			boundSetCount = m_LastGraphicsState.resourceSetCount;
+			break;
+		}
+		case PipelineType::Compute:
+		{
+			auto pipeline = checked_cast<ComputePipelineVk*>(m_LastComputeState.pipeline);
+			bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+			pipelineLayout = pipeline->pipelineLayout;
+			pushDescriptorSetIndex = pipeline->pushDescriptorSetIndex;
+			boundSetCount = m_LastComputeState.resourceSetCount;
+			break;
+		}
+		default:
+			LOG_ERROR("Must set pipelineState before pushResourceSet.");
+			return;
+		}
+		ASSERT_MSG(setIndex == pushDescriptorSetIndex, "The layout at setIndex of the bound pipeline isn't a PushDescriptor layout.");
+		ASSERT_MSG(boundSetCount <= setIndex, "The push descriptor set overlaps a resource set bound by the state.");
+
+		for (uint32_t i = 0; i < bindingCount; ++i)
+		{
+			if (m_EnableAutoTransition)
+			{
+				transitionResourceSetBinding(bindings[i]);
+			}
+			else if (bindings[i].textureView)
+			{
+				flushPendingClears(bindings[i].textureView->getTexture());
+			}
+			if (bindings[i].buffer)
+			{
+				auto buffer = checked_cast<BufferVk*>(bindings[i].buffer);
+				if (buffer->desc.access != BufferAccess::GpuOnly)
+				{
+					m_CurrentCmdBuf->referencedHostVisibleBuffer.push_back(buffer);
+				}
+			}
+		}
+		// Barriers must not be placed within a render section, the next draw resumes the pass.
+		if (hasPendingBarriers())
+		{
+			commitBarriers();
+		}
+
+		m_PushDescriptorWrites.resize(bindingCount);
+		m_PushDescriptorImageInfos.resize(bindingCount);
+		m_PushDescriptorBufferInfos.resize(bindingCount);
+		for (uint32_t i = 0; i < bindingCount; ++i)
+		{
+			const ResourceSetBinding& binding = bindings[i];
+			VkWriteDescriptorSet& write = m_PushDescriptorWrites[i];
+			write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstBinding = binding.bindingSlot;
+			write.dstArrayElement = binding.arrayElementIndex;
+			write.descriptorCount = 1;
+			write.descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
+
+			VkDescriptorImageInfo& imageInfo = m_PushDescriptorImageInfos[i];
+			imageInfo = {};
+			VkDescriptorBufferInfo& bufferInfo = m_PushDescriptorBufferInfos[i];
+			bufferInfo = {};
+			switch (binding.type)
+			{
+			case ShaderResourceType::SampledTexture:
+			case ShaderResourceType::StorageTexture:
+			case ShaderResourceType::TextureWithSampler:
+				assert(binding.textureView != nullptr);
+				imageInfo.imageView = checked_cast<TextureViewVk*>(binding.textureView)->imageView;
+				imageInfo.imageLayout = binding.type == ShaderResourceType::StorageTexture ?
+					VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				if (binding.type == ShaderResourceType::TextureWithSampler)
+				{
+					assert(binding.sampler != nullptr);
+					imageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+				}
+				write.pImageInfo = &imageInfo;
+				break;
+			case ShaderResourceType::Sampler:
+				assert(binding.sampler != nullptr);
+				imageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+				write.pImageInfo = &imageInfo;
+				break;
+			case ShaderResourceType::UniformBuffer:
+			case ShaderResourceType::StorageBuffer:
+				assert(binding.buffer != nullptr);
+				bufferInfo.buffer = checked_cast<BufferVk*>(binding.buffer)->buffer;
+				bufferInfo.offset = binding.bufferOffset;
+				bufferInfo.range = binding.bufferRange == 0 ? VK_WHOLE_SIZE : binding.bufferRange;
+				write.pBufferInfo = &bufferInfo;
+				break;
+			default:
+				assert(!"invalid ShaderResourceType");
+				break;
+			}
+		}
+
+		m_RenderDevice.extensionFunctions.cmdPushDescriptorSet(m_CurrentCmdBuf->vkCmdBuf, bindPoint, pipelineLayout, setIndex,
+			bindingCount, m_PushDescriptorWrites.data());
+	}
+
 	void CommandListVk::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
 	{
 		assert(m_CurrentCmdBuf);
 		if (!m_RenderingStarted)
 		{
-			std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
-			VkRenderingAttachmentInfo depthAttachment{};
-
-			VkRenderingInfo renderingInfo{};
-			fillVkRenderingInfo(m_LastGraphicsState, renderingInfo, colorAttachments, depthAttachment);
-			vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
-			m_RenderingStarted = true;
+			beginRendering(true);
 		}
 
 		vkCmdDraw(m_CurrentCmdBuf->vkCmdBuf, vertexCount, instanceCount, firstVertex, firstInstance);
@@ -921,13 +2347,7 @@ namespace rhi
 		assert(m_CurrentCmdBuf);
 		if (!m_RenderingStarted)
 		{
-			std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
-			VkRenderingAttachmentInfo depthAttachment{};
-
-			VkRenderingInfo renderingInfo{};
-			fillVkRenderingInfo(m_LastGraphicsState, renderingInfo, colorAttachments, depthAttachment);
-			vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
-			m_RenderingStarted = true;
+			beginRendering(true);
 		}
 
 		vkCmdDrawIndexed(m_CurrentCmdBuf->vkCmdBuf, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
@@ -938,13 +2358,7 @@ namespace rhi
 		assert(m_CurrentCmdBuf);
 		if (!m_RenderingStarted)
 		{
-			std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
-			VkRenderingAttachmentInfo depthAttachment{};
-
-			VkRenderingInfo renderingInfo{};
-			fillVkRenderingInfo(m_LastGraphicsState, renderingInfo, colorAttachments, depthAttachment);
-			vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
-			m_RenderingStarted = true;
+			beginRendering(true);
 		}
 		auto indiectBuffer = checked_cast<BufferVk*>(m_LastGraphicsState.indirectBuffer);
 		assert(indiectBuffer != nullptr);
@@ -956,21 +2370,85 @@ namespace rhi
 		assert(m_CurrentCmdBuf);
 		if (!m_RenderingStarted)
 		{
-			std::array<VkRenderingAttachmentInfo, g_MaxColorAttachments> colorAttachments{};
-			VkRenderingAttachmentInfo depthAttachment{};
-
-			VkRenderingInfo renderingInfo{};
-			fillVkRenderingInfo(m_LastGraphicsState, renderingInfo, colorAttachments, depthAttachment);
-			vkCmdBeginRendering(m_CurrentCmdBuf->vkCmdBuf, &renderingInfo);
-			m_RenderingStarted = true;
+			beginRendering(true);
 		}
 		auto indiectBuffer = checked_cast<BufferVk*>(m_LastGraphicsState.indirectBuffer);
 		assert(indiectBuffer != nullptr);
 		vkCmdDrawIndexedIndirect(m_CurrentCmdBuf->vkCmdBuf, indiectBuffer->buffer, offset, drawCount, sizeof(DrawIndexedIndirectCommand));
 	}
 
+	void CommandListVk::prepareIndirectCountDraw(BufferVk* argumentBuffer, uint64_t argumentOffset, uint64_t argumentSize,
+		BufferVk* countBuffer, uint64_t countOffset)
+	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
+		if (m_EnableAutoTransition)
+		{
+			// maxDrawCount is only an upper bound, the arguments may end before it.
+			argumentSize = (std::min)(argumentSize, uint64_t(argumentBuffer->desc.size) - argumentOffset);
+			transitionBufferState(argumentBuffer, ResourceState::IndirectBuffer, argumentOffset, argumentSize);
+			transitionBufferState(countBuffer, ResourceState::IndirectBuffer, countOffset, sizeof(uint32_t));
+		}
+		// Barrier must not be placed within a render section, the draw resumes it afterwards.
+		if (hasPendingBarriers())
+		{
+			commitBarriers();
+		}
+		if (!m_RenderingStarted)
+		{
+			beginRendering(true);
+		}
+
+		if (argumentBuffer->desc.access != BufferAccess::GpuOnly)
+		{
+			m_CurrentCmdBuf->referencedHostVisibleBuffer.push_back(argumentBuffer);
+		}
+		if (countBuffer->desc.access != BufferAccess::GpuOnly)
+		{
+			m_CurrentCmdBuf->referencedHostVisibleBuffer.push_back(countBuffer);
+		}
+	}
+
+	void CommandListVk::drawIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+		IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount)
+	{
+		assert(m_CurrentCmdBuf);
+		assert(argumentBuffer != nullptr && countBuffer != nullptr);
+		if (!m_RenderDevice.optionalFeatures.drawIndirectCount)
+		{
+			LOG_ERROR("drawIndirectCount is not supported by the device");
+			return;
+		}
+		auto argumentBufferVk = checked_cast<BufferVk*>(argumentBuffer);
+		auto countBufferVk = checked_cast<BufferVk*>(countBuffer);
+		prepareIndirectCountDraw(argumentBufferVk, argumentOffset, uint64_t(maxDrawCount) * sizeof(DrawIndirectCommand),
+			countBufferVk, countOffset);
+
+		vkCmdDrawIndirectCount(m_CurrentCmdBuf->vkCmdBuf, argumentBufferVk->buffer, argumentOffset,
+			countBufferVk->buffer, countOffset, maxDrawCount, sizeof(DrawIndirectCommand));
+	}
+
+	void CommandListVk::drawIndexedIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+		IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount)
+	{
+		assert(m_CurrentCmdBuf);
+		assert(argumentBuffer != nullptr && countBuffer != nullptr);
+		if (!m_RenderDevice.optionalFeatures.drawIndirectCount)
+		{
+			LOG_ERROR("drawIndexedIndirectCount is not supported by the device");
+			return;
+		}
+		auto argumentBufferVk = checked_cast<BufferVk*>(argumentBuffer);
+		auto countBufferVk = checked_cast<BufferVk*>(countBuffer);
+		prepareIndirectCountDraw(argumentBufferVk, argumentOffset, uint64_t(maxDrawCount) * sizeof(DrawIndexedIndirectCommand),
+			countBufferVk, countOffset);
+
+		vkCmdDrawIndexedIndirectCount(m_CurrentCmdBuf->vkCmdBuf, argumentBufferVk->buffer, argumentOffset,
+			countBufferVk->buffer, countOffset, maxDrawCount, sizeof(DrawIndexedIndirectCommand));
+	}
+
 	void CommandListVk::setComputeState(const ComputeState& state)
 	{
+		BarrierRequesterScope requesterScope(m_BarrierRequester, __FUNCTION__);
 		assert(m_CurrentCmdBuf);
 		endRendering();
 
@@ -996,6 +2474,11 @@ namespace rhi
 						m_CurrentCmdBuf->referencedHostVisibleBuffer.push_back(buffer);
 					}
 				}
+				else if (itemWithVisibleStages.binding.textureView && !m_PendingClears.empty())
+				{
+					// without auto transition no transition flushed the clears of the texture
+					flushPendingClears(itemWithVisibleStages.binding.textureView->getTexture());
+				}
 			}
 		}
 
@@ -1020,17 +2503,11 @@ namespace rhi
 			vkCmdBindPipeline(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
 		}
 
-		if (arraysAreDifferent(state.resourceSets, state.resourceSetCount,
-			m_LastComputeState.resourceSets, m_LastComputeState.resourceSetCount))
+		if (resourceSetsChanged(state.resourceSets, state.resourceSetCount,
+			m_LastComputeState.resourceSets, m_LastComputeState.resourceSetCount, m_LastComputeSetVersions))
 		{
-			VkDescriptorSet descriptorSets[g_MaxBoundDescriptorSets]{};
-			for (uint32_t i = 0; i < state.resourceSetCount; ++i)
-			{
-				assert(state.resourceSets[i] != nullptr);
-				auto resourceSet = checked_cast<ResourceSetVk*>(state.resourceSets[i]);
-				descriptorSets[i] = resourceSet->descriptorSet;
-			}
-			vkCmdBindDescriptorSets(m_CurrentCmdBuf->vkCmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 0, state.resourceSetCount, descriptorSets, 0, nullptr);
+			bindResourceSets(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, state.resourceSets, state.resourceSetCount,
+				m_LastComputeSetVersions);
 		}
 
 		m_LastPipelineType = PipelineType::Compute;
@@ -11,7 +11,10 @@ namespace rhi
 {
 	class RenderDeviceVk;
 	class TextureVk;
+	class TextureViewVk;
 	class BufferVk;
+	class ResourceSetVk;
+	struct BufferRangeState;
 	struct ContextVk;
 	struct TextureUpdateInfo;
 
@@ -24,16 +27,51 @@ namespace rhi
 		~CommandBuffer();
 		void updateLastUsedExecuteID(uint64_t excuteID);
 		void resetLastUsedExecuteID();
+		// Submitting clears referencedResourceSets, so this only affects a recording that wasn't submitted.
+		void releaseUnsubmittedReferences();
 		VkCommandBuffer vkCmdBuf{ VK_NULL_HANDLE };
 		VkCommandPool vkCmdPool{ VK_NULL_HANDLE };
 
 		std::vector<std::unique_ptr<BufferVk>> referencedInternalStageBuffer;
+		// Per mip views and sets of generateMips, the sets are released before the views they were written with.
+		std::vector<std::unique_ptr<IResourceSet>> referencedInternalResourceSets;
+		std::vector<std::unique_ptr<ITextureView>> referencedInternalTextureViews;
 		std::vector<BufferVk*> referencedHostVisibleBuffer;
+		// Pool backed sets bound since the last submit, see ResourceSetVk::pendingReferenceCount.
+		std::vector<ResourceSetVk*> referencedResourceSets;
+		std::vector<VkEvent> referencedEvents;
 		uint64_t submitID = 0;
 	private:
 		const ContextVk& m_Context;
 	};
 
+	// Small open-addressing map from a resource pointer to an index into a pending barrier list.
+	// Sized for a typical barrier batch and cleared on every commit, so lookups stay O(1)
+	// when hundreds of resources are transitioned before a single vkCmdPipelineBarrier2.
+	class ResourceIndexMap
+	{
+	public:
+		static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+		explicit ResourceIndexMap(uint32_t initialCapacity = 64);
+		uint32_t find(const void* resource) const;
+		// Returns the existing index if the resource is already present.
+		uint32_t insert(const void* resource, uint32_t index);
+		void clear();
+		uint32_t size() const { return m_Count; }
+	private:
+		struct Slot
+		{
+			const void* resource = nullptr;
+			uint32_t index = InvalidIndex;
+		};
+		uint32_t probe(const void* resource) const;
+		void grow();
+
+		std::vector<Slot> m_Slots;
+		uint32_t m_Count = 0;
+	};
+
 	class CommandListVk final : public ICommandList
 	{
 	public:
@@ -45,26 +83,60 @@ namespace rhi
 		void close() override;
 
 		void setResourceAutoTransition(bool enable) override;
+		bool getResourceAutoTransition() const override { return m_EnableAutoTransition; }
+		void setGlobalMemoryBarriers(bool enable) override;
 		void commitBarriers() override;
 		void transitionTextureState(ITexture* texture, ResourceState newState) override;
 		void transitionBufferState(IBuffer* buffer, ResourceState newState) override;
+		void transitionBufferState(IBuffer* buffer, ResourceState newState, uint64_t offset, uint64_t size) override;
 		void transitionResourceSet(IResourceSet* resourceSet) override;
+		void beginTextureTransition(ITexture* texture, ResourceState newState) override;
+		void endTextureTransition(ITexture* texture) override;
+		void beginBufferTransition(IBuffer* buffer, ResourceState newState) override;
+		void endBufferTransition(IBuffer* buffer) override;
+		void uavBarrier() override;
+		const BarrierStatistics& getBarrierStatistics() const override { return m_BarrierStatistics; }
+		void setBarrierAnalysis(bool enable) override;
 
 		void clearColorTexture(ITextureView* textureView, const ClearColor& color) override;
 		void clearDepthStencil(ITextureView* textureView, ClearDepthStencilFlag flag, float depthVal, uint8_t stencilVal) override;
+		const ClearStatistics& getClearStatistics() const override { return m_ClearStatistics; }
 		void updateBuffer(IBuffer* buffer, const void* data, uint64_t dataSize, uint64_t offset) override;
 		void copyBuffer(IBuffer* srcBuffer, uint64_t srcOffset, IBuffer* dstBuffer, uint64_t dstOffset, uint64_t dataSize) override;
 		void* mapBuffer(IBuffer* buffer, MapBufferUsage usage) override;
 		void updateTexture(ITexture* texture, const void* data, uint64_t dataSize, const TextureUpdateInfo& updateInfo) override;
+		void resolveTexture(ITexture* dstTexture, ITexture* srcTexture) override;
+		void blitTexture(ITexture* srcTexture, ITexture* dstTexture, FilterMode filter) override;
+		void generateMips(ITexture* texture) override;
+
+		void beginRenderPass(const RenderPassDesc& desc) override;
+		void endRenderPass() override;
 
 		void setPushConstant(ShaderType stages, const void* data) override;
+		void pushResourceSet(uint32_t setIndex, const ResourceSetBinding* bindings, uint32_t bindingCount) override;
 		void setScissors(const Rect* scissors, uint32_t scissorCount) override;
 		void setGraphicsState(const GraphicsState& state) override;
+		void setCullMode(CullMode cullMode) override;
+		void setFrontFace(bool frontCounterClockwise) override;
+		void setPrimitiveType(PrimitiveType primType) override;
+		void setDepthTestEnable(bool enable) override;
+		void setDepthWriteEnable(bool enable) override;
+		void setDepthCompareOp(CompareOp op) override;
+		void setStencilTestEnable(bool enable) override;
+		void setStencilOp(const StencilOpState& frontFace, const StencilOpState& backFace) override;
+		void setDepthBiasEnable(bool enable) override;
+		void setPrimitiveRestartEnable(bool enable) override;
+		void setPolygonMode(PolygonMode mode) override;
+		void setDepthClampEnable(bool enable) override;
 
 		void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
 		void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) override;
 		void drawIndirect(uint64_t offset, uint32_t drawCount) override;
 		void drawIndexedIndirect(uint64_t offset, uint32_t drawCount) override;
+		void drawIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+			IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount) override;
+		void drawIndexedIndirectCount(IBuffer* argumentBuffer, uint64_t argumentOffset,
+			IBuffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount) override;
 
 		void setComputeState(const ComputeState& state) override;
 		void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
@@ -79,10 +151,59 @@ namespace rhi
 	private:
 		CommandListVk() = delete;
 		void transitionResourceSet(IResourceSet* set, ShaderType dstVisibleStages);
+		void transitionResourceSetBinding(const ResourceSetBinding& binding);
+		// Binds descriptor sets, or sets the descriptor buffer offsets of the sets when the device uses a descriptor buffer.
+		// The versions of the bound sets are stored to boundVersions.
+		void bindResourceSets(VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+			IResourceSet* const* resourceSets, uint32_t resourceSetCount, uint32_t* boundVersions);
+		static bool resourceSetsChanged(IResourceSet* const* resourceSets, uint32_t resourceSetCount,
+			IResourceSet* const* lastResourceSets, uint32_t lastResourceSetCount, const uint32_t* boundVersions);
 		void setBufferBarrier(BufferVk* buffer, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+		void addTextureBarrier(TextureVk* texture, ResourceState stateBefore, ResourceState stateAfter);
+		void endSplitBarrier(const void* resource);
+		void addGlobalBarrier(ResourceState stateBefore, ResourceState stateAfter);
+		void analyzeBarrier(const void* resource, ResourceState stateBefore, ResourceState stateAfter,
+			VkPipelineStageFlags2 srcStages, VkPipelineStageFlags2 dstStages, bool layoutTransition, bool isBuffer, const char* requester);
+		// Starts a rendering section for m_RenderPassDesc. A resumed section loads what the previous one stored.
+		void beginRendering(bool resume);
 		void endRendering();
+		bool hasPendingBarriers() const;
+		// Records a barrier on a single mip right away, the tracked state of the texture is not changed.
+		void recordMipBarrier(TextureVk* texture, uint32_t mipLevel, ResourceState stateBefore, ResourceState stateAfter);
+		void generateMipsWithBlit(TextureVk* texture);
+		void generateMipsWithCompute(TextureVk* texture);
+		void prepareIndirectCountDraw(BufferVk* argumentBuffer, uint64_t argumentOffset, uint64_t argumentSize,
+			BufferVk* countBuffer, uint64_t countOffset);
+
+		struct PendingClear
+		{
+			TextureViewVk* view = nullptr;
+			bool isColor = true;
+			ClearColor color = ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			ClearDepthStencilFlag depthStencilFlag = ClearDepthStencilFlag(0);
+			float depth = 1.0f;
+			uint8_t stencil = 0;
+		};
+		PendingClear* getPendingClear(TextureViewVk* textureView);
+		// Record the pending clears of the texture as clear commands, all of them if texture is nullptr.
+		void flushPendingClears(const ITexture* texture);
+		void flushPendingClear(size_t index);
+		// Record the pending clears on attachment textures that can't become a load op, i.e. of other views of them.
+		void flushUnfoldablePendingClears(const RenderPassDesc& desc);
+		// Turn the pending clears of attachments into clear load ops.
+		void foldPendingClears(RenderPassDesc& desc);
 		bool m_EnableAutoTransition = true;
+		bool m_UseGlobalMemoryBarriers = false;
+		bool m_BarrierAnalysis = false;
+		// The outermost command that is recording barriers right now, the ICommandList entry point rather than its caller.
+		const char* m_BarrierRequester = nullptr;
+		BarrierStatistics m_BarrierStatistics;
 		bool m_RenderingStarted = false;
+		// Inside beginRenderPass/endRenderPass.
+		bool m_InRenderPass = false;
+		RenderPassDesc m_RenderPassDesc;
+		std::vector<PendingClear> m_PendingClears;
+		ClearStatistics m_ClearStatistics;
 		enum class PipelineType
 		{
 			Unknown,
@@ -92,12 +213,39 @@ namespace rhi
 		PipelineType m_LastPipelineType = PipelineType::Unknown;
 		GraphicsState m_LastGraphicsState;
 		ComputeState m_LastComputeState;
+		// ResourceSetVk::version of the sets in the last states when they were bound
+		uint32_t m_LastGraphicsSetVersions[g_MaxBoundDescriptorSets]{};
+		uint32_t m_LastComputeSetVersions[g_MaxBoundDescriptorSets]{};
+
+		// Dynamic states last recorded into the current command buffer, a value is only meaningful while its bit is valid.
+		struct DynamicStateCache
+		{
+			DynamicState valid = DynamicState::None;
+			CullMode cullMode = CullMode::None;
+			bool frontCounterClockwise = false;
+			PrimitiveType primType = PrimitiveType::TriangleList;
+			bool depthTestEnable = false;
+			bool depthWriteEnable = false;
+			CompareOp depthCompareOp = CompareOp::Never;
+			bool stencilTestEnable = false;
+			StencilOpState frontFaceStencil;
+			StencilOpState backFaceStencil;
+			bool depthBiasEnable = false;
+			bool primitiveRestartEnable = false;
+			PolygonMode polygonMode = PolygonMode::Fill;
+			bool depthClampEnable = false;
+		};
+		// Returns false if the state already has the value.
+		template<typename T>
+		bool updateDynamicState(DynamicState state, T& cachedValue, T value);
+		DynamicStateCache m_DynamicStates;
 
 		struct TextureBarrier
 		{
 			TextureVk* texture = nullptr;
 			ResourceState stateBefore = ResourceState::Undefined;
 			ResourceState stateAfter = ResourceState::Undefined;
+			const char* requester = nullptr;
 		};
 
 		struct BufferBarrier
@@ -105,14 +253,44 @@ namespace rhi
 			BufferVk* buffer = nullptr;
 			ResourceState stateBefore = ResourceState::Undefined;
 			ResourceState stateAfter = ResourceState::Undefined;
+			uint64_t offset = 0;
+			// VK_WHOLE_SIZE for barriers on the whole buffer.
+			uint64_t size = VK_WHOLE_SIZE;
+			const char* requester = nullptr;
 		};
 		std::vector<TextureBarrier> m_TextureBarriers;
 		std::vector<BufferBarrier> m_BufferBarriers;
+		ResourceIndexMap m_TextureBarrierIndices;
+		ResourceIndexMap m_BufferBarrierIndices;
+
+		// Pending global memory barrier, all transitions merged into it share a single VkMemoryBarrier2.
+		bool m_HasGlobalBarrier = false;
+		ResourceState m_GlobalBarrierBefore = ResourceState::Undefined;
+		ResourceState m_GlobalBarrierAfter = ResourceState::Undefined;
+		const char* m_GlobalBarrierRequester = nullptr;
+
+		// Transitions started with vkCmdSetEvent2 and not yet waited on.
+		struct SplitBarrier
+		{
+			const void* resource = nullptr;
+			VkEvent event = VK_NULL_HANDLE;
+			VkImageMemoryBarrier2 imageBarrier{};
+			VkBufferMemoryBarrier2 bufferBarrier{};
+			bool isTexture = false;
+		};
+		std::vector<SplitBarrier> m_SplitBarriers;
 
 		std::vector<TextureVk*> m_TrackingSubmittedStates;
+		ResourceIndexMap m_TrackingSubmittedIndices;
+
+		// Scratch arrays of pushResourceSet, sized before use so the writes can point into them.
+		std::vector<VkWriteDescriptorSet> m_PushDescriptorWrites;
+		std::vector<VkDescriptorImageInfo> m_PushDescriptorImageInfos;
+		std::vector<VkDescriptorBufferInfo> m_PushDescriptorBufferInfos;
 
 		std::vector<VkImageMemoryBarrier2> m_VkImageMemoryBarriers;
 		std::vector<VkBufferMemoryBarrier2> m_VkBufferMemoryBarriers;
+		std::vector<BufferRangeState> m_BufferRangeStates;
 
 		CommandBuffer* m_CurrentCmdBuf = nullptr;
 
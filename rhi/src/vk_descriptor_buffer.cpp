@@ -0,0 +1,213 @@
+#include "vk_descriptor_buffer.h"
+
+#include "vk_errors.h"
+#include "vk_render_device.h"
+#include "vk_resource.h"
+#include "rhi/common/Error.h"
+#include "rhi/common/Utils.h"
+
+#include <cstring>
+
+namespace rhi
+{
+	DescriptorBufferVk::~DescriptorBufferVk()
+	{
+		if (m_Buffer != VK_NULL_HANDLE)
+		{
+			vmaDestroyBuffer(m_Allocator, m_Buffer, m_Allocation);
+		}
+	}
+
+	bool DescriptorBufferVk::init(VkDeviceSize size, const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties)
+	{
+		m_Properties = properties;
+		m_Size = size;
+
+		VkBufferCreateInfo bufferCI{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferCI.size = size;
+		bufferCI.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+		// written by the CPU only, prefers device local memory that is host visible
+		VmaAllocationCreateInfo allocCI{};
+		allocCI.usage = VMA_MEMORY_USAGE_AUTO;
+		allocCI.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocationInfo{};
+		VkResult err = vmaCreateBuffer(m_Allocator, &bufferCI, &allocCI, &m_Buffer, &m_Allocation, &allocationInfo);
+		CHECK_VK_RESULT(err, "Could not create the descriptor buffer");
+		if (err != VK_SUCCESS)
+		{
+			return false;
+		}
+		m_MappedData = static_cast<uint8_t*>(allocationInfo.pMappedData);
+
+		VkBufferDeviceAddressInfo addressInfo{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+		addressInfo.buffer = m_Buffer;
+		m_BindingInfo.address = vkGetBufferDeviceAddress(m_Context.device, &addressInfo);
+		m_BindingInfo.usage = bufferCI.usage;
+		return true;
+	}
+
+	void DescriptorBufferVk::initLayout(ResourceSetLayoutVk* layout) const
+	{
+		m_Functions.getDescriptorSetLayoutSize(m_Context.device, layout->descriptorSetLayout, &layout->descriptorBufferSize);
+		layout->descriptorBufferSize = alignUp(layout->descriptorBufferSize, m_Properties.descriptorBufferOffsetAlignment);
+
+		layout->descriptorBufferBindingOffsets.resize(layout->resourceSetLayoutBindings.size());
+		for (size_t i = 0; i < layout->resourceSetLayoutBindings.size(); ++i)
+		{
+			m_Functions.getDescriptorSetLayoutBindingOffset(m_Context.device, layout->descriptorSetLayout,
+				layout->resourceSetLayoutBindings[i].bindingSlot, &layout->descriptorBufferBindingOffsets[i]);
+		}
+	}
+
+	bool DescriptorBufferVk::allocate(ResourceSetVk* resourceSet)
+	{
+		VkDeviceSize size = resourceSet->resourceSetLayout->descriptorBufferSize;
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		auto freeRanges = m_FreeRanges.find(size);
+		if (freeRanges != m_FreeRanges.end() && !freeRanges->second.empty())
+		{
+			resourceSet->descriptorBufferOffset = freeRanges->second.back();
+			freeRanges->second.pop_back();
+			return true;
+		}
+		if (m_AllocatedSize + size > m_Size)
+		{
+			LOG_ERROR("The descriptor buffer is full (", m_Size, " bytes)");
+			return false;
+		}
+		// layout sizes are aligned, so every offset stays aligned
+		resourceSet->descriptorBufferOffset = m_AllocatedSize;
+		m_AllocatedSize += size;
+		return true;
+	}
+
+	void DescriptorBufferVk::release(VkDeviceSize offset, VkDeviceSize size)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		m_RetiredRanges.push_back(RetiredRange{ m_LastSubmittedID, offset, size });
+	}
+
+	void DescriptorBufferVk::recycle(uint64_t lastFinishedID)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		while (!m_RetiredRanges.empty() && m_RetiredRanges.front().retireID <= lastFinishedID)
+		{
+			const RetiredRange& range = m_RetiredRanges.front();
+			m_FreeRanges[range.size].push_back(range.offset);
+			m_RetiredRanges.pop_front();
+		}
+	}
+
+	void DescriptorBufferVk::copyDescriptors(VkDeviceSize srcOffset, const ResourceSetVk* resourceSet)
+	{
+		std::memcpy(m_MappedData + resourceSet->descriptorBufferOffset, m_MappedData + srcOffset,
+			resourceSet->resourceSetLayout->descriptorBufferSize);
+	}
+
+	size_t DescriptorBufferVk::getDescriptorSize(VkDescriptorType type) const
+	{
+		switch (type)
+		{
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+			return m_Properties.samplerDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			return m_Properties.combinedImageSamplerDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+			return m_Properties.sampledImageDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			return m_Properties.storageImageDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+			return m_Properties.uniformTexelBufferDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			return m_Properties.storageTexelBufferDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			return m_Properties.uniformBufferDescriptorSize;
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			return m_Properties.storageBufferDescriptorSize;
+		default:
+			assert(!"invalid VkDescriptorType");
+			return 0;
+		}
+	}
+
+	void DescriptorBufferVk::writeDescriptor(const ResourceSetVk* resourceSet, size_t layoutBindingIndex, const ResourceSetBinding& binding)
+	{
+		const ResourceSetLayoutVk* layout = resourceSet->resourceSetLayout;
+
+		VkDescriptorGetInfoEXT getInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT };
+		getInfo.type = shaderResourceTypeToVkDescriptorType(binding.type);
+
+		VkDescriptorImageInfo imageInfo{};
+		VkDescriptorAddressInfoEXT addressInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT };
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		switch (binding.type)
+		{
+		case ShaderResourceType::SampledTexture:
+			assert(binding.textureView != nullptr);
+			imageInfo.imageView = checked_cast<TextureViewVk*>(binding.textureView)->imageView;
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			getInfo.data.pSampledImage = &imageInfo;
+			break;
+		case ShaderResourceType::StorageTexture:
+			assert(binding.textureView != nullptr);
+			imageInfo.imageView = checked_cast<TextureViewVk*>(binding.textureView)->imageView;
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			getInfo.data.pStorageImage = &imageInfo;
+			break;
+		case ShaderResourceType::TextureWithSampler:
+			assert(binding.textureView != nullptr);
+			assert(binding.sampler != nullptr);
+			imageInfo.imageView = checked_cast<TextureViewVk*>(binding.textureView)->imageView;
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+			getInfo.data.pCombinedImageSampler = &imageInfo;
+			break;
+		case ShaderResourceType::StorageBuffer:
+		case ShaderResourceType::UniformBuffer:
+		{
+			assert(binding.buffer != nullptr);
+			auto buffer = checked_cast<BufferVk*>(binding.buffer);
+			assert(buffer->deviceAddress != 0);
+			// there is no VK_WHOLE_SIZE for addresses
+			addressInfo.address = buffer->deviceAddress + binding.bufferOffset;
+			addressInfo.range = binding.bufferRange == 0 ? buffer->desc.size - binding.bufferOffset : binding.bufferRange;
+			if (binding.type == ShaderResourceType::StorageBuffer)
+			{
+				getInfo.data.pStorageBuffer = &addressInfo;
+			}
+			else
+			{
+				getInfo.data.pUniformBuffer = &addressInfo;
+			}
+			break;
+		}
+		case ShaderResourceType::Sampler:
+			assert(binding.sampler != nullptr);
+			sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+			getInfo.data.pSampler = &sampler;
+			break;
+		case ShaderResourceType::UniformTexelBuffer:
+		case ShaderResourceType::StorageTexelBuffer:
+			assert(!"not yet implemented");
+			return;
+		default:
+			assert(!"invalid ShaderResourceType");
+			return;
+		}
+
+		size_t descriptorSize = getDescriptorSize(getInfo.type);
+		VkDeviceSize offset = resourceSet->descriptorBufferOffset + layout->descriptorBufferBindingOffsets[layoutBindingIndex] +
+			binding.arrayElementIndex * descriptorSize;
+		m_Functions.getDescriptor(m_Context.device, &getInfo, descriptorSize, m_MappedData + offset);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "rhi/rhi.h"
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#if defined RHI_ENABLE_THREAD_RECORDING
+#include <mutex>
+#endif
+
+namespace rhi
+{
+	struct ContextVk;
+	struct ExtensionFunctionsVk;
+	class ResourceSetLayoutVk;
+	class ResourceSetVk;
+
+	// Device-wide descriptor buffer (VK_EXT_descriptor_buffer) that replaces the descriptor pool of every resource set.
+	// Descriptors are written with vkGetDescriptorEXT straight into the mapped buffer and a set is bound by its offset.
+	// Sets are sub-allocated linearly. Released ranges are retired with the last submitted execute ID and reused by
+	// sets of the same size once it has finished, layouts of one kind of set all have the same size.
+	class DescriptorBufferVk
+	{
+	public:
+		DescriptorBufferVk(const ContextVk& context, const VmaAllocator& allocator, const ExtensionFunctionsVk& functions,
+			const uint64_t& lastSubmittedID)
+			:m_Context(context),
+			m_Allocator(allocator),
+			m_Functions(functions),
+			m_LastSubmittedID(lastSubmittedID) {}
+		~DescriptorBufferVk();
+		bool init(VkDeviceSize size, const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties);
+
+		// Queries the size and binding offsets of a layout created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT.
+		void initLayout(ResourceSetLayoutVk* layout) const;
+		// Sets descriptorBufferOffset of the set, false if the buffer is full.
+		bool allocate(ResourceSetVk* resourceSet);
+		void release(VkDeviceSize offset, VkDeviceSize size);
+		void recycle(uint64_t lastFinishedID);
+		// Copies the descriptors at srcOffset to the range of the set, both of its size.
+		void copyDescriptors(VkDeviceSize srcOffset, const ResourceSetVk* resourceSet);
+		// layoutBindingIndex is the index of the binding in ResourceSetLayoutVk::resourceSetLayoutBindings.
+		void writeDescriptor(const ResourceSetVk* resourceSet, size_t layoutBindingIndex, const ResourceSetBinding& binding);
+
+		// Bound once per command buffer, sets are then selected with vkCmdSetDescriptorBufferOffsetsEXT.
+		const VkDescriptorBufferBindingInfoEXT& getBindingInfo() const { return m_BindingInfo; }
+	private:
+		size_t getDescriptorSize(VkDescriptorType type) const;
+
+		const ContextVk& m_Context;
+		const VmaAllocator& m_Allocator;
+		const ExtensionFunctionsVk& m_Functions;
+		VkPhysicalDeviceDescriptorBufferPropertiesEXT m_Properties{};
+		VkBuffer m_Buffer = VK_NULL_HANDLE;
+		VmaAllocation m_Allocation = VK_NULL_HANDLE;
+		uint8_t* m_MappedData = nullptr;
+		VkDeviceSize m_Size = 0;
+		VkDeviceSize m_AllocatedSize = 0;
+		struct RetiredRange
+		{
+			uint64_t retireID = 0;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+		};
+		const uint64_t& m_LastSubmittedID;
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::mutex m_Mutex;
+#endif
+		// Ordered by retireID.
+		std::deque<RetiredRange> m_RetiredRanges;
+		// offsets of free ranges by size
+		std::unordered_map<VkDeviceSize, std::vector<VkDeviceSize>> m_FreeRanges;
+		VkDescriptorBufferBindingInfoEXT m_BindingInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT };
+	};
+}
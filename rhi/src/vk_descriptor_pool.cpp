@@ -0,0 +1,131 @@
+#include "vk_descriptor_pool.h"
+
+#include "vk_errors.h"
+#include "vk_resource.h"
+#include "rhi/common/Error.h"
+
+#include <algorithm>
+
+namespace rhi
+{
+	constexpr uint32_t g_MaxSetsPerDescriptorPool = 4096;
+
+	DescriptorPoolAllocatorVk::~DescriptorPoolAllocatorVk()
+	{
+		for (const Pool& pool : m_Pools)
+		{
+			vkDestroyDescriptorPool(m_Context.device, pool.pool, nullptr);
+		}
+	}
+
+	uint32_t DescriptorPoolAllocatorVk::getProfile(const std::vector<VkDescriptorPoolSize>& setPoolSizes)
+	{
+		std::vector<std::pair<VkDescriptorType, uint32_t>> key;
+		key.reserve(setPoolSizes.size());
+		for (const VkDescriptorPoolSize& poolSize : setPoolSizes)
+		{
+			key.emplace_back(poolSize.type, poolSize.descriptorCount);
+		}
+
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		auto [it, inserted] = m_ProfileIndices.try_emplace(std::move(key), static_cast<uint32_t>(m_Profiles.size()));
+		if (inserted)
+		{
+			m_Profiles.emplace_back().setPoolSizes = setPoolSizes;
+		}
+		return it->second;
+	}
+
+	bool DescriptorPoolAllocatorVk::createPool(Profile& profile)
+	{
+		uint32_t setCount = profile.nextPoolSetCount;
+		profile.nextPoolSetCount = (std::min)(setCount * 2, g_MaxSetsPerDescriptorPool);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = profile.setPoolSizes;
+		for (VkDescriptorPoolSize& poolSize : poolSizes)
+		{
+			poolSize.descriptorCount *= setCount;
+		}
+
+		VkDescriptorPoolCreateInfo poolCI{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolCI.maxSets = setCount;
+		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCI.pPoolSizes = poolSizes.data();
+
+		Pool pool{};
+		pool.freeSetCount = setCount;
+		VkResult err = vkCreateDescriptorPool(m_Context.device, &poolCI, nullptr, &pool.pool);
+		CHECK_VK_RESULT(err, "Could not create descriptorPool.");
+		if (err != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		profile.currentPool = static_cast<uint32_t>(m_Pools.size());
+		profile.pools.push_back(profile.currentPool);
+		m_PoolIndices.emplace(pool.pool, profile.currentPool);
+		m_Pools.push_back(pool);
+		return true;
+	}
+
+	bool DescriptorPoolAllocatorVk::allocate(uint32_t profileIndex, VkDescriptorSetLayout layout, VkDescriptorPool& pool, VkDescriptorSet& set)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		Profile& profile = m_Profiles[profileIndex];
+		if (profile.currentPool == UINT32_MAX || m_Pools[profile.currentPool].freeSetCount == 0)
+		{
+			auto it = std::find_if(profile.pools.begin(), profile.pools.end(),
+				[&](uint32_t poolIndex) { return m_Pools[poolIndex].freeSetCount != 0; });
+			if (it != profile.pools.end())
+			{
+				profile.currentPool = *it;
+			}
+			else if (!createPool(profile))
+			{
+				return false;
+			}
+		}
+
+		Pool& currentPool = m_Pools[profile.currentPool];
+		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = currentPool.pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		VkResult err = vkAllocateDescriptorSets(m_Context.device, &allocInfo, &set);
+		CHECK_VK_RESULT(err, "Could not create descriptorSet.");
+		if (err != VK_SUCCESS)
+		{
+			return false;
+		}
+		--currentPool.freeSetCount;
+		pool = currentPool.pool;
+		return true;
+	}
+
+	void DescriptorPoolAllocatorVk::release(VkDescriptorPool pool, VkDescriptorSet set)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		m_RetiredSets.push_back(RetiredSet{ m_LastSubmittedID, pool, set });
+	}
+
+	void DescriptorPoolAllocatorVk::recycle(uint64_t lastFinishedID)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		while (!m_RetiredSets.empty() && m_RetiredSets.front().retireID <= lastFinishedID)
+		{
+			const RetiredSet& retiredSet = m_RetiredSets.front();
+			vkFreeDescriptorSets(m_Context.device, retiredSet.pool, 1, &retiredSet.set);
+			++m_Pools[m_PoolIndices[retiredSet.pool]].freeSetCount;
+			m_RetiredSets.pop_front();
+		}
+	}
+}
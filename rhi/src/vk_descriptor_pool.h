@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#if defined RHI_ENABLE_THREAD_RECORDING
+#include <mutex>
+#endif
+
+namespace rhi
+{
+	struct ContextVk;
+
+	// Allocates the descriptor sets of resource sets from shared pools instead of creating a pool per set.
+	// Layouts with the same descriptor count per type share a profile, and the pools of a profile only hold sets of
+	// that profile, so a pool with a free slot never fails because of fragmentation. A new pool, twice as large as the
+	// previous one, is only created when every pool of the profile is full.
+	// Released sets are retired with the last submitted execute ID and only freed once it has finished.
+	class DescriptorPoolAllocatorVk
+	{
+	public:
+		DescriptorPoolAllocatorVk(const ContextVk& context, const uint64_t& lastSubmittedID)
+			:m_Context(context),
+			m_LastSubmittedID(lastSubmittedID) {}
+		~DescriptorPoolAllocatorVk();
+
+		// setPoolSizes are the descriptor counts of one set, sorted by type.
+		uint32_t getProfile(const std::vector<VkDescriptorPoolSize>& setPoolSizes);
+		bool allocate(uint32_t profile, VkDescriptorSetLayout layout, VkDescriptorPool& pool, VkDescriptorSet& set);
+		void release(VkDescriptorPool pool, VkDescriptorSet set);
+		void recycle(uint64_t lastFinishedID);
+	private:
+		struct Pool
+		{
+			VkDescriptorPool pool = VK_NULL_HANDLE;
+			uint32_t freeSetCount = 0;
+		};
+		struct Profile
+		{
+			std::vector<VkDescriptorPoolSize> setPoolSizes;
+			// indices into m_Pools
+			std::vector<uint32_t> pools;
+			uint32_t currentPool = UINT32_MAX;
+			uint32_t nextPoolSetCount = 64;
+		};
+		struct RetiredSet
+		{
+			uint64_t retireID = 0;
+			VkDescriptorPool pool = VK_NULL_HANDLE;
+			VkDescriptorSet set = VK_NULL_HANDLE;
+		};
+
+		bool createPool(Profile& profile);
+
+		const ContextVk& m_Context;
+		const uint64_t& m_LastSubmittedID;
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::mutex m_Mutex;
+#endif
+		std::vector<Profile> m_Profiles;
+		std::map<std::vector<std::pair<VkDescriptorType, uint32_t>>, uint32_t> m_ProfileIndices;
+		std::vector<Pool> m_Pools;
+		std::unordered_map<VkDescriptorPool, uint32_t> m_PoolIndices;
+		// Ordered by retireID.
+		std::deque<RetiredSet> m_RetiredSets;
+	};
+}
@@ -1,5 +1,6 @@
 #include "vk_pipeline.h"
 #include "vk_errors.h"
+#include "vk_pipeline_cache.h"
 #include "vk_resource.h"
 
 #include <cassert>
@@ -165,11 +166,12 @@ namespace rhi
 
 	GraphicsPipelineVk::~GraphicsPipelineVk()
 	{
-		if (pipelineCache != VK_NULL_HANDLE)
+		// cancels the optimization or waits for it, it writes optimizedPipeline
+		optimizeTask.reset();
+		if (optimizedPipeline != VK_NULL_HANDLE)
 		{
-			vkDestroyPipelineCache(m_Context.device, pipelineCache, nullptr);
+			vkDestroyPipeline(m_Context.device, optimizedPipeline, nullptr);
 		}
-		vkDestroyPipelineLayout(m_Context.device, pipelineLayout, nullptr);
 		vkDestroyPipeline(m_Context.device, pipeline, nullptr);
 	}
 
@@ -178,9 +180,9 @@ namespace rhi
 		switch (type)
 		{
 		case NativeObjectType::VK_Pipeline:
-			return static_cast<Object>(pipeline);
+			return static_cast<Object>(getPipeline());
 		case NativeObjectType::VK_PipelineCache:
-			return static_cast<Object>(pipelineCache);
+			return static_cast<Object>(pipelineCache->getMainCache());
 		default:
 			return nullptr;
 		}
@@ -188,25 +190,11 @@ namespace rhi
 
 	bool GraphicsPipelineVk::getPipelineCacheData(void* pData, size_t* pDataSize) const
 	{
-		assert(pDataSize != nullptr);
-		VkResult err = vkGetPipelineCacheData(m_Context.device, pipelineCache, pDataSize, nullptr);
-		CHECK_VK_RESULT(err);
-		if (pData == nullptr)
-		{
-			return err != VK_SUCCESS;
-		}
-		err = vkGetPipelineCacheData(m_Context.device, pipelineCache, pDataSize, pData);
-		CHECK_VK_RESULT(err);
-		return err != VK_SUCCESS;
+		return pipelineCache->getData(pData, pDataSize);
 	}
 
 	ComputePipelineVk::~ComputePipelineVk()
 	{
-		if (pipelineCache != VK_NULL_HANDLE)
-		{
-			vkDestroyPipelineCache(m_Context.device, pipelineCache, nullptr);
-		}
-		vkDestroyPipelineLayout(m_Context.device, pipelineLayout, nullptr);
 		vkDestroyPipeline(m_Context.device, pipeline, nullptr);
 	}
 
@@ -217,7 +205,7 @@ namespace rhi
 		case NativeObjectType::VK_Pipeline:
 			return static_cast<Object>(pipeline);
 		case NativeObjectType::VK_PipelineCache:
-			return static_cast<Object>(pipelineCache);
+			return static_cast<Object>(pipelineCache->getMainCache());
 		default:
 			return nullptr;
 		}
@@ -225,15 +213,6 @@ namespace rhi
 
 	bool ComputePipelineVk::getPipelineCacheData(void* pData, size_t* pDataSize) const
 	{
-		assert(pDataSize != nullptr);
-		VkResult err = vkGetPipelineCacheData(m_Context.device, pipelineCache, pDataSize, nullptr);
-		CHECK_VK_RESULT(err);
-		if (pData == nullptr)
-		{
-			return err != VK_SUCCESS;
-		}
-		err = vkGetPipelineCacheData(m_Context.device, pipelineCache, pDataSize, pData);
-		CHECK_VK_RESULT(err);
-		return err != VK_SUCCESS;
+		return pipelineCache->getData(pData, pDataSize);
 	}
 }
\ No newline at end of file
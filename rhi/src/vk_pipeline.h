@@ -4,9 +4,12 @@
 
 #include "rhi/rhi.h"
 #include <vector>
+#include <atomic>
+#include <memory>
 namespace rhi
 {
 	struct ContextVk;
+	class PipelineCacheVk;
 
 	class GraphicsPipelineVk final : public IGraphicsPipeline
 	{
@@ -17,11 +20,25 @@ namespace rhi
 		const GraphicsPipelineDesc& getDesc() const override  { return desc; }
 		bool getPipelineCacheData(void* pData, size_t* pDataSize) const override;
 		Object getNativeObject(NativeObjectType type) const override;
+		// The pipeline to bind, the optimized one once it is ready.
+		VkPipeline getPipeline() const
+		{
+			VkPipeline optimized = optimizedPipeline.load(std::memory_order_acquire);
+			return optimized != VK_NULL_HANDLE ? optimized : pipeline;
+		}
 
 		GraphicsPipelineDesc desc;
+		// shared with identical pipelines, owned by the device
 		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		// Fast-linked if the pipeline was built from libraries.
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		// Link time optimized version of a fast-linked pipeline, set by optimizeTask on a pipeline compile thread.
+		std::atomic<VkPipeline> optimizedPipeline{ VK_NULL_HANDLE };
+		std::unique_ptr<IPipelineCompileTask> optimizeTask;
+		// the device-wide cache, not owned
+		PipelineCacheVk* pipelineCache = nullptr;
+		// Set index of the PushDescriptor layout, UINT32_MAX if there is none.
+		uint32_t pushDescriptorSetIndex = UINT32_MAX;
 
 		struct PushConstantInfo
 		{
@@ -42,9 +59,13 @@ namespace rhi
 		bool getPipelineCacheData(void* pData, size_t* pDataSize) const override;
 		Object getNativeObject(NativeObjectType type) const override;
 
+		// shared with identical pipelines, owned by the device
 		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		// the device-wide cache, not owned
+		PipelineCacheVk* pipelineCache = nullptr;
+		// Set index of the PushDescriptor layout, UINT32_MAX if there is none.
+		uint32_t pushDescriptorSetIndex = UINT32_MAX;
 
 		struct PushConstantInfo
 		{
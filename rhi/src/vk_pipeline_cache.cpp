@@ -0,0 +1,217 @@
+#include "vk_pipeline_cache.h"
+
+#include "vk_errors.h"
+#include "vk_resource.h"
+#include "rhi/common/Error.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace rhi
+{
+	PipelineCacheVk::~PipelineCacheVk()
+	{
+		for (auto& [threadID, threadCache] : m_ThreadCaches)
+		{
+			vkDestroyPipelineCache(m_Context.device, threadCache->cache, nullptr);
+		}
+		if (m_MainCache != VK_NULL_HANDLE)
+		{
+			vkDestroyPipelineCache(m_Context.device, m_MainCache, nullptr);
+		}
+	}
+
+	bool PipelineCacheVk::isCompatible(const void* data, size_t dataSize) const
+	{
+		VkPipelineCacheHeaderVersionOne header{};
+		if (dataSize < sizeof(header))
+		{
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		return header.headerSize >= sizeof(header) && header.headerSize <= dataSize &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == m_Properties.vendorID &&
+			header.deviceID == m_Properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	VkPipelineCache PipelineCacheVk::createCache(const void* data, size_t dataSize, bool externallySynchronized) const
+	{
+		VkPipelineCacheCreateInfo cacheCI{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		cacheCI.flags = externallySynchronized ? VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT : 0;
+		cacheCI.initialDataSize = dataSize;
+		cacheCI.pInitialData = data;
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		VkResult err = vkCreatePipelineCache(m_Context.device, &cacheCI, nullptr, &cache);
+		CHECK_VK_RESULT(err, "Failed to create pipeline cache.");
+		return cache;
+	}
+
+	bool PipelineCacheVk::init(const char* filePath)
+	{
+		if (filePath != nullptr)
+		{
+			m_FilePath = filePath;
+			std::ifstream file(m_FilePath, std::ios::ate | std::ios::binary);
+			if (file.is_open())
+			{
+				m_LoadedData.resize(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				file.read(reinterpret_cast<char*>(m_LoadedData.data()), m_LoadedData.size());
+				if (!file || !isCompatible(m_LoadedData.data(), m_LoadedData.size()))
+				{
+					LOG_WARNING("Ignored the pipeline cache ", m_FilePath, ", it was written by another device or driver");
+					m_LoadedData.clear();
+				}
+			}
+		}
+
+		m_MainCache = createCache(m_LoadedData.data(), m_LoadedData.size(), false);
+		return m_MainCache != VK_NULL_HANDLE;
+	}
+
+	VkPipelineCache PipelineCacheVk::beginCreate(const void* cacheData, size_t cacheSize)
+	{
+		if (cacheData != nullptr && cacheSize != 0)
+		{
+			if (isCompatible(cacheData, cacheSize))
+			{
+				VkPipelineCache cache = createCache(cacheData, cacheSize, m_ExternallySynchronized);
+				if (cache != VK_NULL_HANDLE)
+				{
+					return cache;
+				}
+			}
+			else
+			{
+				LOG_WARNING("Ignored the cacheData of the pipeline, it was written by another device or driver");
+			}
+		}
+
+		ThreadCache* threadCache = nullptr;
+		{
+			std::lock_guard lock(m_Mutex);
+			auto [it, inserted] = m_ThreadCaches.try_emplace(std::this_thread::get_id());
+			if (inserted)
+			{
+				VkPipelineCache cache = createCache(m_LoadedData.data(), m_LoadedData.size(), m_ExternallySynchronized);
+				if (cache == VK_NULL_HANDLE)
+				{
+					m_ThreadCaches.erase(it);
+					// the main cache synchronizes itself
+					return m_MainCache;
+				}
+				it->second = std::make_unique<ThreadCache>();
+				it->second->cache = cache;
+			}
+			threadCache = it->second.get();
+		}
+		// unlocked by endCreate, a merge must not read the cache while the pipeline is created with it
+		threadCache->mutex.lock();
+		return threadCache->cache;
+	}
+
+	void PipelineCacheVk::endCreate(VkPipelineCache cache)
+	{
+		if (cache == m_MainCache)
+		{
+			return;
+		}
+		std::lock_guard lock(m_Mutex);
+		auto it = m_ThreadCaches.find(std::this_thread::get_id());
+		if (it != m_ThreadCaches.end() && it->second->cache == cache)
+		{
+			it->second->mutex.unlock();
+			return;
+		}
+		VkResult err = vkMergePipelineCaches(m_Context.device, m_MainCache, 1, &cache);
+		CHECK_VK_RESULT(err, "Failed to merge pipeline caches.");
+		vkDestroyPipelineCache(m_Context.device, cache, nullptr);
+	}
+
+	bool PipelineCacheVk::mergeThreadCaches()
+	{
+		// Thread caches are never removed, so they can be merged without m_Mutex. Holding it while waiting for a
+		// thread cache would block that thread's endCreate.
+		std::vector<ThreadCache*> threadCaches;
+		{
+			std::lock_guard lock(m_Mutex);
+			threadCaches.reserve(m_ThreadCaches.size());
+			for (auto& [threadID, threadCache] : m_ThreadCaches)
+			{
+				threadCaches.push_back(threadCache.get());
+			}
+		}
+
+		for (ThreadCache* threadCache : threadCaches)
+		{
+			// the main cache synchronizes itself, only the thread cache has to be locked
+			std::lock_guard lock(threadCache->mutex);
+			VkResult err = vkMergePipelineCaches(m_Context.device, m_MainCache, 1, &threadCache->cache);
+			CHECK_VK_RESULT(err, "Failed to merge pipeline caches.");
+			if (err != VK_SUCCESS)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool PipelineCacheVk::getData(void* pData, size_t* pDataSize)
+	{
+		assert(pDataSize != nullptr);
+		if (!mergeThreadCaches())
+		{
+			return false;
+		}
+		VkResult err = vkGetPipelineCacheData(m_Context.device, m_MainCache, pDataSize, pData);
+		CHECK_VK_RESULT(err);
+		return err == VK_SUCCESS;
+	}
+
+	bool PipelineCacheVk::save()
+	{
+		if (m_FilePath.empty())
+		{
+			LOG_ERROR("The pipeline cache has no file, set RenderDeviceCreateInfo::pipelineCacheFilePath");
+			return false;
+		}
+
+		std::vector<uint8_t> data;
+		size_t dataSize = 0;
+		if (!getData(nullptr, &dataSize))
+		{
+			return false;
+		}
+		data.resize(dataSize);
+		if (!getData(data.data(), &dataSize))
+		{
+			return false;
+		}
+
+		std::string tempPath = m_FilePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(data.data()), dataSize);
+			if (!file)
+			{
+				LOG_ERROR("Failed to write the pipeline cache to ", tempPath);
+				return false;
+			}
+		}
+
+		// replaces the previous file in one step
+		std::error_code ec;
+		std::filesystem::rename(tempPath, m_FilePath, ec);
+		if (ec)
+		{
+			LOG_ERROR("Failed to replace the pipeline cache ", m_FilePath, ": ", ec.message());
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+namespace rhi
+{
+	struct ContextVk;
+
+	// Device-wide pipeline cache shared by every pipeline, optionally loaded from and saved to a file.
+	// Each thread that creates pipelines gets its own VkPipelineCache, seeded with the loaded data, so concurrent
+	// pipeline creation doesn't contend on the cache. They are merged into the main cache whenever its data is read,
+	// each one under its lock, which pipeline creation on its thread holds from beginCreate to endCreate.
+	// Data written by another driver or device is ignored, and saving writes a temporary file that then replaces the
+	// cache file, so an interrupted save never leaves a truncated cache behind.
+	class PipelineCacheVk
+	{
+	public:
+		// externallySynchronized: the device supports pipelineCreationCacheControl, thread caches then skip the driver's lock.
+		PipelineCacheVk(const ContextVk& context, const VkPhysicalDeviceProperties& properties, bool externallySynchronized)
+			:m_Context(context),
+			m_Properties(properties),
+			m_ExternallySynchronized(externallySynchronized) {}
+		~PipelineCacheVk();
+
+		// filePath may be null, the cache then only lives in memory.
+		bool init(const char* filePath);
+		// The cache to create a pipeline with. If cacheData is given (the cacheData of a pipeline create info)
+		// it is a temporary cache of that data, which endCreate merges into the main cache.
+		// Every beginCreate must be paired with an endCreate on the same thread.
+		VkPipelineCache beginCreate(const void* cacheData, size_t cacheSize);
+		void endCreate(VkPipelineCache cache);
+		// Same semantics as vkGetPipelineCacheData.
+		bool getData(void* pData, size_t* pDataSize);
+		bool save();
+		VkPipelineCache getMainCache() const { return m_MainCache; }
+		bool hasFile() const { return !m_FilePath.empty(); }
+	private:
+		bool isCompatible(const void* data, size_t dataSize) const;
+		VkPipelineCache createCache(const void* data, size_t dataSize, bool externallySynchronized) const;
+		bool mergeThreadCaches();
+
+		const ContextVk& m_Context;
+		const VkPhysicalDeviceProperties& m_Properties;
+		bool m_ExternallySynchronized = false;
+		std::string m_FilePath;
+		// seed of the thread caches
+		std::vector<uint8_t> m_LoadedData;
+		VkPipelineCache m_MainCache = VK_NULL_HANDLE;
+		struct ThreadCache
+		{
+			VkPipelineCache cache = VK_NULL_HANDLE;
+			// held while a pipeline is created with the cache or it is merged
+			std::mutex mutex;
+		};
+		// always locked, asynchronous pipeline creation runs on worker threads
+		std::mutex m_Mutex;
+		std::unordered_map<std::thread::id, std::unique_ptr<ThreadCache>> m_ThreadCaches;
+	};
+}
@@ -0,0 +1,278 @@
+#include "vk_pipeline_compiler.h"
+
+#include "vk_render_device.h"
+#include "rhi/common/Error.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace rhi
+{
+	PipelineCompileTaskVk::PipelineCompileTaskVk(PipelineCompilerVk& compiler, const GraphicsPipelineCreateInfo& pipelineCI,
+		PipelineCompilePriority priority)
+		:priority(priority),
+		m_Compiler(compiler),
+		m_GraphicsPipelineCI(pipelineCI)
+	{
+		m_VertexInputAttributes.assign(pipelineCI.vertexInputAttributes, pipelineCI.vertexInputAttributes + pipelineCI.vertexInputAttributeCount);
+		m_ResourceSetLayouts.assign(pipelineCI.resourceSetLayouts, pipelineCI.resourceSetLayouts + pipelineCI.resourceSetLayoutCount);
+		m_PushConstantDescs.assign(pipelineCI.pushConstantDescs, pipelineCI.pushConstantDescs + pipelineCI.pushConstantCount);
+		if (pipelineCI.cacheData != nullptr)
+		{
+			auto cacheData = static_cast<const uint8_t*>(pipelineCI.cacheData);
+			m_CacheData.assign(cacheData, cacheData + pipelineCI.cacheSize);
+		}
+
+		m_GraphicsPipelineCI.vertexInputAttributes = m_VertexInputAttributes.data();
+		m_GraphicsPipelineCI.resourceSetLayouts = m_ResourceSetLayouts.data();
+		m_GraphicsPipelineCI.pushConstantDescs = m_PushConstantDescs.data();
+		m_GraphicsPipelineCI.cacheData = m_CacheData.empty() ? nullptr : m_CacheData.data();
+	}
+
+	PipelineCompileTaskVk::PipelineCompileTaskVk(PipelineCompilerVk& compiler, const ComputePipelineCreateInfo& pipelineCI,
+		PipelineCompilePriority priority)
+		:priority(priority),
+		m_Compiler(compiler),
+		m_IsCompute(true),
+		m_ComputePipelineCI(pipelineCI)
+	{
+		m_ResourceSetLayouts.assign(pipelineCI.resourceSetLayouts, pipelineCI.resourceSetLayouts + pipelineCI.resourceSetLayoutCount);
+		m_PushConstantDescs.assign(pipelineCI.pushConstantDescs, pipelineCI.pushConstantDescs + pipelineCI.pushConstantCount);
+		if (pipelineCI.cacheData != nullptr)
+		{
+			auto cacheData = static_cast<const uint8_t*>(pipelineCI.cacheData);
+			m_CacheData.assign(cacheData, cacheData + pipelineCI.cacheSize);
+		}
+
+		m_ComputePipelineCI.resourceSetLayouts = m_ResourceSetLayouts.data();
+		m_ComputePipelineCI.pushConstantDescs = m_PushConstantDescs.data();
+		m_ComputePipelineCI.cacheData = m_CacheData.empty() ? nullptr : m_CacheData.data();
+	}
+
+	PipelineCompileTaskVk::PipelineCompileTaskVk(PipelineCompilerVk& compiler, std::function<bool()> job, PipelineCompilePriority priority)
+		:priority(priority),
+		m_Compiler(compiler),
+		m_Job(std::move(job))
+	{
+	}
+
+	PipelineCompileTaskVk::~PipelineCompileTaskVk()
+	{
+		m_Compiler.cancel(this);
+		delete m_Pipeline;
+	}
+
+	void PipelineCompileTaskVk::wait()
+	{
+		if (!isReady())
+		{
+			m_Compiler.wait(this);
+		}
+	}
+
+	void PipelineCompileTaskVk::setPriority(PipelineCompilePriority priority)
+	{
+		m_Compiler.setPriority(this, priority);
+	}
+
+	IPipeline* PipelineCompileTaskVk::takePipeline()
+	{
+		if (!isReady())
+		{
+			return nullptr;
+		}
+		IPipeline* pipeline = m_Pipeline;
+		m_Pipeline = nullptr;
+		return pipeline;
+	}
+
+	bool PipelineCompileTaskVk::compile(RenderDeviceVk& renderDevice)
+	{
+		if (m_Job)
+		{
+			return m_Job();
+		}
+		if (m_IsCompute)
+		{
+			m_Pipeline = renderDevice.createComputePipeline(m_ComputePipelineCI);
+		}
+		else
+		{
+			m_Pipeline = renderDevice.createGraphicsPipeline(m_GraphicsPipelineCI);
+		}
+		return m_Pipeline != nullptr;
+	}
+
+	PipelineCompilerVk::PipelineCompilerVk(RenderDeviceVk& renderDevice, uint32_t threadCount)
+		:m_RenderDevice(renderDevice),
+		m_ThreadCount(threadCount)
+	{
+		if (m_ThreadCount == 0)
+		{
+			m_ThreadCount = (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+	}
+
+	PipelineCompilerVk::~PipelineCompilerVk()
+	{
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Stopping = true;
+			// tasks nobody started are finished without a pipeline
+			for (auto& queue : m_Queues)
+			{
+				for (PipelineCompileTaskVk* task : queue)
+				{
+					task->state = PipelineCompileTaskVk::State::Finished;
+					task->setReady();
+				}
+				queue.clear();
+			}
+			m_Statistics.queuedCount = 0;
+		}
+		m_TaskQueued.notify_all();
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	void PipelineCompilerVk::startThreads()
+	{
+		m_Threads.reserve(m_ThreadCount);
+		for (uint32_t i = 0; i < m_ThreadCount; ++i)
+		{
+			m_Threads.emplace_back(&PipelineCompilerVk::workerLoop, this);
+		}
+	}
+
+	void PipelineCompilerVk::enqueue(PipelineCompileTaskVk* task)
+	{
+		{
+			std::lock_guard lock(m_Mutex);
+			if (m_Threads.empty())
+			{
+				startThreads();
+			}
+			m_Queues[static_cast<uint32_t>(task->priority)].push_back(task);
+			addQueuedCount(task, 1);
+		}
+		m_TaskQueued.notify_one();
+	}
+
+	void PipelineCompilerVk::removeFromQueue(PipelineCompileTaskVk* task)
+	{
+		auto& queue = m_Queues[static_cast<uint32_t>(task->priority)];
+		queue.erase(std::find(queue.begin(), queue.end(), task));
+		addQueuedCount(task, -1);
+	}
+
+	void PipelineCompilerVk::addQueuedCount(const PipelineCompileTaskVk* task, int32_t count)
+	{
+		if (!task->isInternal())
+		{
+			m_Statistics.queuedCount += count;
+		}
+	}
+
+	void PipelineCompilerVk::compile(PipelineCompileTaskVk* task, std::unique_lock<std::mutex>& lock)
+	{
+		task->state = PipelineCompileTaskVk::State::Compiling;
+		lock.unlock();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bool succeeded = task->compile(m_RenderDevice);
+		double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		lock.lock();
+		task->state = PipelineCompileTaskVk::State::Finished;
+		task->setReady();
+		if (!task->isInternal())
+		{
+			if (succeeded)
+			{
+				++m_Statistics.compiledCount;
+			}
+			else
+			{
+				++m_Statistics.failedCount;
+			}
+			m_Statistics.totalCompileMs += compileMs;
+			m_Statistics.maxCompileMs = (std::max)(m_Statistics.maxCompileMs, compileMs);
+		}
+		m_TaskFinished.notify_all();
+	}
+
+	void PipelineCompilerVk::workerLoop()
+	{
+		std::unique_lock lock(m_Mutex);
+		while (true)
+		{
+			m_TaskQueued.wait(lock, [this]()
+				{
+					return m_Stopping || std::any_of(std::begin(m_Queues), std::end(m_Queues), [](const auto& queue) { return !queue.empty(); });
+				});
+			if (m_Stopping)
+			{
+				return;
+			}
+
+			// highest priority first
+			for (auto queue = std::rbegin(m_Queues); queue != std::rend(m_Queues); ++queue)
+			{
+				if (!queue->empty())
+				{
+					PipelineCompileTaskVk* task = queue->front();
+					queue->pop_front();
+					addQueuedCount(task, -1);
+					compile(task, lock);
+					break;
+				}
+			}
+		}
+	}
+
+	void PipelineCompilerVk::wait(PipelineCompileTaskVk* task)
+	{
+		std::unique_lock lock(m_Mutex);
+		if (task->state == PipelineCompileTaskVk::State::Queued)
+		{
+			// needed now, waiting for a worker to get to it could take longer than compiling it here
+			removeFromQueue(task);
+			compile(task, lock);
+			return;
+		}
+		m_TaskFinished.wait(lock, [task]() { return task->state == PipelineCompileTaskVk::State::Finished; });
+	}
+
+	void PipelineCompilerVk::cancel(PipelineCompileTaskVk* task)
+	{
+		std::unique_lock lock(m_Mutex);
+		if (task->state == PipelineCompileTaskVk::State::Queued)
+		{
+			removeFromQueue(task);
+			task->state = PipelineCompileTaskVk::State::Finished;
+			return;
+		}
+		m_TaskFinished.wait(lock, [task]() { return task->state == PipelineCompileTaskVk::State::Finished; });
+	}
+
+	void PipelineCompilerVk::setPriority(PipelineCompileTaskVk* task, PipelineCompilePriority priority)
+	{
+		std::lock_guard lock(m_Mutex);
+		if (task->state != PipelineCompileTaskVk::State::Queued || task->priority == priority)
+		{
+			return;
+		}
+		removeFromQueue(task);
+		task->priority = priority;
+		m_Queues[static_cast<uint32_t>(priority)].push_back(task);
+		addQueuedCount(task, 1);
+	}
+
+	PipelineCompileStatistics PipelineCompilerVk::getStatistics() const
+	{
+		std::lock_guard lock(m_Mutex);
+		return m_Statistics;
+	}
+}
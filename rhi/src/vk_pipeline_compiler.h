@@ -0,0 +1,97 @@
+#pragma once
+
+#include "rhi/rhi.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace rhi
+{
+	class RenderDeviceVk;
+	class PipelineCompilerVk;
+
+	class PipelineCompileTaskVk final : public IPipelineCompileTask
+	{
+	public:
+		PipelineCompileTaskVk(PipelineCompilerVk& compiler, const GraphicsPipelineCreateInfo& pipelineCI, PipelineCompilePriority priority);
+		PipelineCompileTaskVk(PipelineCompilerVk& compiler, const ComputePipelineCreateInfo& pipelineCI, PipelineCompilePriority priority);
+		// Internal work that creates no pipeline for the caller, e.g. the link time optimization of a fast-linked pipeline.
+		PipelineCompileTaskVk(PipelineCompilerVk& compiler, std::function<bool()> job, PipelineCompilePriority priority);
+		~PipelineCompileTaskVk();
+		Object getNativeObject(NativeObjectType type) const override { return nullptr; }
+		bool isReady() const override { return m_Ready.load(std::memory_order_acquire); }
+		void wait() override;
+		void setPriority(PipelineCompilePriority priority) override;
+		IPipeline* takePipeline() override;
+
+		enum class State : uint8_t
+		{
+			Queued,
+			Compiling,
+			Finished
+		};
+
+		// Owned by PipelineCompilerVk, only accessed with its mutex locked.
+		State state = State::Queued;
+		PipelineCompilePriority priority;
+
+		// Creates the pipeline on the calling thread, returns false if it failed.
+		bool compile(RenderDeviceVk& renderDevice);
+		// Internal jobs are left out of the statistics.
+		bool isInternal() const { return static_cast<bool>(m_Job); }
+		void setReady() { m_Ready.store(true, std::memory_order_release); }
+	private:
+		PipelineCompilerVk& m_Compiler;
+		bool m_IsCompute = false;
+		// The pointers of the create infos point into the copies below.
+		GraphicsPipelineCreateInfo m_GraphicsPipelineCI{};
+		ComputePipelineCreateInfo m_ComputePipelineCI{};
+		std::vector<VertexInputAttribute> m_VertexInputAttributes;
+		std::vector<IResourceSetLayout*> m_ResourceSetLayouts;
+		std::vector<PushConstantDesc> m_PushConstantDescs;
+		std::vector<uint8_t> m_CacheData;
+		std::function<bool()> m_Job;
+		IPipeline* m_Pipeline = nullptr;
+		std::atomic<bool> m_Ready{ false };
+	};
+
+	// Compiles pipelines on a pool of worker threads, highest priority first and in request order within a priority.
+	// The workers call the regular pipeline creation of the device, which compiles against the pipeline cache of
+	// the worker's thread, so they never contend on one VkPipelineCache.
+	class PipelineCompilerVk
+	{
+	public:
+		PipelineCompilerVk(RenderDeviceVk& renderDevice, uint32_t threadCount);
+		~PipelineCompilerVk();
+
+		void enqueue(PipelineCompileTaskVk* task);
+		// Compiles the task on the calling thread if it is still queued, otherwise waits until a worker finished it.
+		void wait(PipelineCompileTaskVk* task);
+		// Removes the task if it is still queued, otherwise waits until a worker finished it.
+		void cancel(PipelineCompileTaskVk* task);
+		void setPriority(PipelineCompileTaskVk* task, PipelineCompilePriority priority);
+		PipelineCompileStatistics getStatistics() const;
+	private:
+		void startThreads();
+		void workerLoop();
+		void compile(PipelineCompileTaskVk* task, std::unique_lock<std::mutex>& lock);
+		void removeFromQueue(PipelineCompileTaskVk* task);
+		void addQueuedCount(const PipelineCompileTaskVk* task, int32_t count);
+
+		RenderDeviceVk& m_RenderDevice;
+		uint32_t m_ThreadCount;
+		std::vector<std::thread> m_Threads;
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_TaskQueued;
+		std::condition_variable m_TaskFinished;
+		bool m_Stopping = false;
+		// indexed by PipelineCompilePriority
+		std::deque<PipelineCompileTaskVk*> m_Queues[3];
+		PipelineCompileStatistics m_Statistics;
+	};
+}
@@ -7,8 +7,10 @@
 
 #include <sstream>
 #include <memory>
-#include <unordered_map>
+#include <string>
 #include <algorithm>
+#include <cstring>
+#include <array>
 
 namespace rhi
 {
@@ -165,6 +167,8 @@ namespace rhi
 		}
 
 		context.physicalDevice = physicalDevices[0];
+		// the pipeline cache checks cache data headers against these
+		vkGetPhysicalDeviceProperties(context.physicalDevice, &m_PhysicalDeviceProperties);
 		return true;
 	}
 
@@ -199,6 +203,45 @@ namespace rhi
 
 		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+		std::vector<std::string> supportedDeviceExtensions;
+		uint32_t extCount = 0;
+		vkEnumerateDeviceExtensionProperties(context.physicalDevice, nullptr, &extCount, nullptr);
+		if (extCount > 0)
+		{
+			std::vector<VkExtensionProperties> extensions(extCount);
+			if (vkEnumerateDeviceExtensionProperties(context.physicalDevice, nullptr, &extCount, &extensions.front()) == VK_SUCCESS)
+			{
+				for (VkExtensionProperties& extension : extensions)
+				{
+					supportedDeviceExtensions.push_back(extension.extensionName);
+				}
+			}
+		}
+		auto enableOptionalExtension = [&](const char* name)
+			{
+				if (std::find(supportedDeviceExtensions.begin(), supportedDeviceExtensions.end(), name) == supportedDeviceExtensions.end())
+				{
+					return false;
+				}
+				deviceExtensions.push_back(name);
+				return true;
+			};
+		optionalExtensions.loadStoreOpNone = enableOptionalExtension(VK_EXT_LOAD_STORE_OP_NONE_EXTENSION_NAME);
+		optionalExtensions.pushDescriptor = enableOptionalExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		if (optionalExtensions.pushDescriptor)
+		{
+			VkPhysicalDevicePushDescriptorPropertiesKHR pushDescriptorProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PUSH_DESCRIPTOR_PROPERTIES_KHR };
+			VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+			properties2.pNext = &pushDescriptorProperties;
+			vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties2);
+			m_MaxPushDescriptors = pushDescriptorProperties.maxPushDescriptors;
+		}
+		{
+			VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+			properties2.pNext = &m_DepthStencilResolveProperties;
+			vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties2);
+		}
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.textureCompressionBC = true;
 		deviceFeatures.geometryShader = true;
@@ -208,16 +251,156 @@ namespace rhi
 		deviceFeatures.depthClamp = desc.enableDepthClamp;
 		deviceFeatures.samplerAnisotropy = desc.enableSamplerAnisotropy;
 		deviceFeatures.sampleRateShading = desc.enableSampleRateShading;
+		if (desc.mipDownsampleShaderCode)
+		{
+			VkPhysicalDeviceFeatures supportedFeatures{};
+			vkGetPhysicalDeviceFeatures(context.physicalDevice, &supportedFeatures);
+			deviceFeatures.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+			optionalFeatures.storageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+		}
 
 		VkPhysicalDeviceVulkan13Features feature13{};
 		feature13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
 		feature13.synchronization2 = true;
 		feature13.dynamicRendering = true;
+		{
+			// lets the pipeline cache of each thread skip its internal lock
+			VkPhysicalDeviceVulkan13Features supportedFeature13{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeature13;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+			feature13.pipelineCreationCacheControl = supportedFeature13.pipelineCreationCacheControl;
+			optionalFeatures.pipelineCreationCacheControl = supportedFeature13.pipelineCreationCacheControl;
+		}
+
+		VkPhysicalDeviceVulkan11Features feature11{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+		if (desc.enableMultiview)
+		{
+			VkPhysicalDeviceVulkan11Features supportedFeature11{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeature11;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+			if (supportedFeature11.multiview)
+			{
+				feature11.multiview = true;
+				optionalFeatures.multiview = true;
+			}
+			else
+			{
+				LOG_WARNING("Multiview is not supported by the device");
+			}
+		}
 
 		VkPhysicalDeviceVulkan12Features feature12{};
 		feature12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 		feature12.timelineSemaphore = true;
 		feature12.pNext = &feature13;
+		VkPhysicalDeviceVulkan12Features supportedFeature12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		{
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeature12;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+		}
+		feature12.drawIndirectCount = supportedFeature12.drawIndirectCount;
+		optionalFeatures.drawIndirectCount = supportedFeature12.drawIndirectCount;
+		if (desc.enableBindless)
+		{
+			if (supportedFeature12.descriptorIndexing && supportedFeature12.runtimeDescriptorArray &&
+				supportedFeature12.shaderSampledImageArrayNonUniformIndexing && supportedFeature12.shaderStorageBufferArrayNonUniformIndexing &&
+				supportedFeature12.descriptorBindingSampledImageUpdateAfterBind && supportedFeature12.descriptorBindingStorageBufferUpdateAfterBind &&
+				supportedFeature12.descriptorBindingUpdateUnusedWhilePending && supportedFeature12.descriptorBindingPartiallyBound &&
+				supportedFeature12.descriptorBindingVariableDescriptorCount)
+			{
+				feature12.descriptorIndexing = true;
+				feature12.runtimeDescriptorArray = true;
+				feature12.shaderSampledImageArrayNonUniformIndexing = true;
+				feature12.shaderStorageBufferArrayNonUniformIndexing = true;
+				feature12.descriptorBindingSampledImageUpdateAfterBind = true;
+				feature12.descriptorBindingStorageBufferUpdateAfterBind = true;
+				feature12.descriptorBindingUpdateUnusedWhilePending = true;
+				feature12.descriptorBindingPartiallyBound = true;
+				feature12.descriptorBindingVariableDescriptorCount = true;
+				optionalFeatures.descriptorIndexing = true;
+			}
+			else
+			{
+				LOG_WARNING("Descriptor indexing is not supported by the device, the bindless heap is disabled");
+			}
+		}
+
+		VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+		if (desc.enableExtendedDynamicState3)
+		{
+			VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeatures;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+			if (supportedFeatures.extendedDynamicState3PolygonMode && supportedFeatures.extendedDynamicState3DepthClampEnable &&
+				enableOptionalExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+			{
+				extendedDynamicState3Features.extendedDynamicState3PolygonMode = true;
+				extendedDynamicState3Features.extendedDynamicState3DepthClampEnable = true;
+				feature13.pNext = &extendedDynamicState3Features;
+				optionalExtensions.extendedDynamicState3 = true;
+			}
+			else
+			{
+				LOG_WARNING("VK_EXT_extended_dynamic_state3 is not supported, PolygonMode and DepthClampEnable can't be dynamic");
+			}
+		}
+
+		VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT };
+		if (desc.enableDescriptorBuffer)
+		{
+			VkPhysicalDeviceVulkan12Features supportedFeature12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			VkPhysicalDeviceDescriptorBufferFeaturesEXT supportedFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT };
+			supportedFeatures.pNext = &supportedFeature12;
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeatures;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+			if (supportedFeatures.descriptorBuffer && supportedFeature12.bufferDeviceAddress &&
+				enableOptionalExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME))
+			{
+				descriptorBufferFeatures.descriptorBuffer = true;
+				feature12.bufferDeviceAddress = true;
+				descriptorBufferFeatures.pNext = feature13.pNext;
+				feature13.pNext = &descriptorBufferFeatures;
+				optionalExtensions.descriptorBuffer = true;
+			}
+			else
+			{
+				LOG_WARNING("VK_EXT_descriptor_buffer is not supported, resource sets use descriptor pools");
+			}
+		}
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+		if (desc.enableGraphicsPipelineLibrary)
+		{
+			VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+			VkPhysicalDeviceFeatures2 features2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features2.pNext = &supportedFeatures;
+			vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features2);
+
+			VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT };
+			VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+			properties2.pNext = &libraryProperties;
+			vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties2);
+
+			// without fast linking a library pipeline costs as much as a full compile
+			if (supportedFeatures.graphicsPipelineLibrary && libraryProperties.graphicsPipelineLibraryFastLinking &&
+				enableOptionalExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+				enableOptionalExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+			{
+				graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = true;
+				graphicsPipelineLibraryFeatures.pNext = feature13.pNext;
+				feature13.pNext = &graphicsPipelineLibraryFeatures;
+				optionalExtensions.graphicsPipelineLibrary = true;
+			}
+			else
+			{
+				LOG_WARNING("VK_EXT_graphics_pipeline_library fast linking is not supported, graphics pipelines are compiled as a whole");
+			}
+		}
 
 		VkDeviceCreateInfo deviceCreateInfo{};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -226,7 +409,8 @@ namespace rhi
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 		deviceCreateInfo.queueCreateInfoCount = 1;
 		deviceCreateInfo.pQueueCreateInfos = &queueCI;
-		deviceCreateInfo.pNext = &feature12;
+		feature11.pNext = &feature12;
+		deviceCreateInfo.pNext = &feature11;
 
 		VkResult err = vkCreateDevice(context.physicalDevice, &deviceCreateInfo, nullptr, &context.device);
 		CHECK_VK_RESULT(err);
@@ -236,6 +420,24 @@ namespace rhi
 		}
 
 		vkGetDeviceQueue(context.device, queueFamilyIndex, 0, &queue);
+
+		if (optionalExtensions.extendedDynamicState3)
+		{
+			extensionFunctions.cmdSetPolygonMode = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(context.device, "vkCmdSetPolygonModeEXT"));
+			extensionFunctions.cmdSetDepthClampEnable = reinterpret_cast<PFN_vkCmdSetDepthClampEnableEXT>(vkGetDeviceProcAddr(context.device, "vkCmdSetDepthClampEnableEXT"));
+		}
+		if (optionalExtensions.pushDescriptor)
+		{
+			extensionFunctions.cmdPushDescriptorSet = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(context.device, "vkCmdPushDescriptorSetKHR"));
+		}
+		if (optionalExtensions.descriptorBuffer)
+		{
+			extensionFunctions.getDescriptorSetLayoutSize = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(context.device, "vkGetDescriptorSetLayoutSizeEXT"));
+			extensionFunctions.getDescriptorSetLayoutBindingOffset = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(context.device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+			extensionFunctions.getDescriptor = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(context.device, "vkGetDescriptorEXT"));
+			extensionFunctions.cmdBindDescriptorBuffers = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(context.device, "vkCmdBindDescriptorBuffersEXT"));
+			extensionFunctions.cmdSetDescriptorBufferOffsets = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(context.device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+		}
 		return true;
 	}
 
@@ -287,6 +489,10 @@ namespace rhi
 
 		VmaAllocatorCreateInfo allocatorCreateInfo = {};
 		allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		if (renderDevice->optionalExtensions.descriptorBuffer)
+		{
+			allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+		}
 		allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_3;
 		allocatorCreateInfo.physicalDevice = renderDevice->context.physicalDevice;
 		allocatorCreateInfo.device = renderDevice->context.device;
@@ -309,12 +515,211 @@ namespace rhi
 			delete renderDevice;
 			return nullptr;
 		}
+
+		renderDevice->m_DescriptorPoolAllocator = std::make_unique<DescriptorPoolAllocatorVk>(renderDevice->context, renderDevice->lastSubmittedID);
+
+		renderDevice->m_PipelineCache = std::make_unique<PipelineCacheVk>(renderDevice->context,
+			renderDevice->m_PhysicalDeviceProperties, renderDevice->optionalFeatures.pipelineCreationCacheControl);
+		if (!renderDevice->m_PipelineCache->init(createInfo.pipelineCacheFilePath))
+		{
+			delete renderDevice;
+			return nullptr;
+		}
+		renderDevice->m_PipelineCompiler = std::make_unique<PipelineCompilerVk>(*renderDevice, createInfo.pipelineCompileThreadCount);
+
+		// must exist before the first resource set layout is created
+		if (renderDevice->optionalExtensions.descriptorBuffer && !renderDevice->createDescriptorBuffer(createInfo))
+		{
+			delete renderDevice;
+			return nullptr;
+		}
+
+		if (renderDevice->optionalFeatures.descriptorIndexing && renderDevice->optionalExtensions.descriptorBuffer)
+		{
+			LOG_WARNING("The bindless heap is disabled, it can't be combined with the descriptor buffer");
+		}
+		else if (renderDevice->optionalFeatures.descriptorIndexing && !renderDevice->createBindlessHeap(createInfo))
+		{
+			delete renderDevice;
+			return nullptr;
+		}
+
+		if (createInfo.mipDownsampleShaderCode &&
+			!renderDevice->createMipDownsamplePipeline(createInfo.mipDownsampleShaderCode, createInfo.mipDownsampleShaderCodeSize))
+		{
+			delete renderDevice;
+			return nullptr;
+		}
 		return renderDevice;
 	}
 
+	bool RenderDeviceVk::createBindlessHeap(const RenderDeviceCreateInfo& createInfo)
+	{
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+		VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties2.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties2);
+
+		auto heapSize = [](uint32_t requested, uint32_t defaultSize, uint32_t limit)
+			{
+				return (std::min)(requested != 0 ? requested : defaultSize, limit);
+			};
+		uint32_t textureCount = heapSize(createInfo.maxBindlessTextures, 16384, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+		uint32_t bufferCount = heapSize(createInfo.maxBindlessBuffers, 16384, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers);
+		uint32_t samplerCount = heapSize(createInfo.maxBindlessSamplers, 256, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers);
+
+		m_BindlessHeap = std::make_unique<BindlessHeapVk>(context);
+		if (!m_BindlessHeap->init(textureCount, bufferCount, samplerCount))
+		{
+			m_BindlessHeap.reset();
+			return false;
+		}
+		return true;
+	}
+
+	bool RenderDeviceVk::createDescriptorBuffer(const RenderDeviceCreateInfo& createInfo)
+	{
+		VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT };
+		VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties2.pNext = &descriptorBufferProperties;
+		vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties2);
+
+		// samplers and resources share the buffer, so every offset must be in range for both
+		VkDeviceSize size = createInfo.descriptorBufferSize != 0 ? createInfo.descriptorBufferSize : 32ull * 1024 * 1024;
+		size = (std::min)({ size, descriptorBufferProperties.maxResourceDescriptorBufferRange, descriptorBufferProperties.maxSamplerDescriptorBufferRange });
+
+		m_DescriptorBuffer = std::make_unique<DescriptorBufferVk>(context, m_Allocator, extensionFunctions, lastSubmittedID);
+		if (!m_DescriptorBuffer->init(size, descriptorBufferProperties))
+		{
+			m_DescriptorBuffer.reset();
+			return false;
+		}
+		return true;
+	}
+
+	IResourceSetLayout* RenderDeviceVk::getBindlessResourceSetLayout() const
+	{
+		return m_BindlessHeap ? m_BindlessHeap->getResourceSetLayout() : nullptr;
+	}
+
+	IResourceSet* RenderDeviceVk::getBindlessResourceSet() const
+	{
+		return m_BindlessHeap ? m_BindlessHeap->getResourceSet() : nullptr;
+	}
+
+	uint32_t RenderDeviceVk::registerTexture(ITextureView* textureView)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		return m_BindlessHeap->registerTexture(textureView);
+	}
+
+	uint32_t RenderDeviceVk::registerBuffer(IBuffer* buffer)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		return m_BindlessHeap->registerBuffer(buffer);
+	}
+
+	uint32_t RenderDeviceVk::registerSampler(ISampler* sampler)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		return m_BindlessHeap->registerSampler(sampler);
+	}
+
+	void RenderDeviceVk::unregisterTexture(uint32_t index)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		m_BindlessHeap->unregisterTexture(index, lastSubmittedID);
+	}
+
+	void RenderDeviceVk::unregisterBuffer(uint32_t index)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		m_BindlessHeap->unregisterBuffer(index, lastSubmittedID);
+	}
+
+	void RenderDeviceVk::unregisterSampler(uint32_t index)
+	{
+		ASSERT_MSG(m_BindlessHeap, "The bindless heap needs RenderDeviceCreateInfo::enableBindless.");
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		m_BindlessHeap->unregisterSampler(index, lastSubmittedID);
+	}
+
+	bool RenderDeviceVk::createMipDownsamplePipeline(const uint32_t* code, size_t codeSize)
+	{
+		if (!optionalFeatures.storageImageWriteWithoutFormat)
+		{
+			LOG_WARNING("shaderStorageImageWriteWithoutFormat is not supported, generateMips can only use blits");
+			return true;
+		}
+
+		ShaderCreateInfo shaderCI{};
+		shaderCI.type = ShaderType::Compute;
+		shaderCI.entry = "main";
+		mipDownsample.shader.reset(createShader(shaderCI, code, codeSize));
+		if (!mipDownsample.shader)
+		{
+			return false;
+		}
+
+		ResourceSetLayoutBinding layoutBindings[] =
+		{
+			ResourceSetLayoutBinding::TextureWithSampler(ShaderType::Compute, 0),
+			ResourceSetLayoutBinding::StorageTexture(ShaderType::Compute, 1)
+		};
+		mipDownsample.resourceSetLayout.reset(createResourceSetLayout(layoutBindings, 2));
+		if (!mipDownsample.resourceSetLayout)
+		{
+			return false;
+		}
+
+		IResourceSetLayout* setLayouts[] = { mipDownsample.resourceSetLayout.get() };
+		ComputePipelineCreateInfo pipelineCI{};
+		pipelineCI.computeShader = mipDownsample.shader.get();
+		pipelineCI.resourceSetLayouts = setLayouts;
+		pipelineCI.resourceSetLayoutCount = 1;
+		pipelineCI.pushConstantDescs = nullptr;
+		pipelineCI.pushConstantCount = 0;
+		mipDownsample.pipeline.reset(createComputePipeline(pipelineCI));
+		if (!mipDownsample.pipeline)
+		{
+			return false;
+		}
+
+		// the default sampler is a linear clamp one
+		mipDownsample.sampler.reset(createSampler(SamplerDesc{}));
+		return mipDownsample.sampler != nullptr;
+	}
+
 	RenderDeviceVk::~RenderDeviceVk()
 	{
+		// stops the workers before anything they use is destroyed
+		m_PipelineCompiler.reset();
 		waitIdle();
+		mipDownsample = {};
+		m_BindlessHeap.reset();
+		m_DescriptorBuffer.reset();
+		if (m_PipelineCache && m_PipelineCache->hasFile())
+		{
+			m_PipelineCache->save();
+		}
+		m_PipelineCache.reset();
 
 		destroyDebugUtilsMessenger();
 		vmaDestroyAllocator(m_Allocator);
@@ -325,6 +730,25 @@ namespace rhi
 			delete commandBuffer;
 			commandBuffer = nullptr;
 		}
+		// after the command buffers, they return their internal resource sets to it
+		m_DescriptorPoolAllocator.reset();
+
+		for (auto& libraries : m_PipelineLibraries)
+		{
+			for (auto& [key, library] : libraries)
+			{
+				vkDestroyPipeline(context.device, library, nullptr);
+			}
+		}
+		for (auto& [key, pipelineLayout] : m_PipelineLayouts)
+		{
+			vkDestroyPipelineLayout(context.device, pipelineLayout, nullptr);
+		}
+
+		for (auto event : m_AllEvents)
+		{
+			vkDestroyEvent(context.device, event, nullptr);
+		}
 
 		vkDestroyDevice(context.device, nullptr);
 		vkDestroyInstance(context.instace, nullptr);
@@ -401,7 +825,7 @@ namespace rhi
 		}
 		if ((desc.usage & BufferUsage::StorageBuffer) != 0)
 		{
-			bufferCI.usage |= VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
+			bufferCI.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 		}
 		if ((desc.usage & BufferUsage::UniformTexelBuffer) != 0)
 		{
@@ -411,6 +835,13 @@ namespace rhi
 		{
 			bufferCI.usage |= VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
 		}
+		// descriptor buffers reference buffers by address
+		const bool needsDeviceAddress = m_DescriptorBuffer &&
+			(desc.usage & (BufferUsage::UniformBuffer | BufferUsage::StorageBuffer)) != 0;
+		if (needsDeviceAddress)
+		{
+			bufferCI.usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+		}
 
 		VmaAllocationCreateInfo allocCI{};
 		allocCI.usage = VMA_MEMORY_USAGE_AUTO;
@@ -434,7 +865,14 @@ namespace rhi
 		if (err != VK_SUCCESS)
 		{
 			delete buffer;
-			buffer = nullptr;
+			return nullptr;
+		}
+
+		if (needsDeviceAddress)
+		{
+			VkBufferDeviceAddressInfo addressInfo{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+			addressInfo.buffer = buffer->buffer;
+			buffer->deviceAddress = vkGetBufferDeviceAddress(context.device, &addressInfo);
 		}
 
 		return buffer;
@@ -516,6 +954,14 @@ namespace rhi
 		ShaderDesc desc{};
 		desc.entry = shaderCI.entry;
 		desc.type = shaderCI.type;
+		desc.hash = hashBytes(pCode, codeSize);
+		desc.hash = hashBytes(shaderCI.entry, strlen(shaderCI.entry), desc.hash);
+		for (uint32_t i = 0; i < shaderCI.specializationConstantCount; ++i)
+		{
+			const SpecializationConstant& constant = shaderCI.specializationConstants[i];
+			desc.hash = hashBytes(&constant.constantID, sizeof(constant.constantID), desc.hash);
+			desc.hash = hashBytes(&constant.value.u, sizeof(constant.value.u), desc.hash);
+		}
 
 		auto shader = new ShaderVk(context, desc);
 
@@ -531,6 +977,15 @@ namespace rhi
 			shader->specializationConstants.push_back(shaderCI.specializationConstants[i]);
 		}
 
+		if (err == VK_SUCCESS && shaderCI.reflect)
+		{
+			shader->reflection = std::make_unique<ShaderReflection>();
+			if (!reflectShader(pCode, codeSize, shaderCI.type, shaderCI.entry, *shader->reflection))
+			{
+				err = VK_ERROR_INITIALIZATION_FAILED;
+			}
+		}
+
 		if (err != VK_SUCCESS)
 		{
 			delete shader;
@@ -540,10 +995,53 @@ namespace rhi
 		return shader;
 	}
 
-	IResourceSetLayout* RenderDeviceVk::createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount)
+	// Size of one descriptor in the data of a descriptor update template.
+	static uint32_t getDescriptorDataStride(VkDescriptorType type)
+	{
+		switch (type)
+		{
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			return sizeof(VkDescriptorBufferInfo);
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			return sizeof(VkBufferView);
+		default:
+			return sizeof(VkDescriptorImageInfo);
+		}
+	}
+
+	IResourceSetLayout* RenderDeviceVk::createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount,
+		ResourceSetLayoutFlags flags)
 	{
 		assert(bindings != nullptr && bindingCount != 0);
+		const bool pushDescriptor = (flags & ResourceSetLayoutFlags::PushDescriptor) != 0;
+		if (pushDescriptor)
+		{
+			if (!optionalExtensions.pushDescriptor)
+			{
+				LOG_ERROR("ResourceSetLayoutFlags::PushDescriptor needs VK_KHR_push_descriptor");
+				return nullptr;
+			}
+			if (m_DescriptorBuffer)
+			{
+				LOG_ERROR("ResourceSetLayoutFlags::PushDescriptor can't be used with the descriptor buffer");
+				return nullptr;
+			}
+			uint32_t descriptorCount = 0;
+			for (uint32_t i = 0; i < bindingCount; ++i)
+			{
+				descriptorCount += bindings[i].arrayElementCount;
+			}
+			if (descriptorCount > m_MaxPushDescriptors)
+			{
+				LOG_ERROR("A push descriptor layout can have at most ", m_MaxPushDescriptors, " descriptors");
+				return nullptr;
+			}
+		}
+
 		auto resourceLayoutVk = new ResourceSetLayoutVk(context);
+		resourceLayoutVk->flags = flags;
 
 		std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings{ bindingCount };
 
@@ -558,6 +1056,13 @@ namespace rhi
 			binding.stageFlags = shaderTypeToVkShaderStageFlagBits(bindings[i].visibleStages);
 			// we will use them in ResourceSet creation
 			resourceLayoutVk->resourceSetLayoutBindings.push_back(bindings[i]);
+
+			if (bindings[i].bindingSlot >= resourceLayoutVk->bindingSlotToIndex.size())
+			{
+				resourceLayoutVk->bindingSlotToIndex.resize(bindings[i].bindingSlot + 1, UINT32_MAX);
+			}
+			resourceLayoutVk->bindingSlotToIndex[bindings[i].bindingSlot] = i;
+			resourceLayoutVk->descriptorCount += bindings[i].arrayElementCount;
 		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
@@ -565,6 +1070,11 @@ namespace rhi
 		descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(descriptorSetLayoutBindings.size());
 		descriptorSetLayoutCI.pBindings = descriptorSetLayoutBindings.data();
 		descriptorSetLayoutCI.pNext = nullptr;
+		descriptorSetLayoutCI.flags = pushDescriptor ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+		if (m_DescriptorBuffer)
+		{
+			descriptorSetLayoutCI.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		}
 
 		VkResult err = vkCreateDescriptorSetLayout(context.device, &descriptorSetLayoutCI, nullptr, &resourceLayoutVk->descriptorSetLayout);
 		CHECK_VK_RESULT(err, "Could not create ShaderBindingLayout");
@@ -574,6 +1084,62 @@ namespace rhi
 			return nullptr;
 		}
 
+		if (m_DescriptorBuffer)
+		{
+			m_DescriptorBuffer->initLayout(resourceLayoutVk);
+		}
+		else if (!pushDescriptor)
+		{
+			// count the number of descriptors required per type, sets with the same counts share descriptor pools
+			std::vector<VkDescriptorPoolSize> setPoolSizes;
+			for (const VkDescriptorSetLayoutBinding& binding : descriptorSetLayoutBindings)
+			{
+				auto it = std::find_if(setPoolSizes.begin(), setPoolSizes.end(),
+					[&](const VkDescriptorPoolSize& poolSize) { return poolSize.type == binding.descriptorType; });
+				if (it != setPoolSizes.end())
+				{
+					it->descriptorCount += binding.descriptorCount;
+				}
+				else
+				{
+					setPoolSizes.push_back(VkDescriptorPoolSize{ binding.descriptorType, binding.descriptorCount });
+				}
+			}
+			std::sort(setPoolSizes.begin(), setPoolSizes.end(),
+				[](const VkDescriptorPoolSize& a, const VkDescriptorPoolSize& b) { return a.type < b.type; });
+			resourceLayoutVk->descriptorPoolProfile = m_DescriptorPoolAllocator->getProfile(setPoolSizes);
+
+			// one entry per binding covering all of its array elements, packed back to back
+			std::vector<VkDescriptorUpdateTemplateEntry> templateEntries{ bindingCount };
+			uint32_t dataOffset = 0;
+			for (uint32_t i = 0; i < bindingCount; ++i)
+			{
+				auto& entry = templateEntries[i];
+				entry.dstBinding = descriptorSetLayoutBindings[i].binding;
+				entry.dstArrayElement = 0;
+				entry.descriptorCount = descriptorSetLayoutBindings[i].descriptorCount;
+				entry.descriptorType = descriptorSetLayoutBindings[i].descriptorType;
+				entry.offset = dataOffset;
+				entry.stride = getDescriptorDataStride(entry.descriptorType);
+				resourceLayoutVk->descriptorDataOffsets.push_back(dataOffset);
+				dataOffset += static_cast<uint32_t>(entry.stride) * entry.descriptorCount;
+			}
+			resourceLayoutVk->descriptorDataSize = dataOffset;
+
+			VkDescriptorUpdateTemplateCreateInfo templateCI{ VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
+			templateCI.descriptorUpdateEntryCount = bindingCount;
+			templateCI.pDescriptorUpdateEntries = templateEntries.data();
+			templateCI.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+			templateCI.descriptorSetLayout = resourceLayoutVk->descriptorSetLayout;
+			err = vkCreateDescriptorUpdateTemplate(context.device, &templateCI, nullptr, &resourceLayoutVk->descriptorUpdateTemplate);
+			CHECK_VK_RESULT(err, "Could not create descriptor update template");
+			if (err != VK_SUCCESS)
+			{
+				delete resourceLayoutVk;
+				return nullptr;
+			}
+		}
+
 		return resourceLayoutVk;
 	}
 
@@ -581,63 +1147,79 @@ namespace rhi
 	{
 		assert(layout);
 		const auto setLayout = checked_cast<const ResourceSetLayoutVk*>(layout);
-
-		// count the number of descriptors required per type
-		std::unordered_map<VkDescriptorType, uint32_t> descriptorTypeCountMap;
-		for (auto& layoutBinding : setLayout->resourceSetLayoutBindings)
+		if ((setLayout->flags & ResourceSetLayoutFlags::PushDescriptor) != 0)
 		{
-			VkDescriptorType type = shaderResourceTypeToVkDescriptorType(layoutBinding.type);
-			if (descriptorTypeCountMap.find(type) == descriptorTypeCountMap.end())
-			{
-				descriptorTypeCountMap[type] = 0;
-			}
-			descriptorTypeCountMap[type] += layoutBinding.arrayElementCount;
+			LOG_ERROR("Bindings of a PushDescriptor layout are recorded with ICommandList::pushResourceSet");
+			return nullptr;
 		}
 
-		std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
-		for (auto& iter : descriptorTypeCountMap)
+		if (m_DescriptorBuffer)
 		{
-			if (iter.second > 0)
+			auto resourceSet = new ResourceSetVk(context);
+			resourceSet->resourceSetLayout = setLayout;
+#if defined RHI_ENABLE_THREAD_RECORDING
+			std::lock_guard lock(m_Mutex);
+#endif
+			if (!m_DescriptorBuffer->allocate(resourceSet))
 			{
-				VkDescriptorPoolSize poolSize{};
-				poolSize.type = iter.first;
-				poolSize.descriptorCount = iter.second;
-				descriptorPoolSizes.push_back(poolSize);
+				delete resourceSet;
+				return nullptr;
 			}
+			resourceSet->descriptorBuffer = m_DescriptorBuffer.get();
+			return resourceSet;
 		}
 
 		auto resourceSet = new ResourceSetVk(context);
-
-
-		VkDescriptorPoolCreateInfo poolCI{};
-		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolCI.maxSets = 1;
-		poolCI.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
-		poolCI.pPoolSizes = descriptorPoolSizes.data();
-
-		VkResult err = vkCreateDescriptorPool(context.device, &poolCI, nullptr, &resourceSet->descriptorPool);
-		CHECK_VK_RESULT(err, "Could not create descriptorPool.");
-
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.pNext = nullptr;
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.pSetLayouts = &setLayout->descriptorSetLayout;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.descriptorPool = resourceSet->descriptorPool;
-
-		err = vkAllocateDescriptorSets(context.device, &allocInfo, &resourceSet->descriptorSet);
-		CHECK_VK_RESULT(err, "Could not create descriptorSet.");
-		if (err != VK_SUCCESS)
+		if (!m_DescriptorPoolAllocator->allocate(setLayout->descriptorPoolProfile, setLayout->descriptorSetLayout,
+			resourceSet->descriptorPool, resourceSet->descriptorSet))
 		{
 			delete resourceSet;
 			return nullptr;
 		}
-
+		resourceSet->descriptorPoolAllocator = m_DescriptorPoolAllocator.get();
 		resourceSet->resourceSetLayout = setLayout;
+		resourceSet->descriptorData.resize(setLayout->descriptorDataSize);
+		resourceSet->unwrittenDescriptorCount = setLayout->descriptorCount;
 
 		return resourceSet;
 	}
 
+	static bool isDescriptorDataWritten(const VkDescriptorImageInfo& info)
+	{
+		return info.imageView != VK_NULL_HANDLE || info.sampler != VK_NULL_HANDLE;
+	}
+
+	static bool isDescriptorDataWritten(const VkDescriptorBufferInfo& info)
+	{
+		return info.buffer != VK_NULL_HANDLE;
+	}
+
+	template<typename T>
+	static void writeDescriptorData(ResourceSetVk* resourceSet, uint8_t* data, const T& info)
+	{
+		T* entry = reinterpret_cast<T*>(data);
+		if (!isDescriptorDataWritten(*entry))
+		{
+			assert(resourceSet->unwrittenDescriptorCount > 0);
+			--resourceSet->unwrittenDescriptorCount;
+		}
+		*entry = info;
+	}
+
+	// Rewriting a descriptor replaces its entry, so the list doesn't grow when a set is updated.
+	static void setResourceNeedStateTransition(ResourceSetVk* resourceSet, const ResourceSetBinding& binding, ShaderType visibleStages)
+	{
+		for (auto& item : resourceSet->resourcesNeedStateTransition)
+		{
+			if (item.binding.bindingSlot == binding.bindingSlot && item.binding.arrayElementIndex == binding.arrayElementIndex)
+			{
+				item = ResourceSetBindngWithVisibleStages{ binding, visibleStages };
+				return;
+			}
+		}
+		resourceSet->resourcesNeedStateTransition.emplace_back(ResourceSetBindngWithVisibleStages{ binding, visibleStages });
+	}
+
 	void RenderDeviceVk::writeResourceSet(IResourceSet* set, const ResourceSetBinding* bindings, uint32_t bindingCount)
 	{
 		assert(set);
@@ -646,144 +1228,111 @@ namespace rhi
 
 		const ResourceSetLayoutVk* layout = resourceSet->resourceSetLayout;
 
-		std::vector<VkWriteDescriptorSet> descriptorSetWriters;
+		// Copy on write: a version that command lists may still read is retired and the set moves to a new one,
+		// which is then written from descriptorData, or from a copy of the old range in the descriptor buffer.
+		bool newVersion = false;
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::unique_lock referenceLock(resourceSet->referenceMutex, std::defer_lock);
+		if (resourceSet->isVersioned())
+		{
+			referenceLock.lock();
+		}
+#endif
+		if (resourceSet->isVersioned() && isResourceSetInUse(resourceSet))
+		{
+			ResourceSetVk::RetiredVersion version{ resourceSet->descriptorPool, resourceSet->descriptorSet, resourceSet->descriptorBufferOffset };
+			if (m_DescriptorBuffer)
+			{
+				if (!m_DescriptorBuffer->allocate(resourceSet))
+				{
+					return;
+				}
+				// the new range starts as a copy, the bindings of this call are written over it
+				m_DescriptorBuffer->copyDescriptors(version.descriptorBufferOffset, resourceSet);
+			}
+			else if (!m_DescriptorPoolAllocator->allocate(layout->descriptorPoolProfile, layout->descriptorSetLayout,
+				resourceSet->descriptorPool, resourceSet->descriptorSet))
+			{
+				return;
+			}
+			if (resourceSet->pendingReferenceCount > 0)
+			{
+				resourceSet->pendingRetiredVersions.push_back(version);
+			}
+			else
+			{
+				resourceSet->releaseVersion(version);
+			}
+			resourceSet->lastUsedExecuteID = 0;
+			++resourceSet->version;
+			newVersion = true;
+		}
 
 		for (uint32_t i = 0; i < bindingCount; ++i)
 		{
 			const ResourceSetBinding& binding = bindings[i];
 
-			auto checkValidBinding = [&](const ResourceSetLayoutBinding& layoutBinding)->bool
-				{
-					return layoutBinding.bindingSlot == binding.bindingSlot && layoutBinding.type == binding.type;
-				};
-
-			ShaderType bindingVisibleStages;
+			uint32_t layoutBindingIndex = binding.bindingSlot < layout->bindingSlotToIndex.size() ?
+				layout->bindingSlotToIndex[binding.bindingSlot] : UINT32_MAX;
+			if (layoutBindingIndex == UINT32_MAX || layout->resourceSetLayoutBindings[layoutBindingIndex].type != binding.type)
+			{
+				assert(!"Invalid ResourceSetBinding, make sure the bindingSlot and resourceType match those in the ResourceSetLayout.");
+				continue;
+			}
+			const ResourceSetLayoutBinding& layoutBinding = layout->resourceSetLayoutBindings[layoutBindingIndex];
+			assert(binding.arrayElementIndex < layoutBinding.arrayElementCount);
 
-			if (auto it = std::find_if(std::begin(layout->resourceSetLayoutBindings), std::end(layout->resourceSetLayoutBindings), checkValidBinding); it != std::end(layout->resourceSetLayoutBindings))
+			if (binding.type != ShaderResourceType::Sampler)
 			{
-				bindingVisibleStages = it->visibleStages;
+				setResourceNeedStateTransition(resourceSet, binding, layoutBinding.visibleStages);
 			}
-			else
+
+			if (m_DescriptorBuffer)
 			{
-				assert(!"Invalid ResourceSetBinding, make sure the bindingSlot and resourceType match those in the ResourceSetLayout.");
+				m_DescriptorBuffer->writeDescriptor(resourceSet, layoutBindingIndex, binding);
+				continue;
 			}
 
+			VkDescriptorType descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
+			uint8_t* data = resourceSet->descriptorData.data() + layout->descriptorDataOffsets[layoutBindingIndex] +
+				binding.arrayElementIndex * getDescriptorDataStride(descriptorType);
+
 			switch (binding.type)
 			{
 			case ShaderResourceType::SampledTexture:
-			{
-				assert(binding.textureView != nullptr);
-				auto textureView = checked_cast<TextureViewVk*>(binding.textureView);
-
-				VkDescriptorImageInfo descriptorImageInfo{};
-				descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				descriptorImageInfo.imageView = textureView->imageView;
-
-				auto& setWriter = descriptorSetWriters.emplace_back();
-				setWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				setWriter.pNext = nullptr;
-				setWriter.dstBinding = binding.bindingSlot;
-				setWriter.dstSet = resourceSet->descriptorSet;
-				setWriter.dstArrayElement = binding.arrayElementIndex;
-				setWriter.pImageInfo = &descriptorImageInfo;
-				setWriter.descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
-				setWriter.descriptorCount = 1;
-
-				resourceSet->resourcesNeedStateTransition.emplace_back(ResourceSetBindngWithVisibleStages{ binding, bindingVisibleStages });
-
-				break;
-			}
 			case ShaderResourceType::StorageTexture:
-			{
-				assert(binding.textureView != nullptr);
-				auto textureView = checked_cast<TextureViewVk*>(binding.textureView);
-
-				VkDescriptorImageInfo descriptorImageInfo{};
-				descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-				descriptorImageInfo.imageView = textureView->imageView;
-
-				auto& setWriter = descriptorSetWriters.emplace_back();
-				setWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				setWriter.pNext = nullptr;
-				setWriter.dstBinding = binding.bindingSlot;
-				setWriter.dstSet = resourceSet->descriptorSet;
-				setWriter.dstArrayElement = binding.arrayElementIndex;
-				setWriter.pImageInfo = &descriptorImageInfo;
-				setWriter.descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
-				setWriter.descriptorCount = 1;
-
-				resourceSet->resourcesNeedStateTransition.emplace_back(ResourceSetBindngWithVisibleStages{ binding, bindingVisibleStages });
-
-				break;
-			}
 			case ShaderResourceType::TextureWithSampler:
 			{
 				assert(binding.textureView != nullptr);
-				assert(binding.sampler != nullptr);
-				auto textureView = checked_cast<TextureViewVk*>(binding.textureView);
-
 				VkDescriptorImageInfo descriptorImageInfo{};
-				descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				descriptorImageInfo.imageView = textureView->imageView;
-				descriptorImageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
-
-				auto& setWriter = descriptorSetWriters.emplace_back();
-				setWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				setWriter.pNext = nullptr;
-				setWriter.dstBinding = binding.bindingSlot;
-				setWriter.dstSet = resourceSet->descriptorSet;
-				setWriter.dstArrayElement = binding.arrayElementIndex;
-				setWriter.pImageInfo = &descriptorImageInfo;
-				setWriter.descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
-				setWriter.descriptorCount = 1;
-
-				resourceSet->resourcesNeedStateTransition.emplace_back(ResourceSetBindngWithVisibleStages{ binding, bindingVisibleStages });
-
+				descriptorImageInfo.imageView = checked_cast<TextureViewVk*>(binding.textureView)->imageView;
+				descriptorImageInfo.imageLayout = binding.type == ShaderResourceType::StorageTexture ?
+					VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				if (binding.type == ShaderResourceType::TextureWithSampler)
+				{
+					assert(binding.sampler != nullptr);
+					descriptorImageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+				}
+				writeDescriptorData(resourceSet, data, descriptorImageInfo);
 				break;
 			}
 			case ShaderResourceType::StorageBuffer:
 			case ShaderResourceType::UniformBuffer:
 			{
 				assert(binding.buffer != nullptr);
-				auto buffer = checked_cast<BufferVk*>(binding.buffer);
-
 				VkDescriptorBufferInfo descriptorBufferInfo{};
-				descriptorBufferInfo.buffer = buffer->buffer;
+				descriptorBufferInfo.buffer = checked_cast<BufferVk*>(binding.buffer)->buffer;
 				descriptorBufferInfo.offset = binding.bufferOffset;
 				descriptorBufferInfo.range = binding.bufferRange == 0 ? VK_WHOLE_SIZE : binding.bufferRange;
-
-				auto& setWriter = descriptorSetWriters.emplace_back();
-				setWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				setWriter.pNext = nullptr;
-				setWriter.dstBinding = binding.bindingSlot;
-				setWriter.dstSet = resourceSet->descriptorSet;
-				setWriter.dstArrayElement = binding.arrayElementIndex;
-				setWriter.pBufferInfo = &descriptorBufferInfo;
-				setWriter.descriptorType = shaderResourceTypeToVkDescriptorType(binding.type);
-				setWriter.descriptorCount = 1;
-
-				resourceSet->resourcesNeedStateTransition.emplace_back(ResourceSetBindngWithVisibleStages{ binding, bindingVisibleStages });
-
+				writeDescriptorData(resourceSet, data, descriptorBufferInfo);
 				break;
 			}
 			case ShaderResourceType::Sampler:
 			{
 				assert(binding.sampler != nullptr);
-
-				auto sampler = checked_cast<SamplerVk*>(binding.sampler);
-
 				VkDescriptorImageInfo descriptorImageInfo{};
-				descriptorImageInfo.sampler = sampler->sampler;
-
-				auto& setWriter = descriptorSetWriters.emplace_back();
-				setWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				setWriter.pNext = nullptr;
-				setWriter.dstBinding = binding.bindingSlot;
-				setWriter.dstSet = resourceSet->descriptorSet;
-				setWriter.dstArrayElement = binding.arrayElementIndex;
-				setWriter.pImageInfo = &descriptorImageInfo;
-				setWriter.descriptorCount = 1;
-
+				descriptorImageInfo.sampler = checked_cast<SamplerVk*>(binding.sampler)->sampler;
+				writeDescriptorData(resourceSet, data, descriptorImageInfo);
 				break;
 			}
 			case ShaderResourceType::UniformTexelBuffer:
@@ -798,7 +1347,88 @@ namespace rhi
 			}
 		}
 
-		vkUpdateDescriptorSets(context.device, (uint32_t)descriptorSetWriters.size(), descriptorSetWriters.data(), 0, nullptr);
+		if (m_DescriptorBuffer)
+		{
+			return;
+		}
+
+		if (resourceSet->unwrittenDescriptorCount == 0)
+		{
+			vkUpdateDescriptorSetWithTemplate(context.device, resourceSet->descriptorSet, layout->descriptorUpdateTemplate,
+				resourceSet->descriptorData.data());
+			return;
+		}
+
+		// The template writes every descriptor of the set, so until all of them have been written they are updated
+		// one by one: the ones of this call, or every written one for a new version.
+		if (newVersion)
+		{
+			for (uint32_t i = 0; i < layout->resourceSetLayoutBindings.size(); ++i)
+			{
+				for (uint32_t element = 0; element < layout->resourceSetLayoutBindings[i].arrayElementCount; ++element)
+				{
+					writeDescriptorFromData(resourceSet, i, element, true);
+				}
+			}
+			return;
+		}
+		for (uint32_t i = 0; i < bindingCount; ++i)
+		{
+			const ResourceSetBinding& binding = bindings[i];
+			if (binding.bindingSlot < layout->bindingSlotToIndex.size() && layout->bindingSlotToIndex[binding.bindingSlot] != UINT32_MAX)
+			{
+				writeDescriptorFromData(resourceSet, layout->bindingSlotToIndex[binding.bindingSlot], binding.arrayElementIndex, false);
+			}
+		}
+	}
+
+	bool RenderDeviceVk::isResourceSetInUse(const ResourceSetVk* resourceSet) const
+	{
+		if (resourceSet->pendingReferenceCount > 0)
+		{
+			return true;
+		}
+		if (resourceSet->lastUsedExecuteID == 0)
+		{
+			return false;
+		}
+		uint64_t lastFinishedID = 0;
+		VkResult err = vkGetSemaphoreCounterValue(context.device, m_TrackingSubmittedSemaphore, &lastFinishedID);
+		CHECK_VK_RESULT(err);
+		return resourceSet->lastUsedExecuteID > lastFinishedID;
+	}
+
+	void RenderDeviceVk::writeDescriptorFromData(const ResourceSetVk* resourceSet, uint32_t layoutBindingIndex, uint32_t arrayElement,
+		bool skipUnwritten)
+	{
+		const ResourceSetLayoutVk* layout = resourceSet->resourceSetLayout;
+		const ResourceSetLayoutBinding& layoutBinding = layout->resourceSetLayoutBindings[layoutBindingIndex];
+
+		VkWriteDescriptorSet setWriter{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		setWriter.dstSet = resourceSet->descriptorSet;
+		setWriter.dstBinding = layoutBinding.bindingSlot;
+		setWriter.dstArrayElement = arrayElement;
+		setWriter.descriptorCount = 1;
+		setWriter.descriptorType = shaderResourceTypeToVkDescriptorType(layoutBinding.type);
+		const uint8_t* data = resourceSet->descriptorData.data() + layout->descriptorDataOffsets[layoutBindingIndex] +
+			arrayElement * getDescriptorDataStride(setWriter.descriptorType);
+		if (setWriter.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || setWriter.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		{
+			setWriter.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(data);
+			if (skipUnwritten && !isDescriptorDataWritten(*setWriter.pBufferInfo))
+			{
+				return;
+			}
+		}
+		else
+		{
+			setWriter.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(data);
+			if (skipUnwritten && !isDescriptorDataWritten(*setWriter.pImageInfo))
+			{
+				return;
+			}
+		}
+		vkUpdateDescriptorSets(context.device, 1, &setWriter, 0, nullptr);
 	}
 
 	static void resolveVertexInputOffsetAndStride(VertexInputAttribute* attributes, uint32_t attributeCount)
@@ -914,6 +1544,10 @@ namespace rhi
 		desc.viewportCount = pipelineCI.viewportCount;
 		desc.sampleCount = pipelineCI.sampleCount;
 		desc.patchControlPoints = pipelineCI.patchControlPoints;
+		desc.depthStencilState = pipelineCI.depthStencilState;
+		desc.primitiveRestartEnable = pipelineCI.primitiveRestartEnable;
+		desc.dynamicStates = pipelineCI.dynamicStates;
+		desc.viewMask = pipelineCI.viewMask;
 		for (uint32_t i = 0; i < pipelineCI.renderTargetFormatCount; ++i)
 		{
 			desc.renderTargetFormats[i] = pipelineCI.renderTargetFormats[i];
@@ -921,8 +1555,336 @@ namespace rhi
 		return desc;
 	}
 
+	static void appendVkDynamicStates(DynamicState dynamicStates, std::vector<VkDynamicState>& vkDynamicStates)
+	{
+		struct DynamicStateMapping
+		{
+			DynamicState state;
+			VkDynamicState vkState;
+		};
+		static const DynamicStateMapping mappings[] =
+		{
+			{ DynamicState::CullMode, VK_DYNAMIC_STATE_CULL_MODE },
+			{ DynamicState::FrontFace, VK_DYNAMIC_STATE_FRONT_FACE },
+			{ DynamicState::PrimitiveTopology, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY },
+			{ DynamicState::DepthTestEnable, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE },
+			{ DynamicState::DepthWriteEnable, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE },
+			{ DynamicState::DepthCompareOp, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP },
+			{ DynamicState::StencilTestEnable, VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE },
+			{ DynamicState::StencilOp, VK_DYNAMIC_STATE_STENCIL_OP },
+			{ DynamicState::DepthBiasEnable, VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE },
+			{ DynamicState::PrimitiveRestartEnable, VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE },
+			{ DynamicState::PolygonMode, VK_DYNAMIC_STATE_POLYGON_MODE_EXT },
+			{ DynamicState::DepthClampEnable, VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT },
+		};
+		for (const DynamicStateMapping& mapping : mappings)
+		{
+			if ((dynamicStates & mapping.state) != 0)
+			{
+				vkDynamicStates.push_back(mapping.vkState);
+			}
+		}
+	}
+
+	VkPipelineLayout RenderDeviceVk::getOrCreatePipelineLayout(IResourceSetLayout* const* resourceSetLayouts,
+		const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges)
+	{
+		// Pipeline layouts are compatible if their set layouts are identically defined, so the key is the content of the
+		// set layouts rather than their handles, which may be reused once a layout is destroyed.
+		std::vector<uint32_t> key;
+		for (size_t i = 0; i < descriptorSetLayouts.size(); ++i)
+		{
+			auto resourceSetLayout = checked_cast<ResourceSetLayoutVk*>(resourceSetLayouts[i]);
+			if (m_BindlessHeap && resourceSetLayout == m_BindlessHeap->getResourceSetLayout())
+			{
+				// created with UPDATE_AFTER_BIND, unlike any layout of createResourceSetLayout
+				key.push_back(UINT32_MAX);
+				continue;
+			}
+			key.push_back(static_cast<uint32_t>(resourceSetLayout->resourceSetLayoutBindings.size()));
+			key.push_back(static_cast<uint32_t>(resourceSetLayout->flags));
+			for (const ResourceSetLayoutBinding& binding : resourceSetLayout->resourceSetLayoutBindings)
+			{
+				key.push_back(binding.bindingSlot);
+				key.push_back(static_cast<uint32_t>(binding.type));
+				key.push_back(binding.arrayElementCount);
+				key.push_back(static_cast<uint32_t>(binding.visibleStages));
+			}
+		}
+		for (const VkPushConstantRange& range : pushConstantRanges)
+		{
+			key.push_back(range.stageFlags);
+			key.push_back(range.offset);
+			key.push_back(range.size);
+		}
+
+		std::lock_guard lock(m_PipelineLayoutMutex);
+		auto it = m_PipelineLayouts.find(key);
+		if (it != m_PipelineLayouts.end())
+		{
+			return it->second;
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+		pipelineLayoutCI.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
+		pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutCI.pSetLayouts = descriptorSetLayouts.data();
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkResult err = vkCreatePipelineLayout(context.device, &pipelineLayoutCI, nullptr, &pipelineLayout);
+		CHECK_VK_RESULT(err);
+		if (err != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+		m_PipelineLayouts.emplace(std::move(key), pipelineLayout);
+		return pipelineLayout;
+	}
+
+	// The state of pipelineCI that goes into one library part. The layouts are shared, so their handles identify them.
+	static std::vector<uint64_t> getPipelineLibraryKey(VkGraphicsPipelineLibraryFlagsEXT part, const GraphicsPipelineCreateInfo& pipelineCI,
+		VkPipelineLayout layout)
+	{
+		std::vector<uint64_t> key;
+		key.push_back(static_cast<uint64_t>(pipelineCI.dynamicStates));
+		switch (part)
+		{
+		case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+			key.push_back(static_cast<uint64_t>(pipelineCI.primType));
+			key.push_back(pipelineCI.primitiveRestartEnable);
+			for (uint32_t i = 0; i < pipelineCI.vertexInputAttributeCount; ++i)
+			{
+				const VertexInputAttribute& attribute = pipelineCI.vertexInputAttributes[i];
+				key.push_back(attribute.bindingBufferSlot);
+				key.push_back(attribute.location);
+				key.push_back(static_cast<uint64_t>(attribute.format));
+				key.push_back(attribute.isInstanced);
+				key.push_back(attribute.offsetInElement);
+				key.push_back(attribute.elementStride);
+			}
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+			key.push_back(reinterpret_cast<uint64_t>(layout));
+			key.push_back(getShaderHash(pipelineCI.vertexShader));
+			key.push_back(getShaderHash(pipelineCI.tessControlShader));
+			key.push_back(getShaderHash(pipelineCI.tessEvaluationShader));
+			key.push_back(getShaderHash(pipelineCI.geometryShader));
+			key.push_back(static_cast<uint64_t>(pipelineCI.rasterState.fillMode));
+			key.push_back(static_cast<uint64_t>(pipelineCI.rasterState.cullMode));
+			key.push_back(pipelineCI.rasterState.frontCounterClockwise);
+			key.push_back(pipelineCI.rasterState.depthClampEnable);
+			key.push_back(pipelineCI.rasterState.depthBiasEnable);
+			key.push_back(floatBits(pipelineCI.rasterState.lineWidth));
+			key.push_back(pipelineCI.viewportCount);
+			key.push_back(pipelineCI.primType == PrimitiveType::PatchList ? pipelineCI.patchControlPoints : 0);
+			key.push_back(pipelineCI.viewMask);
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+		{
+			key.push_back(reinterpret_cast<uint64_t>(layout));
+			key.push_back(getShaderHash(pipelineCI.fragmentShader));
+			const DepthStencilState& depthStencil = pipelineCI.depthStencilState;
+			key.push_back(depthStencil.depthTestEnable);
+			key.push_back(depthStencil.depthWriteEnable);
+			key.push_back(static_cast<uint64_t>(depthStencil.depthCompareOp));
+			key.push_back(depthStencil.stencilTestEnable);
+			for (const StencilOpState* state : { &depthStencil.frontFaceStencil, &depthStencil.backFaceStencil })
+			{
+				key.push_back(static_cast<uint64_t>(state->failOp));
+				key.push_back(static_cast<uint64_t>(state->passOp));
+				key.push_back(static_cast<uint64_t>(state->depthFailOp));
+				key.push_back(static_cast<uint64_t>(state->compareOp));
+				key.push_back(state->writeMask);
+				key.push_back(state->compareMak);
+				key.push_back(state->referenceValue);
+			}
+			key.push_back(pipelineCI.sampleCount);
+			key.push_back(pipelineCI.blendState.alphaToCoverageEnable);
+			key.push_back(static_cast<uint64_t>(pipelineCI.depthStencilFormat));
+			key.push_back(pipelineCI.viewMask);
+			break;
+		}
+		case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+			for (uint32_t i = 0; i < pipelineCI.renderTargetFormatCount; ++i)
+			{
+				const BlendState::RenderTargetBlendState& blend = pipelineCI.blendState.renderTargetBlendStates[i];
+				key.push_back(static_cast<uint64_t>(pipelineCI.renderTargetFormats[i]));
+				key.push_back(blend.blendEnable);
+				key.push_back(static_cast<uint64_t>(blend.srcColorBlend));
+				key.push_back(static_cast<uint64_t>(blend.destColorBlend));
+				key.push_back(static_cast<uint64_t>(blend.colorBlendOp));
+				key.push_back(static_cast<uint64_t>(blend.srcAlphaBlend));
+				key.push_back(static_cast<uint64_t>(blend.destAlphaBlend));
+				key.push_back(static_cast<uint64_t>(blend.alphaBlendOp));
+				key.push_back(static_cast<uint64_t>(blend.colorWriteMask));
+			}
+			key.push_back(static_cast<uint64_t>(pipelineCI.depthStencilFormat));
+			key.push_back(pipelineCI.sampleCount);
+			key.push_back(pipelineCI.blendState.alphaToCoverageEnable);
+			key.push_back(pipelineCI.viewMask);
+			break;
+		default:
+			assert(0);
+		}
+		return key;
+	}
+
+	VkPipeline RenderDeviceVk::getOrCreatePipelineLibrary(uint32_t part, std::vector<uint64_t> key, const VkGraphicsPipelineCreateInfo& libraryCI,
+		VkPipelineCache cache)
+	{
+		{
+			std::lock_guard lock(m_PipelineLibraryMutex);
+			auto it = m_PipelineLibraries[part].find(key);
+			if (it != m_PipelineLibraries[part].end())
+			{
+				return it->second;
+			}
+		}
+
+		// created without the lock, so other pipelines don't wait for the compilation
+		VkPipeline library = VK_NULL_HANDLE;
+		VkResult err = vkCreateGraphicsPipelines(context.device, cache, 1, &libraryCI, nullptr, &library);
+		CHECK_VK_RESULT(err, "Failed to create pipeline library.");
+		if (err != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+
+		std::lock_guard lock(m_PipelineLibraryMutex);
+		auto [it, inserted] = m_PipelineLibraries[part].try_emplace(std::move(key), library);
+		if (!inserted)
+		{
+			// another thread created the same part meanwhile
+			vkDestroyPipeline(context.device, library, nullptr);
+		}
+		return it->second;
+	}
+
+	bool RenderDeviceVk::createGraphicsPipelineFromLibraries(GraphicsPipelineVk* pipeline, const GraphicsPipelineCreateInfo& pipelineCI,
+		const VkGraphicsPipelineCreateInfo& createInfo, VkPipelineCache cache)
+	{
+		constexpr VkGraphicsPipelineLibraryFlagsEXT parts[] =
+		{
+			VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+		};
+
+		std::vector<VkPipelineShaderStageCreateInfo> preRasterizationStages;
+		std::vector<VkPipelineShaderStageCreateInfo> fragmentStages;
+		for (uint32_t i = 0; i < createInfo.stageCount; ++i)
+		{
+			auto& stages = createInfo.pStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT ? fragmentStages : preRasterizationStages;
+			stages.push_back(createInfo.pStages[i]);
+		}
+
+		std::array<VkPipeline, 4> libraries{};
+		for (uint32_t i = 0; i < libraries.size(); ++i)
+		{
+			VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+			libraryInfo.flags = parts[i];
+			libraryInfo.pNext = createInfo.pNext;
+
+			VkGraphicsPipelineCreateInfo libraryCI{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+			libraryCI.pNext = &libraryInfo;
+			// keeps what the link time optimization of the final pipeline needs
+			libraryCI.flags = createInfo.flags | VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+			libraryCI.pDynamicState = createInfo.pDynamicState;
+			switch (parts[i])
+			{
+			case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+				libraryCI.pVertexInputState = createInfo.pVertexInputState;
+				libraryCI.pInputAssemblyState = createInfo.pInputAssemblyState;
+				break;
+			case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+				libraryCI.stageCount = static_cast<uint32_t>(preRasterizationStages.size());
+				libraryCI.pStages = preRasterizationStages.data();
+				libraryCI.pViewportState = createInfo.pViewportState;
+				libraryCI.pRasterizationState = createInfo.pRasterizationState;
+				libraryCI.pTessellationState = createInfo.pTessellationState;
+				libraryCI.layout = createInfo.layout;
+				break;
+			case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+				libraryCI.stageCount = static_cast<uint32_t>(fragmentStages.size());
+				libraryCI.pStages = fragmentStages.data();
+				libraryCI.pDepthStencilState = createInfo.pDepthStencilState;
+				libraryCI.pMultisampleState = createInfo.pMultisampleState;
+				libraryCI.layout = createInfo.layout;
+				break;
+			default:
+				libraryCI.pColorBlendState = createInfo.pColorBlendState;
+				libraryCI.pMultisampleState = createInfo.pMultisampleState;
+				break;
+			}
+
+			libraries[i] = getOrCreatePipelineLibrary(i, getPipelineLibraryKey(parts[i], pipelineCI, createInfo.layout), libraryCI, cache);
+			if (libraries[i] == VK_NULL_HANDLE)
+			{
+				return false;
+			}
+		}
+
+		// Linking without optimization is fast enough to do on demand, the result runs slower than a monolithic pipeline.
+		VkPipelineLibraryCreateInfoKHR linkInfo{ VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+		linkInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+		linkInfo.pLibraries = libraries.data();
+		VkGraphicsPipelineCreateInfo linkCI{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+		linkCI.pNext = &linkInfo;
+		linkCI.flags = createInfo.flags;
+		linkCI.layout = createInfo.layout;
+		VkResult err = vkCreateGraphicsPipelines(context.device, cache, 1, &linkCI, nullptr, &pipeline->pipeline);
+		CHECK_VK_RESULT(err, "Failed to link pipeline.");
+		if (err != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		// The optimized pipeline replaces the fast-linked one once it is ready, the pipeline waits for it when destroyed.
+		auto optimize = [this, pipeline, libraries, flags = createInfo.flags, layout = createInfo.layout]()
+			{
+				VkPipelineLibraryCreateInfoKHR linkInfo{ VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+				linkInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+				linkInfo.pLibraries = libraries.data();
+				VkGraphicsPipelineCreateInfo linkCI{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+				linkCI.pNext = &linkInfo;
+				linkCI.flags = flags | VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+				linkCI.layout = layout;
+
+				VkPipeline optimizedPipeline = VK_NULL_HANDLE;
+				VkPipelineCache cache = m_PipelineCache->beginCreate(nullptr, 0);
+				VkResult err = vkCreateGraphicsPipelines(context.device, cache, 1, &linkCI, nullptr, &optimizedPipeline);
+				m_PipelineCache->endCreate(cache);
+				if (err != VK_SUCCESS)
+				{
+					LOG_ERROR("Failed to optimize the pipeline, the fast-linked pipeline stays in use");
+					return false;
+				}
+				pipeline->optimizedPipeline.store(optimizedPipeline, std::memory_order_release);
+				return true;
+			};
+		auto task = new PipelineCompileTaskVk(*m_PipelineCompiler, optimize, PipelineCompilePriority::Low);
+		pipeline->optimizeTask.reset(task);
+		m_PipelineCompiler->enqueue(task);
+		return true;
+	}
+
 	IGraphicsPipeline* RenderDeviceVk::createGraphicsPipeline(const GraphicsPipelineCreateInfo& pipelineCI)
 	{
+		// extended dynamic state 1 and 2 are core in Vulkan 1.3, 3 is an extension
+		if ((pipelineCI.dynamicStates & (DynamicState::PolygonMode | DynamicState::DepthClampEnable)) != 0 &&
+			!optionalExtensions.extendedDynamicState3)
+		{
+			LOG_ERROR("Dynamic PolygonMode and DepthClampEnable need VK_EXT_extended_dynamic_state3, see RenderDeviceCreateInfo::enableExtendedDynamicState3");
+			return nullptr;
+		}
+
+		if (pipelineCI.viewMask != 0 && !optionalFeatures.multiview)
+		{
+			LOG_ERROR("A viewMask needs the multiview feature, see RenderDeviceCreateInfo::enableMultiview");
+			return nullptr;
+		}
+
 		auto pipeline = new GraphicsPipelineVk(context);
 
 		// pipeline layout
@@ -931,6 +1893,11 @@ namespace rhi
 		{
 			auto resourceSetLayout = checked_cast<ResourceSetLayoutVk*>(pipelineCI.resourceSetLayouts[i]);
 			descriptorSetLayouts[i] = resourceSetLayout->descriptorSetLayout;
+			if ((resourceSetLayout->flags & ResourceSetLayoutFlags::PushDescriptor) != 0)
+			{
+				ASSERT_MSG(pipeline->pushDescriptorSetIndex == UINT32_MAX, "A pipeline can have only one PushDescriptor layout.");
+				pipeline->pushDescriptorSetIndex = i;
+			}
 		}
 		
 		std::vector<VkPushConstantRange> pushConstantRanges(pipelineCI.pushConstantCount);
@@ -948,15 +1915,11 @@ namespace rhi
 			usedStages = usedStages | pipelineCI.pushConstantDescs[i].stage;
 		}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutCI{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-		pipelineLayoutCI.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
-		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
-		pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutCI.pSetLayouts = descriptorSetLayouts.data();
-		VkResult err = vkCreatePipelineLayout(context.device, &pipelineLayoutCI, nullptr, &pipeline->pipelineLayout);
-		CHECK_VK_RESULT(err);
+		pipeline->pipelineLayout = getOrCreatePipelineLayout(pipelineCI.resourceSetLayouts, descriptorSetLayouts, pushConstantRanges);
+		VkResult err = pipeline->pipelineLayout != VK_NULL_HANDLE ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
 
 		VkGraphicsPipelineCreateInfo createInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+		createInfo.flags = m_DescriptorBuffer ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
 
 		// Rasterization state
 		VkPipelineRasterizationStateCreateInfo rasterizationStateCI{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
@@ -994,6 +1957,7 @@ namespace rhi
 
 		// Enable dynamic states
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		appendVkDynamicStates(pipelineCI.dynamicStates, dynamicStateEnables);
 		VkPipelineDynamicStateCreateInfo dynamicStateCI{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
 		dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
 		dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
@@ -1014,6 +1978,7 @@ namespace rhi
 		// vertex input 
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
 		inputAssemblyStateCI.topology = convertPrimitiveTopology(pipelineCI.primType);
+		inputAssemblyStateCI.primitiveRestartEnable = pipelineCI.primitiveRestartEnable;
 
 		resolveVertexInputOffsetAndStride(pipelineCI.vertexInputAttributes, pipelineCI.vertexInputAttributeCount);
 
@@ -1101,9 +2066,9 @@ namespace rhi
 		}
 
 		// tessellation 
+		VkPipelineTessellationStateCreateInfo tessellationStateCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
 		if (pipelineCI.primType == PrimitiveType::PatchList)
 		{
-			VkPipelineTessellationStateCreateInfo tessellationStateCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
 			tessellationStateCreateInfo.patchControlPoints = pipelineCI.patchControlPoints;
 			createInfo.pTessellationState = &tessellationStateCreateInfo;
 		}
@@ -1119,6 +2084,7 @@ namespace rhi
 		pipelineRenderingCI.pColorAttachmentFormats = colorAttachmentFormats.data();
 		pipelineRenderingCI.depthAttachmentFormat = formatToVkFormat(pipelineCI.depthStencilFormat);
 		pipelineRenderingCI.stencilAttachmentFormat = formatToVkFormat(pipelineCI.depthStencilFormat);
+		pipelineRenderingCI.viewMask = pipelineCI.viewMask;
 
 		createInfo.layout = pipeline->pipelineLayout;
 		createInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
@@ -1133,15 +2099,18 @@ namespace rhi
 		createInfo.pDynamicState = &dynamicStateCI;
 		createInfo.pNext = &pipelineRenderingCI;
 
-		VkPipelineCacheCreateInfo cacheCI{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-		cacheCI.initialDataSize = pipelineCI.cacheSize;
-		cacheCI.pInitialData = pipelineCI.cacheData;
-
-		err = vkCreatePipelineCache(context.device, &cacheCI, nullptr, &pipeline->pipelineCache);
-		CHECK_VK_RESULT(err, "Failed to create pipeline cache.");
-
-		err = vkCreateGraphicsPipelines(context.device, pipeline->pipelineCache, 1, &createInfo, nullptr, &pipeline->pipeline);
-		CHECK_VK_RESULT(err, "Failed to create pipeline.");
+		pipeline->pipelineCache = m_PipelineCache.get();
+		VkPipelineCache cache = m_PipelineCache->beginCreate(pipelineCI.cacheData, pipelineCI.cacheSize);
+		if (optionalExtensions.graphicsPipelineLibrary)
+		{
+			err = createGraphicsPipelineFromLibraries(pipeline, pipelineCI, createInfo, cache) ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+		}
+		else
+		{
+			err = vkCreateGraphicsPipelines(context.device, cache, 1, &createInfo, nullptr, &pipeline->pipeline);
+			CHECK_VK_RESULT(err, "Failed to create pipeline.");
+		}
+		m_PipelineCache->endCreate(cache);
 
 		pipeline->desc = getGraphicsPipelineDesc(pipelineCI);
 		if (err != VK_SUCCESS)
@@ -1163,6 +2132,11 @@ namespace rhi
 		{
 			auto resourceSetLayout = checked_cast<ResourceSetLayoutVk*>(pipelineCI.resourceSetLayouts[i]);
 			descriptorSetLayouts[i] = resourceSetLayout->descriptorSetLayout;
+			if ((resourceSetLayout->flags & ResourceSetLayoutFlags::PushDescriptor) != 0)
+			{
+				ASSERT_MSG(pipeline->pushDescriptorSetIndex == UINT32_MAX, "A pipeline can have only one PushDescriptor layout.");
+				pipeline->pushDescriptorSetIndex = i;
+			}
 		}
 
 		std::vector<VkPushConstantRange> pushConstantRanges(pipelineCI.pushConstantCount);
@@ -1176,13 +2150,8 @@ namespace rhi
 			offset += pushConstantRanges[i].size;
 		}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutCI{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-		pipelineLayoutCI.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
-		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
-		pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutCI.pSetLayouts = descriptorSetLayouts.data();
-		VkResult err = vkCreatePipelineLayout(context.device, &pipelineLayoutCI, nullptr, &pipeline->pipelineLayout);
-		CHECK_VK_RESULT(err);
+		pipeline->pipelineLayout = getOrCreatePipelineLayout(pipelineCI.resourceSetLayouts, descriptorSetLayouts, pushConstantRanges);
+		VkResult err = pipeline->pipelineLayout != VK_NULL_HANDLE ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
 
 		auto shader = checked_cast<ShaderVk*>(pipelineCI.computeShader);
 
@@ -1203,19 +2172,16 @@ namespace rhi
 		VkPipelineShaderStageCreateInfo shaderStageCI = getShaderStageCreateInfo(*shader, specializationMapEntries,
 			specializationInfo, specializationData);
 
-		VkPipelineCacheCreateInfo cacheCI{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-		cacheCI.initialDataSize = pipelineCI.cacheSize;
-		cacheCI.pInitialData = pipelineCI.cacheData;
-
-		err = vkCreatePipelineCache(context.device, &cacheCI, nullptr, &pipeline->pipelineCache);
-		CHECK_VK_RESULT(err, "Failed to create pipeline cache.");
-
 		VkComputePipelineCreateInfo computePipelineCI{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
 		computePipelineCI.stage = shaderStageCI;
 		computePipelineCI.layout = pipeline->pipelineLayout;
+		computePipelineCI.flags = m_DescriptorBuffer ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
 
-		err = vkCreateComputePipelines(context.device, pipeline->pipelineCache, 1, &computePipelineCI, nullptr, &pipeline->pipeline);
+		pipeline->pipelineCache = m_PipelineCache.get();
+		VkPipelineCache cache = m_PipelineCache->beginCreate(pipelineCI.cacheData, pipelineCI.cacheSize);
+		err = vkCreateComputePipelines(context.device, cache, 1, &computePipelineCI, nullptr, &pipeline->pipeline);
 		CHECK_VK_RESULT(err, "Failed to create pipeline.");
+		m_PipelineCache->endCreate(cache);
 		if (err != VK_SUCCESS)
 		{
 			delete pipeline;
@@ -1224,6 +2190,27 @@ namespace rhi
 		return pipeline;
 	}
 
+	bool RenderDeviceVk::savePipelineCache()
+	{
+		return m_PipelineCache->save();
+	}
+
+	IPipelineCompileTask* RenderDeviceVk::createGraphicsPipelineAsync(const GraphicsPipelineCreateInfo& pipelineCI,
+		PipelineCompilePriority priority)
+	{
+		auto task = new PipelineCompileTaskVk(*m_PipelineCompiler, pipelineCI, priority);
+		m_PipelineCompiler->enqueue(task);
+		return task;
+	}
+
+	IPipelineCompileTask* RenderDeviceVk::createComputePipelineAsync(const ComputePipelineCreateInfo& pipelineCI,
+		PipelineCompilePriority priority)
+	{
+		auto task = new PipelineCompileTaskVk(*m_PipelineCompiler, pipelineCI, priority);
+		m_PipelineCompiler->enqueue(task);
+		return task;
+	}
+
 	TextureVk* RenderDeviceVk::createTextureWithExistImage(const TextureDesc& desc, VkImage image)
 	{
 		assert(desc.format != Format::UNKNOWN);
@@ -1266,6 +2253,18 @@ namespace rhi
 			cmdList->updateSubmittedState();
 			hasGraphicPipeline = cmdList->hasSetGraphicPipeline();
 
+			const BarrierStatistics& barrierStatistics = cmdList->getBarrierStatistics();
+			m_BarrierStatistics.pipelineBarrierCount += barrierStatistics.pipelineBarrierCount;
+			m_BarrierStatistics.imageBarrierCount += barrierStatistics.imageBarrierCount;
+			m_BarrierStatistics.bufferBarrierCount += barrierStatistics.bufferBarrierCount;
+			m_BarrierStatistics.memoryBarrierCount += barrierStatistics.memoryBarrierCount;
+			m_BarrierStatistics.splitBarrierCount += barrierStatistics.splitBarrierCount;
+			m_BarrierStatistics.layoutTransitionCount += barrierStatistics.layoutTransitionCount;
+			m_BarrierStatistics.readToReadCount += barrierStatistics.readToReadCount;
+			m_BarrierStatistics.allCommandsCount += barrierStatistics.allCommandsCount;
+			m_BarrierStatistics.srcStageMask |= barrierStatistics.srcStageMask;
+			m_BarrierStatistics.dstStageMask |= barrierStatistics.dstStageMask;
+
 			CommandBuffer* cmdBuffer = cmdList->getCommandBuffer();
 			cmdBuffer->updateLastUsedExecuteID(lastSubmittedID);
 			cmdBuffer->submitID = lastSubmittedID;
@@ -1339,7 +2338,7 @@ namespace rhi
 	CommandBuffer* RenderDeviceVk::getOrCreateCommandBuffer()
 	{
 #if defined RHI_ENABLE_THREAD_RECORDING
-		std::lock_guard(m_Mutex);
+		std::lock_guard lock(m_Mutex);
 #endif
 		CommandBuffer* cmdBuf;
 		if (m_CommandBufferPool.empty())
@@ -1386,13 +2385,35 @@ namespace rhi
 		VkResult err = vkGetSemaphoreCounterValue(context.device, m_TrackingSubmittedSemaphore, &lastFinishedID);
 		CHECK_VK_RESULT(err);
 
+		if (m_BindlessHeap)
+		{
+#if defined RHI_ENABLE_THREAD_RECORDING
+			std::lock_guard lock(m_Mutex);
+#endif
+			m_BindlessHeap->recycle(lastFinishedID);
+		}
+		m_DescriptorPoolAllocator->recycle(lastFinishedID);
+		if (m_DescriptorBuffer)
+		{
+			m_DescriptorBuffer->recycle(lastFinishedID);
+		}
+
+		// the pools are shared with command lists opened on other threads
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
 		for (auto commandBuffer : submittedCmdBuf)
 		{
 			if (commandBuffer->submitID <= lastFinishedID)
 			{
 				commandBuffer->referencedInternalStageBuffer.clear();
+				commandBuffer->referencedInternalResourceSets.clear();
+				commandBuffer->referencedInternalTextureViews.clear();
 				commandBuffer->submitID = 0;
 				commandBuffer->resetLastUsedExecuteID();
+				// events were reset on the gpu right after they were waited on.
+				m_EventPool.insert(m_EventPool.end(), commandBuffer->referencedEvents.begin(), commandBuffer->referencedEvents.end());
+				commandBuffer->referencedEvents.clear();
 				m_CommandBufferPool.push_back(commandBuffer);
 			}
 			else
@@ -1401,4 +2422,32 @@ namespace rhi
 			}
 		}
 	}
+
+	VkEvent RenderDeviceVk::getOrCreateEvent()
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(m_Mutex);
+#endif
+		if (!m_EventPool.empty())
+		{
+			VkEvent event = m_EventPool.back();
+			m_EventPool.pop_back();
+			return event;
+		}
+
+		VkEventCreateInfo eventCI{ VK_STRUCTURE_TYPE_EVENT_CREATE_INFO };
+		// only signaled and waited on the device.
+		eventCI.flags = VK_EVENT_CREATE_DEVICE_ONLY_BIT;
+
+		VkEvent event = VK_NULL_HANDLE;
+		VkResult err = vkCreateEvent(context.device, &eventCI, nullptr, &event);
+		CHECK_VK_RESULT(err, "Could not create VkEvent");
+		if (err != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+
+		m_AllEvents.push_back(event);
+		return event;
+	}
 }
\ No newline at end of file
@@ -1,15 +1,66 @@
 #pragma once
 
 #include "rhi/rhi.h"
-#if defined RHI_ENABLE_THREAD_RECORDING
 #include <mutex>
-#endif
+#include <map>
 #include <vk_mem_alloc.h>
+#include <memory>
 #include "vk_resource.h"
+#include "vk_bindless_heap.h"
+#include "vk_descriptor_buffer.h"
+#include "vk_descriptor_pool.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipeline_compiler.h"
 
 namespace rhi
 {
 	class CommandBuffer;
+	class GraphicsPipelineVk;
+
+	// Optional device extensions, enabled when the physical device supports them.
+	struct OptionalExtensionsVk
+	{
+		bool loadStoreOpNone = false;
+		// Dynamic polygon mode and depth clamp.
+		bool extendedDynamicState3 = false;
+		bool pushDescriptor = false;
+		// Only enabled on request, resource sets then live in the descriptor buffer.
+		bool descriptorBuffer = false;
+		// Only enabled on request, graphics pipelines are then linked from cached libraries.
+		bool graphicsPipelineLibrary = false;
+	};
+
+	// Optional device features, enabled on request when the physical device supports them.
+	struct OptionalFeaturesVk
+	{
+		bool multiview = false;
+		bool storageImageWriteWithoutFormat = false;
+		bool descriptorIndexing = false;
+		bool pipelineCreationCacheControl = false;
+		bool drawIndirectCount = false;
+	};
+
+	// Entry points of optional extensions, null if the extension isn't enabled.
+	struct ExtensionFunctionsVk
+	{
+		PFN_vkCmdSetPolygonModeEXT cmdSetPolygonMode = nullptr;
+		PFN_vkCmdSetDepthClampEnableEXT cmdSetDepthClampEnable = nullptr;
+		PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet = nullptr;
+		PFN_vkGetDescriptorSetLayoutSizeEXT getDescriptorSetLayoutSize = nullptr;
+		PFN_vkGetDescriptorSetLayoutBindingOffsetEXT getDescriptorSetLayoutBindingOffset = nullptr;
+		PFN_vkGetDescriptorEXT getDescriptor = nullptr;
+		PFN_vkCmdBindDescriptorBuffersEXT cmdBindDescriptorBuffers = nullptr;
+		PFN_vkCmdSetDescriptorBufferOffsetsEXT cmdSetDescriptorBufferOffsets = nullptr;
+	};
+
+	// Compute pipeline of shaders/mip_downsample.comp, null if no SPIR-V was provided.
+	struct MipDownsamplePipelineVk
+	{
+		std::unique_ptr<IShader> shader;
+		std::unique_ptr<IResourceSetLayout> resourceSetLayout;
+		std::unique_ptr<IComputePipeline> pipeline;
+		std::unique_ptr<ISampler> sampler;
+	};
 
 	class RenderDeviceVk final : public IRenderDevice
 	{
@@ -18,15 +69,23 @@ namespace rhi
 		// Internal methods
 		static RenderDeviceVk* create(const RenderDeviceCreateInfo& desc);
 		const VkPhysicalDeviceProperties& getPhysicalDeviceProperties() const { return m_PhysicalDeviceProperties; }
+		const VkPhysicalDeviceDepthStencilResolveProperties& getDepthStencilResolveProperties() const { return m_DepthStencilResolveProperties; }
 		CommandBuffer* getOrCreateCommandBuffer();
 		void setSwapChainImageAvailableSeamaphore(const VkSemaphore& semaphore);
 		void setRenderCompleteSemaphore(const VkSemaphore& semaphore);
 		TextureVk* createTextureWithExistImage(const TextureDesc& desc, VkImage image);
 		void recycleCommandBuffers();
+		VkEvent getOrCreateEvent();
+		// Null unless resource sets live in a descriptor buffer.
+		const DescriptorBufferVk* getDescriptorBuffer() const { return m_DescriptorBuffer.get(); }
 
 		ContextVk context{};
 		VkQueue queue{ VK_NULL_HANDLE };
 		uint32_t queueFamilyIndex = UINT32_MAX;
+		OptionalExtensionsVk optionalExtensions;
+		OptionalFeaturesVk optionalFeatures;
+		ExtensionFunctionsVk extensionFunctions;
+		MipDownsamplePipelineVk mipDownsample;
 
 		uint64_t lastSubmittedID = 0;
 
@@ -41,16 +100,49 @@ namespace rhi
 		ICommandList* createCommandList() override;
 		uint64_t executeCommandLists(ICommandList** cmdLists, size_t numCmdLists) override;
 		void waitForExecution(uint64_t executeID, uint64_t timeout = UINT64_MAX) override;
-		IResourceSetLayout* createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount) override;
+		const BarrierStatistics& getBarrierStatistics() const override { return m_BarrierStatistics; }
+		void resetBarrierStatistics() override { m_BarrierStatistics = {}; }
+		bool isDrawIndirectCountSupported() const override { return optionalFeatures.drawIndirectCount; }
+		IResourceSetLayout* createResourceSetLayout(const ResourceSetLayoutBinding* bindings, uint32_t bindingCount,
+			ResourceSetLayoutFlags flags = ResourceSetLayoutFlags::None) override;
 		IResourceSet* createResourceSet(const IResourceSetLayout* layout) override;
 		void writeResourceSet(IResourceSet* set, const ResourceSetBinding* bindings, uint32_t bindingCount) override;
+		IResourceSetLayout* getBindlessResourceSetLayout() const override;
+		IResourceSet* getBindlessResourceSet() const override;
+		uint32_t registerTexture(ITextureView* textureView) override;
+		uint32_t registerBuffer(IBuffer* buffer) override;
+		uint32_t registerSampler(ISampler* sampler) override;
+		void unregisterTexture(uint32_t index) override;
+		void unregisterBuffer(uint32_t index) override;
+		void unregisterSampler(uint32_t index) override;
 		IGraphicsPipeline* createGraphicsPipeline(const GraphicsPipelineCreateInfo& pipelineCI) override;
 		IComputePipeline* createComputePipeline(const ComputePipelineCreateInfo& pipelineCI) override;
+		bool savePipelineCache() override;
+		IPipelineCompileTask* createGraphicsPipelineAsync(const GraphicsPipelineCreateInfo& pipelineCI,
+			PipelineCompilePriority priority = PipelineCompilePriority::Normal) override;
+		IPipelineCompileTask* createComputePipelineAsync(const ComputePipelineCreateInfo& pipelineCI,
+			PipelineCompilePriority priority = PipelineCompilePriority::Normal) override;
+		PipelineCompileStatistics getPipelineCompileStatistics() const override { return m_PipelineCompiler->getStatistics(); }
 	private:
 		RenderDeviceVk() = default;
 		bool createInstance(bool enableValidationLayer);
 		bool pickPhysicalDevice();
 		bool createDevice(const RenderDeviceCreateInfo& desc);
+		bool createMipDownsamplePipeline(const uint32_t* code, size_t codeSize);
+		bool createBindlessHeap(const RenderDeviceCreateInfo& createInfo);
+		bool createDescriptorBuffer(const RenderDeviceCreateInfo& createInfo);
+		bool isResourceSetInUse(const ResourceSetVk* resourceSet) const;
+		// Updates one descriptor of the set from ResourceSetVk::descriptorData.
+		void writeDescriptorFromData(const ResourceSetVk* resourceSet, uint32_t layoutBindingIndex, uint32_t arrayElement, bool skipUnwritten);
+		// Pipelines with identical layouts share one VkPipelineLayout, they live until the device is destroyed.
+		VkPipelineLayout getOrCreatePipelineLayout(IResourceSetLayout* const* resourceSetLayouts,
+			const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+		// Fast-links the pipeline from its four library parts and queues its link time optimized version.
+		bool createGraphicsPipelineFromLibraries(GraphicsPipelineVk* pipeline, const GraphicsPipelineCreateInfo& pipelineCI,
+			const VkGraphicsPipelineCreateInfo& createInfo, VkPipelineCache cache);
+		// Library parts are shared between pipelines, they live until the device is destroyed.
+		VkPipeline getOrCreatePipelineLibrary(uint32_t part, std::vector<uint64_t> key, const VkGraphicsPipelineCreateInfo& libraryCI,
+			VkPipelineCache cache);
 		void destroyDebugUtilsMessenger();
 #if defined RHI_ENABLE_THREAD_RECORDING
 		std::mutex m_Mutex;
@@ -59,6 +151,8 @@ namespace rhi
 
 		VkDebugUtilsMessengerEXT m_DebugUtilsMessenger{ VK_NULL_HANDLE };
 		VkPhysicalDeviceProperties m_PhysicalDeviceProperties{};
+		uint32_t m_MaxPushDescriptors = 0;
+		VkPhysicalDeviceDepthStencilResolveProperties m_DepthStencilResolveProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES };
 
 		VkSemaphore m_SwapChainImgAvailableSemaphore{ VK_NULL_HANDLE };
 
@@ -70,6 +164,23 @@ namespace rhi
 		std::vector<CommandBuffer*> m_CommandBufferInFlight;
 		std::vector<CommandBuffer*> m_CommandBufferPool;
 		std::vector<CommandBuffer*> m_AllCommandBuffers; // to release CommandBuffers
+
+		std::vector<VkEvent> m_EventPool;
+		std::vector<VkEvent> m_AllEvents; // to release VkEvents
+
+		BarrierStatistics m_BarrierStatistics;
+
+		std::unique_ptr<BindlessHeapVk> m_BindlessHeap;
+		std::unique_ptr<DescriptorBufferVk> m_DescriptorBuffer;
+		std::unique_ptr<DescriptorPoolAllocatorVk> m_DescriptorPoolAllocator;
+		std::unique_ptr<PipelineCacheVk> m_PipelineCache;
+		std::unique_ptr<PipelineCompilerVk> m_PipelineCompiler;
+		// always locked, pipelines are also created by the workers of m_PipelineCompiler
+		std::mutex m_PipelineLayoutMutex;
+		std::map<std::vector<uint32_t>, VkPipelineLayout> m_PipelineLayouts;
+		std::mutex m_PipelineLibraryMutex;
+		// indexed by the part, vertex input, pre-rasterization, fragment shader and fragment output
+		std::map<std::vector<uint64_t>, VkPipeline> m_PipelineLibraries[4];
 	};
 }
 
@@ -1,6 +1,9 @@
 #include "rhi/common/Error.h"
 #include "vk_resource.h"
+#include "vk_descriptor_pool.h"
+#include "vk_descriptor_buffer.h"
 
+#include <algorithm>
 #include <array>
 #include <unordered_map>
 #include "vk_errors.h"
@@ -240,6 +243,12 @@ namespace rhi
 
 		VkImageUsageFlags flags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
+		// read by resolveTexture, the blits of generateMips and blitTexture
+		if (desc.sampleCount > 1 || desc.mipLevels > 1 || (desc.usage & TextureUsage::CopySource) != 0)
+		{
+			flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+
 		if ((desc.usage & TextureUsage::ShaderResource) != 0)
 		{
 			flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -512,6 +521,122 @@ namespace rhi
 
 	// buffer
 
+	ResourceState BufferVk::getState() const
+	{
+		if (m_RangeStates.empty())
+		{
+			return m_State;
+		}
+
+		ResourceState state = ResourceState::Undefined;
+		for (const BufferRangeState& rangeState : m_RangeStates)
+		{
+			state = state | rangeState.state;
+		}
+		return state;
+	}
+
+	ResourceState BufferVk::getRangeState(uint64_t offset, uint64_t size) const
+	{
+		assert(offset + size <= desc.size);
+		if (m_RangeStates.empty())
+		{
+			return m_State;
+		}
+
+		ResourceState state = ResourceState::Undefined;
+		const uint64_t end = offset + size;
+		for (const BufferRangeState& rangeState : m_RangeStates)
+		{
+			if (rangeState.offset < end && rangeState.offset + rangeState.size > offset)
+			{
+				state = state | rangeState.state;
+			}
+		}
+		return state;
+	}
+
+	void BufferVk::getRangeStates(uint64_t offset, uint64_t size, std::vector<BufferRangeState>& rangeStates) const
+	{
+		assert(offset + size <= desc.size);
+		if (m_RangeStates.empty())
+		{
+			rangeStates.push_back({ offset, size, m_State });
+			return;
+		}
+
+		const uint64_t end = offset + size;
+		for (const BufferRangeState& rangeState : m_RangeStates)
+		{
+			uint64_t overlapBegin = (std::max)(offset, rangeState.offset);
+			uint64_t overlapEnd = (std::min)(end, rangeState.offset + rangeState.size);
+			if (overlapBegin < overlapEnd)
+			{
+				rangeStates.push_back({ overlapBegin, overlapEnd - overlapBegin, rangeState.state });
+			}
+		}
+	}
+
+	void BufferVk::setRangeState(uint64_t offset, uint64_t size, ResourceState state)
+	{
+		assert(offset + size <= desc.size);
+		if (size == 0)
+		{
+			return;
+		}
+		if (offset == 0 && size == desc.size)
+		{
+			setState(state);
+			return;
+		}
+
+		if (m_RangeStates.empty())
+		{
+			m_RangeStates.push_back({ 0, desc.size, m_State });
+		}
+
+		// Updated in place: the ranges overlapping [offset, end) are split at its bounds and replaced by one range.
+		auto endsAfter = [](uint64_t value, const BufferRangeState& range) { return value < range.offset + range.size; };
+		const uint64_t end = offset + size;
+		size_t first = std::upper_bound(m_RangeStates.begin(), m_RangeStates.end(), offset, endsAfter) - m_RangeStates.begin();
+		if (m_RangeStates[first].offset < offset)
+		{
+			BufferRangeState& range = m_RangeStates[first];
+			BufferRangeState head{ range.offset, offset - range.offset, range.state };
+			range.offset = offset;
+			range.size -= head.size;
+			m_RangeStates.insert(m_RangeStates.begin() + first, head);
+			++first;
+		}
+		size_t last = std::upper_bound(m_RangeStates.begin() + first, m_RangeStates.end(), end - 1, endsAfter) - m_RangeStates.begin();
+		if (m_RangeStates[last].offset + m_RangeStates[last].size > end)
+		{
+			BufferRangeState& range = m_RangeStates[last];
+			BufferRangeState tail{ end, range.offset + range.size - end, range.state };
+			range.size = end - range.offset;
+			m_RangeStates.insert(m_RangeStates.begin() + last + 1, tail);
+		}
+		m_RangeStates[first] = { offset, size, state };
+		m_RangeStates.erase(m_RangeStates.begin() + first + 1, m_RangeStates.begin() + last + 1);
+
+		// merge adjacent ranges that end up in the same state.
+		if (first + 1 < m_RangeStates.size() && m_RangeStates[first + 1].state == state)
+		{
+			m_RangeStates[first].size += m_RangeStates[first + 1].size;
+			m_RangeStates.erase(m_RangeStates.begin() + first + 1);
+		}
+		if (first > 0 && m_RangeStates[first - 1].state == state)
+		{
+			m_RangeStates[first - 1].size += m_RangeStates[first].size;
+			m_RangeStates.erase(m_RangeStates.begin() + first);
+		}
+
+		if (m_RangeStates.size() == 1)
+		{
+			setState(m_RangeStates[0].state);
+		}
+	}
+
 	BufferVk::~BufferVk()
 	{
 		assert(buffer != VK_NULL_HANDLE);
@@ -676,8 +801,70 @@ namespace rhi
 
 	ResourceSetVk::~ResourceSetVk()
 	{
-		assert(descriptorPool != VK_NULL_HANDLE);
-		vkDestroyDescriptorPool(m_Context.device, descriptorPool, nullptr);
+		if (isVersioned())
+		{
+			for (const RetiredVersion& version : pendingRetiredVersions)
+			{
+				releaseVersion(version);
+			}
+			releaseVersion(RetiredVersion{ descriptorPool, descriptorSet, descriptorBufferOffset });
+		}
+		else if (descriptorPool != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorPool(m_Context.device, descriptorPool, nullptr);
+		}
+	}
+
+	void ResourceSetVk::releaseVersion(const RetiredVersion& version)
+	{
+		if (descriptorPoolAllocator != nullptr)
+		{
+			descriptorPoolAllocator->release(version.pool, version.set);
+		}
+		else
+		{
+			descriptorBuffer->release(version.descriptorBufferOffset, resourceSetLayout->descriptorBufferSize);
+		}
+	}
+
+	void ResourceSetVk::addReference()
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(referenceMutex);
+#endif
+		++pendingReferenceCount;
+	}
+
+	void ResourceSetVk::markSubmitted(uint64_t executeID)
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(referenceMutex);
+#endif
+		// another thread may have submitted a later execute ID already
+		lastUsedExecuteID = (std::max)(lastUsedExecuteID, executeID);
+		// retired with the last submitted execute ID, which is at least executeID
+		releaseReferenceLocked();
+	}
+
+	void ResourceSetVk::releaseReference()
+	{
+#if defined RHI_ENABLE_THREAD_RECORDING
+		std::lock_guard lock(referenceMutex);
+#endif
+		releaseReferenceLocked();
+	}
+
+	void ResourceSetVk::releaseReferenceLocked()
+	{
+		assert(pendingReferenceCount > 0);
+		if (--pendingReferenceCount == 0)
+		{
+			for (const RetiredVersion& version : pendingRetiredVersions)
+			{
+				releaseVersion(version);
+			}
+			pendingRetiredVersions.clear();
+		}
 	}
 
 	Object ResourceSetLayoutVk::getNativeObject(NativeObjectType type) const
@@ -692,6 +879,10 @@ namespace rhi
 	ResourceSetLayoutVk::~ResourceSetLayoutVk()
 	{
 		assert(descriptorSetLayout != VK_NULL_HANDLE);
+		if (descriptorUpdateTemplate != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorUpdateTemplate(m_Context.device, descriptorUpdateTemplate, nullptr);
+		}
 		vkDestroyDescriptorSetLayout(m_Context.device, descriptorSetLayout, nullptr);
 	}
 
@@ -836,4 +1027,58 @@ namespace rhi
 
 		return val;
 	}
+
+	VkAttachmentLoadOp convertVkAttachmentLoadOp(AttachmentLoadOp op)
+	{
+		switch (op)
+		{
+		case AttachmentLoadOp::Load:
+			return VK_ATTACHMENT_LOAD_OP_LOAD;
+		case AttachmentLoadOp::Clear:
+			return VK_ATTACHMENT_LOAD_OP_CLEAR;
+		case AttachmentLoadOp::DontCare:
+			return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		case AttachmentLoadOp::None:
+			return VK_ATTACHMENT_LOAD_OP_NONE_EXT;
+		default:
+			assert(!"unknown AttachmentLoadOp");
+			return VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+	}
+
+	VkAttachmentStoreOp convertVkAttachmentStoreOp(AttachmentStoreOp op)
+	{
+		switch (op)
+		{
+		case AttachmentStoreOp::Store:
+			return VK_ATTACHMENT_STORE_OP_STORE;
+		case AttachmentStoreOp::DontCare:
+			return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		case AttachmentStoreOp::None:
+			return VK_ATTACHMENT_STORE_OP_NONE;
+		default:
+			assert(!"unknown AttachmentStoreOp");
+			return VK_ATTACHMENT_STORE_OP_STORE;
+		}
+	}
+
+	VkResolveModeFlagBits convertVkResolveMode(ResolveMode mode)
+	{
+		switch (mode)
+		{
+		case ResolveMode::None:
+			return VK_RESOLVE_MODE_NONE;
+		case ResolveMode::Average:
+			return VK_RESOLVE_MODE_AVERAGE_BIT;
+		case ResolveMode::SampleZero:
+			return VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+		case ResolveMode::Min:
+			return VK_RESOLVE_MODE_MIN_BIT;
+		case ResolveMode::Max:
+			return VK_RESOLVE_MODE_MAX_BIT;
+		default:
+			assert(!"unknown ResolveMode");
+			return VK_RESOLVE_MODE_NONE;
+		}
+	}
 }
\ No newline at end of file
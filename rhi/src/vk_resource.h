@@ -1,14 +1,21 @@
 #pragma once
 
 #include "rhi/rhi.h"
+#include "rhi/shader_reflection.h"
 
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 
 #include <vector>
+#if defined RHI_ENABLE_THREAD_RECORDING
+#include <mutex>
+#endif
 
 namespace rhi
 {
+	class DescriptorPoolAllocatorVk;
+	class DescriptorBufferVk;
+
 	class MemoryResource
 	{
 	public:
@@ -130,6 +137,13 @@ namespace rhi
 		const ContextVk& m_Context;
 	};
 
+	struct BufferRangeState
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		ResourceState state = ResourceState::Undefined;
+	};
+
 	class BufferVk : public IBuffer, public MemoryResource
 	{
 	public:
@@ -137,8 +151,14 @@ namespace rhi
 			:m_Context(context),
 			m_Allocator(allocator)
 		{}
-		void setState(ResourceState state) { m_State = state; }
-		ResourceState getState() const override { return m_State; }
+		void setState(ResourceState state) { m_State = state; m_RangeStates.clear(); }
+		// If parts of the buffer are in different states, returns the combination of all of them, which is no single valid
+		// state. Use getRangeState or getRangeStates to inspect the parts.
+		ResourceState getState() const override;
+		ResourceState getRangeState(uint64_t offset, uint64_t size) const override;
+		// Appends the sub ranges of [offset, offset + size) together with their current state.
+		void getRangeStates(uint64_t offset, uint64_t size, std::vector<BufferRangeState>& rangeStates) const;
+		void setRangeState(uint64_t offset, uint64_t size, ResourceState state);
 		const BufferDesc& getDesc() const override { return desc; }
 		Object getNativeObject(NativeObjectType type) const override;
 		~BufferVk();
@@ -148,10 +168,14 @@ namespace rhi
 		BufferDesc desc;
 		VkBuffer buffer = nullptr;
 		VmaAllocationInfo allocaionInfo{};
+		// Only queried for uniform and storage buffers when the device uses a descriptor buffer.
+		VkDeviceAddress deviceAddress = 0;
 	private:
 		const ContextVk& m_Context;
 		const VmaAllocator& m_Allocator;
 		ResourceState m_State = ResourceState::Undefined;
+		// Sorted, non overlapping and covering the whole buffer. Empty while the whole buffer is in m_State.
+		std::vector<BufferRangeState> m_RangeStates;
 	};
 
 	// shader
@@ -165,9 +189,11 @@ namespace rhi
 		~ShaderVk();
 		Object getNativeObject(NativeObjectType type) const override;
 		const ShaderDesc& getDesc() const override { return m_Desc; }
+		const ShaderReflection* getReflection() const override { return reflection.get(); }
 
 		VkShaderModule shaderModule = VK_NULL_HANDLE;
 		std::vector<SpecializationConstant> specializationConstants;
+		std::unique_ptr<ShaderReflection> reflection;
 	private:
 		const ContextVk& m_Context;
 		ShaderDesc m_Desc;
@@ -182,8 +208,25 @@ namespace rhi
 			:m_Context(context) {}
 		~ResourceSetLayoutVk();
 		Object getNativeObject(NativeObjectType type) const override;
+		const ResourceSetLayoutBinding* getBindings() const override { return resourceSetLayoutBindings.data(); }
+		uint32_t getBindingCount() const override { return static_cast<uint32_t>(resourceSetLayoutBindings.size()); }
+		ResourceSetLayoutFlags getFlags() const override { return flags; }
 		VkDescriptorSetLayout descriptorSetLayout = nullptr;
 		std::vector<ResourceSetLayoutBinding> resourceSetLayoutBindings;
+		ResourceSetLayoutFlags flags = ResourceSetLayoutFlags::None;
+		// Index into resourceSetLayoutBindings for every binding slot, UINT32_MAX for unused slots.
+		std::vector<uint32_t> bindingSlotToIndex;
+		uint32_t descriptorCount = 0;
+		// Profile of the shared descriptor pools the sets of this layout are allocated from.
+		uint32_t descriptorPoolProfile = UINT32_MAX;
+		// Writes a whole set from ResourceSetVk::descriptorData. The data offsets are in the order of resourceSetLayoutBindings,
+		// every binding holds arrayElementCount VkDescriptorImageInfo or VkDescriptorBufferInfo.
+		VkDescriptorUpdateTemplate descriptorUpdateTemplate = VK_NULL_HANDLE;
+		uint32_t descriptorDataSize = 0;
+		std::vector<uint32_t> descriptorDataOffsets;
+		// Only used with a descriptor buffer. The binding offsets are in the order of resourceSetLayoutBindings.
+		VkDeviceSize descriptorBufferSize = 0;
+		std::vector<VkDeviceSize> descriptorBufferBindingOffsets;
 	private:
 		const ContextVk& m_Context;
 	};
@@ -201,10 +244,50 @@ namespace rhi
 			:m_Context(context) {}
 		~ResourceSetVk();
 		Object getNativeObject(NativeObjectType type) const override;
+		// Called when a command list records a bind of a versioned set.
+		void addReference();
+		// Called when a command list that bound the set is submitted.
+		void markSubmitted(uint64_t executeID);
+		// Drops a bind of a command list that is reset or destroyed without being submitted.
+		void releaseReference();
+		// Pool or descriptor buffer backed, writes while in use move the set to a new version.
+		bool isVersioned() const { return descriptorPoolAllocator != nullptr || descriptorBuffer != nullptr; }
 		VkDescriptorPool descriptorPool = nullptr;
 		VkDescriptorSet descriptorSet = nullptr;
+		// The set is returned to it on destruction. Null if the set owns descriptorPool.
+		DescriptorPoolAllocatorVk* descriptorPoolAllocator = nullptr;
+		// Every descriptor of the set as written by writeResourceSet, the source of the layout's update template.
+		std::vector<uint8_t> descriptorData;
+		uint32_t unwrittenDescriptorCount = 0;
+
+		// Writing a set that may still be in use replaces descriptorSet with a new version instead.
+		struct RetiredVersion
+		{
+			VkDescriptorPool pool = VK_NULL_HANDLE;
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			VkDeviceSize descriptorBufferOffset = 0;
+		};
+		void releaseVersion(const RetiredVersion& version);
+		// Expects referenceMutex to be locked.
+		void releaseReferenceLocked();
+		// Incremented with every new version, command lists rebind a set whose version changed since they bound it.
+		uint32_t version = 0;
+		uint64_t lastUsedExecuteID = 0;
+		// Binds recorded by command lists that aren't submitted yet.
+		uint32_t pendingReferenceCount = 0;
+		// Versions replaced while pendingReferenceCount wasn't 0, released once it drops to 0.
+		std::vector<RetiredVersion> pendingRetiredVersions;
+#if defined RHI_ENABLE_THREAD_RECORDING
+		// Guards lastUsedExecuteID, pendingReferenceCount and pendingRetiredVersions. Command lists on different threads
+		// may bind, submit and reset with the same set and race with writeResourceSet on another thread. Writing a set
+		// while another thread binds it still has to be synchronized by the caller.
+		std::mutex referenceMutex;
+#endif
 		const ResourceSetLayoutVk* resourceSetLayout = nullptr;
 		std::vector<ResourceSetBindngWithVisibleStages> resourcesNeedStateTransition;
+		// With a descriptor buffer there is no pool and set, the descriptors live at this offset of the buffer.
+		DescriptorBufferVk* descriptorBuffer = nullptr;
+		VkDeviceSize descriptorBufferOffset = 0;
 	private:
 		const ContextVk& m_Context;
 	};
@@ -244,4 +327,8 @@ namespace rhi
 	VkBorderColor convertVkBorderColor(BorderColor color);
 
 	VkClearColorValue convertVkClearColor(ClearColor color, Format textureFormat);
+
+	VkAttachmentLoadOp convertVkAttachmentLoadOp(AttachmentLoadOp op);
+	VkAttachmentStoreOp convertVkAttachmentStoreOp(AttachmentStoreOp op);
+	VkResolveModeFlagBits convertVkResolveMode(ResolveMode mode);
 }
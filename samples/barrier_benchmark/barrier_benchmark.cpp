@@ -0,0 +1,123 @@
+#include <memory>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+#include <rhi/rhi.h>
+
+using namespace rhi;
+
+// Measures the CPU cost of collecting barriers on a command list.
+// Every iteration transitions each resource twice before a single commit,
+// which exercises the merge path of the pending barrier lists.
+
+static void messageCallback(MessageSeverity severity, const char* msg)
+{
+	std::cerr << msg;
+}
+
+static double recordTransitions(IRenderDevice* device, ICommandList* cmdList,
+	const std::vector<IBuffer*>& buffers, const std::vector<ITexture*>& textures, uint32_t iterations)
+{
+	double totalMs = 0.0;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		cmdList->open();
+		cmdList->setResourceAutoTransition(false);
+
+		// alternate the first state so every iteration produces real transitions
+		ResourceState bufferState = (i & 1) ? ResourceState::ShaderResource : ResourceState::UnorderedAccess;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto buffer : buffers)
+		{
+			cmdList->transitionBufferState(buffer, bufferState);
+			cmdList->transitionBufferState(buffer, ResourceState::IndirectBuffer);
+		}
+		for (auto texture : textures)
+		{
+			cmdList->transitionTextureState(texture, ResourceState::UnorderedAccess);
+			cmdList->transitionTextureState(texture, ResourceState::ShaderResource);
+		}
+		cmdList->commitBarriers();
+		auto end = std::chrono::high_resolution_clock::now();
+		totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+		cmdList->close();
+		ICommandList* cmdLists[] = { cmdList };
+		uint64_t id = device->executeCommandLists(cmdLists, 1);
+		device->waitForExecution(id);
+	}
+	return totalMs / iterations;
+}
+
+int main()
+{
+	RenderDeviceCreateInfo rdCI{};
+	rdCI.messageCallback = messageCallback;
+	rdCI.enableValidationLayer = false;
+
+	auto renderDevice = std::unique_ptr<IRenderDevice>(createRenderDevice(rdCI));
+	if (!renderDevice)
+	{
+		std::cerr << "Failed to create render device\n";
+		return 1;
+	}
+	auto cmdList = std::unique_ptr<ICommandList>(renderDevice->createCommandList());
+
+	const uint32_t resourceCounts[] = { 1000, 2500, 5000, 10000 };
+	const uint32_t iterations = 16;
+
+	std::vector<std::unique_ptr<IBuffer>> bufferStorage;
+	std::vector<std::unique_ptr<ITexture>> textureStorage;
+
+	BufferDesc bufferDesc{};
+	bufferDesc.size = 256;
+	bufferDesc.access = BufferAccess::GpuOnly;
+	bufferDesc.usage = BufferUsage::StorageBuffer | BufferUsage::IndirectBuffer;
+
+	TextureDesc textureDesc{};
+	textureDesc.dimension = TextureDimension::Texture2D;
+	textureDesc.width = 4;
+	textureDesc.height = 4;
+	textureDesc.format = Format::RGBA8_UNORM;
+	textureDesc.usage = TextureUsage::ShaderResource | TextureUsage::UnorderedAccess;
+
+	std::cout << "transitions per list | buffers | textures | avg record time (ms) | ns per transition | barriers per list\n";
+	for (uint32_t count : resourceCounts)
+	{
+		// 3/4 buffers and 1/4 textures, roughly what resource sets bind
+		const uint32_t bufferCount = count * 3 / 4;
+		const uint32_t textureCount = count - bufferCount;
+		while (bufferStorage.size() < bufferCount)
+		{
+			bufferStorage.emplace_back(renderDevice->createBuffer(bufferDesc));
+		}
+		while (textureStorage.size() < textureCount)
+		{
+			textureStorage.emplace_back(renderDevice->createTexture(textureDesc));
+		}
+
+		std::vector<IBuffer*> buffers;
+		std::vector<ITexture*> textures;
+		for (uint32_t i = 0; i < bufferCount; ++i)
+		{
+			buffers.push_back(bufferStorage[i].get());
+		}
+		for (uint32_t i = 0; i < textureCount; ++i)
+		{
+			textures.push_back(textureStorage[i].get());
+		}
+
+		renderDevice->resetBarrierStatistics();
+		double ms = recordTransitions(renderDevice.get(), cmdList.get(), buffers, textures, iterations);
+		uint32_t transitions = count * 2;
+		std::cout << transitions << " | " << bufferCount << " | " << textureCount << " | "
+			<< ms << " | " << ms * 1e6 / transitions << " | ";
+		const BarrierStatistics& stats = renderDevice->getBarrierStatistics();
+		std::cout << (stats.imageBarrierCount + stats.bufferBarrierCount + stats.memoryBarrierCount) / iterations << "\n";
+	}
+
+	renderDevice->waitIdle();
+	return 0;
+}
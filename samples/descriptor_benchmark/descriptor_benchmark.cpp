@@ -0,0 +1,181 @@
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+
+#include <rhi/rhi.h>
+
+using namespace rhi;
+
+// Compares the descriptor pool path with the descriptor buffer path (RenderDeviceCreateInfo::enableDescriptorBuffer)
+// on the resource set layout of gpu_culling.comp: a uniform buffer, four storage buffers and a combined image sampler.
+// All columns are CPU times: creating the sets, writing all of their bindings, and recording one
+// setComputeState per set. If the device doesn't support VK_EXT_descriptor_buffer both rows use descriptor pools.
+
+static void messageCallback(MessageSeverity severity, const char* msg)
+{
+	std::cerr << msg;
+}
+
+static std::vector<uint32_t> loadShaderData(const char* filePath)
+{
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+	std::vector<uint32_t> buffer;
+	if (!file.is_open()) {
+		return buffer;
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	buffer.resize(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read((char*)buffer.data(), fileSize);
+	file.close();
+	return buffer;
+}
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static bool runBenchmark(bool enableDescriptorBuffer, const std::vector<uint32_t>& shaderCode, uint32_t setCount)
+{
+	RenderDeviceCreateInfo rdCI{};
+	rdCI.messageCallback = messageCallback;
+	rdCI.enableValidationLayer = false;
+	rdCI.enableDescriptorBuffer = enableDescriptorBuffer;
+
+	auto renderDevice = std::unique_ptr<IRenderDevice>(createRenderDevice(rdCI));
+	if (!renderDevice)
+	{
+		std::cerr << "Failed to create render device\n";
+		return false;
+	}
+
+	ResourceSetLayoutBinding layoutBindings[] =
+	{
+		ResourceSetLayoutBinding::UniformBuffer(ShaderType::Compute, 0),
+		ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 1),
+		ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 2),
+		ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 3),
+		ResourceSetLayoutBinding::StorageBuffer(ShaderType::Compute, 4),
+		ResourceSetLayoutBinding::TextureWithSampler(ShaderType::Compute, 5)
+	};
+	auto resourceSetLayout = std::unique_ptr<IResourceSetLayout>(renderDevice->createResourceSetLayout(layoutBindings, 6));
+
+	ShaderCreateInfo shaderCI{};
+	shaderCI.type = ShaderType::Compute;
+	shaderCI.entry = "main";
+	auto shader = std::unique_ptr<IShader>(renderDevice->createShader(shaderCI, shaderCode.data(), shaderCode.size() * sizeof(uint32_t)));
+
+	IResourceSetLayout* setLayouts[] = { resourceSetLayout.get() };
+	ComputePipelineCreateInfo pipelineCI{};
+	pipelineCI.computeShader = shader.get();
+	pipelineCI.resourceSetLayouts = setLayouts;
+	pipelineCI.resourceSetLayoutCount = 1;
+	pipelineCI.pushConstantDescs = nullptr;
+	pipelineCI.pushConstantCount = 0;
+	auto pipeline = std::unique_ptr<IComputePipeline>(renderDevice->createComputePipeline(pipelineCI));
+
+	BufferDesc bufferDesc{};
+	bufferDesc.access = BufferAccess::GpuOnly;
+	bufferDesc.size = 256;
+	bufferDesc.usage = BufferUsage::UniformBuffer;
+	auto uniformBuffer = std::unique_ptr<IBuffer>(renderDevice->createBuffer(bufferDesc));
+	bufferDesc.size = 4096;
+	bufferDesc.usage = BufferUsage::StorageBuffer;
+	std::unique_ptr<IBuffer> storageBuffers[4];
+	for (auto& storageBuffer : storageBuffers)
+	{
+		storageBuffer.reset(renderDevice->createBuffer(bufferDesc));
+	}
+
+	TextureDesc textureDesc{};
+	textureDesc.dimension = TextureDimension::Texture2D;
+	textureDesc.format = Format::R32_FLOAT;
+	textureDesc.usage = TextureUsage::ShaderResource;
+	auto texture = std::unique_ptr<ITexture>(renderDevice->createTexture(textureDesc));
+
+	SamplerDesc samplerDesc{};
+	samplerDesc.magFilter = FilterMode::nearest;
+	samplerDesc.minFilter = FilterMode::nearest;
+	samplerDesc.mipmapMode = FilterMode::nearest;
+	auto sampler = std::unique_ptr<ISampler>(renderDevice->createSampler(samplerDesc));
+
+	if (!resourceSetLayout || !shader || !pipeline || !uniformBuffer || !texture || !sampler)
+	{
+		std::cerr << "Failed to create benchmark resources\n";
+		return false;
+	}
+
+	std::vector<std::unique_ptr<IResourceSet>> resourceSets(setCount);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto& resourceSet : resourceSets)
+	{
+		resourceSet.reset(renderDevice->createResourceSet(resourceSetLayout.get()));
+	}
+	double createMs = elapsedMs(start);
+
+	ResourceSetBinding bindings[] =
+	{
+		ResourceSetBinding::UniformBuffer(uniformBuffer.get(), 0),
+		ResourceSetBinding::StorageBuffer(storageBuffers[0].get(), 1),
+		ResourceSetBinding::StorageBuffer(storageBuffers[1].get(), 2),
+		ResourceSetBinding::StorageBuffer(storageBuffers[2].get(), 3),
+		ResourceSetBinding::StorageBuffer(storageBuffers[3].get(), 4),
+		ResourceSetBinding::TextureWithSampler(texture->getDefaultView(), sampler.get(), 5)
+	};
+	start = std::chrono::high_resolution_clock::now();
+	for (auto& resourceSet : resourceSets)
+	{
+		renderDevice->writeResourceSet(resourceSet.get(), bindings, 6);
+	}
+	double writeMs = elapsedMs(start);
+
+	auto cmdList = std::unique_ptr<ICommandList>(renderDevice->createCommandList());
+	cmdList->open();
+	start = std::chrono::high_resolution_clock::now();
+	ComputeState state{};
+	state.pipeline = pipeline.get();
+	state.resourceSetCount = 1;
+	for (auto& resourceSet : resourceSets)
+	{
+		state.resourceSets[0] = resourceSet.get();
+		cmdList->setComputeState(state);
+	}
+	double bindMs = elapsedMs(start);
+	cmdList->close();
+
+	ICommandList* cmdLists[] = { cmdList.get() };
+	renderDevice->waitForExecution(renderDevice->executeCommandLists(cmdLists, 1));
+
+	std::cout << (enableDescriptorBuffer ? "descriptor buffer" : "descriptor pool") << " | " << setCount << " | "
+		<< createMs << " | " << writeMs << " | " << bindMs << "\n";
+
+	renderDevice->waitIdle();
+	return true;
+}
+
+int main()
+{
+	std::vector<uint32_t> shaderCode = loadShaderData("gpu_culling.comp.spv");
+	if (shaderCode.empty())
+	{
+		std::cerr << "Failed to load gpu_culling.comp.spv\n";
+		return 1;
+	}
+
+	const uint32_t setCounts[] = { 1000, 10000, 50000 };
+
+	std::cout << "path | sets | create (ms) | write (ms) | bind (ms)\n";
+	for (uint32_t setCount : setCounts)
+	{
+		if (!runBenchmark(false, shaderCode, setCount) || !runBenchmark(true, shaderCode, setCount))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
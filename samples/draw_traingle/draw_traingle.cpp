@@ -184,6 +184,7 @@ public:
 		m_GraphicState.viewportCount = 1;
 		m_GraphicState.viewports[0] = { (float)m_windowWidth, (float)m_windowHeight };
 		m_GraphicState.clearRenderTarget = true;
+		m_GraphicState.clearDepthStencil = true;
 	}
 
 	void run()
@@ -0,0 +1,150 @@
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <rhi/rhi.h>
+#include <rhi/gpu_culling.h>
+
+using namespace rhi;
+
+// Measures GpuCulling with a growing number of instances.
+// The record column is the time spent recording cull(), which should stay flat.
+// The round trip column is measured on the CPU from submit until waitForExecution returns, for a list that holds
+// the culling pass and the copy of the draw count. It includes the submission and wait overhead, so it is an upper
+// bound of the GPU time, the rhi has no timestamp queries to measure the dispatch alone.
+
+static void messageCallback(MessageSeverity severity, const char* msg)
+{
+	std::cerr << msg;
+}
+
+static std::vector<uint32_t> loadShaderData(const char* filePath)
+{
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+	std::vector<uint32_t> buffer;
+	if (!file.is_open()) {
+		return buffer;
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	buffer.resize(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read((char*)buffer.data(), fileSize);
+	file.close();
+	return buffer;
+}
+
+int main()
+{
+	RenderDeviceCreateInfo rdCI{};
+	rdCI.messageCallback = messageCallback;
+	rdCI.enableValidationLayer = false;
+
+	auto renderDevice = std::unique_ptr<IRenderDevice>(createRenderDevice(rdCI));
+	if (!renderDevice)
+	{
+		std::cerr << "Failed to create render device\n";
+		return 1;
+	}
+	auto cmdList = std::unique_ptr<ICommandList>(renderDevice->createCommandList());
+
+	std::vector<uint32_t> shaderCode = loadShaderData("gpu_culling.comp.spv");
+	if (shaderCode.empty())
+	{
+		std::cerr << "Failed to load gpu_culling.comp.spv\n";
+		return 1;
+	}
+
+	const uint32_t instanceCounts[] = { 10000, 100000, 250000, 1000000 };
+	const uint32_t maxInstanceCount = 1000000;
+	const uint32_t meshCount = 16;
+	const uint32_t iterations = 16;
+
+	GpuCullingCreateInfo cullingCI{};
+	cullingCI.shaderCode = shaderCode.data();
+	cullingCI.shaderCodeSize = shaderCode.size() * sizeof(uint32_t);
+	cullingCI.maxInstanceCount = maxInstanceCount;
+	cullingCI.maxMeshCount = meshCount;
+	auto culling = std::unique_ptr<GpuCulling>(GpuCulling::create(renderDevice.get(), cullingCI));
+	if (!culling)
+	{
+		std::cerr << "Failed to create gpu culling\n";
+		return 1;
+	}
+
+	// spheres are scattered over twice the width and height of the view volume,
+	// so roughly 1/8 of them survive
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> xy(-200.f, 200.f);
+	std::uniform_real_distribution<float> z(-100.f, 300.f);
+	std::uniform_real_distribution<float> radius(0.1f, 1.f);
+	std::vector<GpuCullingInstance> instances(maxInstanceCount);
+	for (uint32_t i = 0; i < maxInstanceCount; ++i)
+	{
+		instances[i].boundingSphere[0] = xy(rng);
+		instances[i].boundingSphere[1] = xy(rng);
+		instances[i].boundingSphere[2] = z(rng);
+		instances[i].boundingSphere[3] = radius(rng);
+		instances[i].meshIndex = i % meshCount;
+	}
+	std::vector<GpuCullingMesh> meshes(meshCount);
+	for (uint32_t i = 0; i < meshCount; ++i)
+	{
+		meshes[i].indexCount = 36;
+		meshes[i].firstIndex = i * 36;
+	}
+
+	cmdList->open();
+	culling->updateInstances(cmdList.get(), instances.data(), maxInstanceCount);
+	culling->updateMeshes(cmdList.get(), meshes.data(), meshCount);
+	cmdList->close();
+	ICommandList* cmdLists[] = { cmdList.get() };
+	renderDevice->waitForExecution(renderDevice->executeCommandLists(cmdLists, 1));
+
+	// orthographic projection of x, y in [-100, 100] and z in [0, 200]
+	GpuCullingView view{};
+	view.viewProjection[0] = 1.f / 100.f;
+	view.viewProjection[5] = 1.f / 100.f;
+	view.viewProjection[10] = 1.f / 200.f;
+	view.viewProjection[15] = 1.f;
+	GpuCulling::computeFrustumPlanes(view.viewProjection, view.frustumPlanes);
+
+	BufferDesc readbackDesc{};
+	readbackDesc.size = sizeof(uint32_t);
+	readbackDesc.access = BufferAccess::CpuRead;
+	auto readbackBuffer = std::unique_ptr<IBuffer>(renderDevice->createBuffer(readbackDesc));
+
+	std::cout << "instances | avg cpu record time (ms) | avg cpu round trip time (ms) | visible\n";
+	for (uint32_t count : instanceCounts)
+	{
+		culling->setInstanceCount(count);
+
+		double cpuMs = 0.0;
+		double roundTripMs = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			cmdList->open();
+			auto start = std::chrono::high_resolution_clock::now();
+			culling->cull(cmdList.get(), view);
+			auto end = std::chrono::high_resolution_clock::now();
+			cpuMs += std::chrono::duration<double, std::milli>(end - start).count();
+			cmdList->copyBuffer(culling->getDrawCountBuffer(), 0, readbackBuffer.get(), 0, sizeof(uint32_t));
+			cmdList->close();
+
+			start = std::chrono::high_resolution_clock::now();
+			uint64_t id = renderDevice->executeCommandLists(cmdLists, 1);
+			renderDevice->waitForExecution(id);
+			end = std::chrono::high_resolution_clock::now();
+			roundTripMs += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		uint32_t visible = *static_cast<uint32_t*>(renderDevice->mapBuffer(readbackBuffer.get()));
+		std::cout << count << " | " << cpuMs / iterations << " | " << roundTripMs / iterations << " | " << visible << "\n";
+	}
+
+	renderDevice->waitIdle();
+	return 0;
+}